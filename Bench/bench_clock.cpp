@@ -0,0 +1,46 @@
+#include "time.hpp"
+#include <chrono>
+#include <cstdio>
+
+// Read cost of each clock backend: every available backend is read kReads times back to back and
+// the wall-clock time is divided by the number of reads. Also shows each backend's calibrated
+// resolution and the smallest nonzero difference between two consecutive reads.
+
+static const int kReads = 10000000;
+
+int main() {
+    InitializeClock();
+    std::printf("active backend: %s\n\n", GetClockBackendName(GetClockBackend()));
+    std::printf("%-20s %14s %16s %18s\n", "backend", "ns per read", "ns per tick", "min step (ns)");
+
+    for (int b = 0; b < CLOCK_BACKEND_COUNT; b++) {
+        ProfilerClockBackend backend = static_cast<ProfilerClockBackend>(b);
+        if (!IsClockBackendAvailable(backend)) {
+            std::printf("%-20s %14s\n", GetClockBackendName(backend), "unavailable");
+            continue;
+        }
+
+        ProfilerTicks minStep = 0;
+        ProfilerTicks previous = ReadClockTicks(backend);
+        ProfilerTicks checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kReads; i++) {
+            ProfilerTicks now = ReadClockTicks(backend);
+            ProfilerTicks step = now - previous;
+            if (step > 0 && (minStep == 0 || step < minStep)) {
+                minStep = step;
+            }
+            checksum += step;
+            previous = now;
+        }
+        auto stop = std::chrono::steady_clock::now();
+
+        double secondsPerTick = GetClockSecondsPerTick(backend);
+        double readCost = std::chrono::duration<double, std::nano>(stop - start).count() / kReads;
+        std::printf("%-20s %14.2f %16.4f %18.2f\n", GetClockBackendName(backend), readCost, 1e9 * secondsPerTick, 1e9 * minStep * secondsPerTick);
+        if (checksum < 0) {
+            std::fprintf(stderr, "%s went backwards\n", GetClockBackendName(backend));
+        }
+    }
+    return 0;
+}
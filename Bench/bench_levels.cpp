@@ -0,0 +1,128 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Cost of each compile-time profiling level on the main.cpp baseline insertion sort. The makefile
+// builds this file once per PROFILER_LEVEL; every build times the same sort uninstrumented and with
+// level-tagged sections, and a level 0 build should show no difference between the two. Builds at
+// level 3 also time the innermost section sampled 1 in 16.
+
+static const int kArraySize = 5000;
+static const int kRepetitions = 10;
+static const int kRounds = 9;
+static const int kSampleEvery = 16;
+
+// generateArray: Fixed-seed random input so every build sorts the same data
+static std::vector<int> generateArray(int size) {
+    std::srand(12345);
+    std::vector<int> arr(size);
+    for (int i = 0; i < size; i++) {
+        arr[i] = std::rand() % 10000;
+    }
+    return arr;
+}
+
+// plainInsertionSort: baselineInsertionSort from main.cpp without any instrumentation
+static void plainInsertionSort(std::vector<int>& arr) {
+    int n = arr.size();
+    for (int i = 1; i < n; i++) {
+        int key = arr[i];
+        int j = i - 1;
+        while (j >= 0 && arr[j] > key) {
+            arr[j + 1] = arr[j];
+            j--;
+        }
+        arr[j + 1] = key;
+    }
+}
+
+// leveledInsertionSort: baselineInsertionSort from main.cpp with its level-tagged sections
+static void leveledInsertionSort(std::vector<int>& arr) {
+    PROFILER_ENTER("Baseline Insertion Sort");
+    int n = arr.size();
+
+    PROFILER_ENTER_LEVEL(2, "Insertion Sort1: Outer Loop");
+    for (int i = 1; i < n; i++) {
+        PROFILER_ENTER_LEVEL(3, "Insertion Sort1: Key Selection");
+        int key = arr[i];
+        int j = i - 1;
+
+        PROFILER_ENTER_LEVEL(3, "Insertion Sort1: Element Shifting");
+        while (j >= 0 && arr[j] > key) {
+            arr[j + 1] = arr[j];
+            j--;
+        }
+        arr[j + 1] = key;
+        PROFILER_EXIT_LEVEL(3, "Insertion Sort1: Element Shifting");
+
+        PROFILER_EXIT_LEVEL(3, "Insertion Sort1: Key Selection");
+    }
+    PROFILER_EXIT_LEVEL(2, "Insertion Sort1: Outer Loop");
+    PROFILER_EXIT("Baseline Insertion Sort");
+}
+
+// sampledInsertionSort: Same as leveledInsertionSort with only the innermost section sampled
+static void sampledInsertionSort(std::vector<int>& arr) {
+    PROFILER_ENTER("Sampled Insertion Sort");
+    int n = arr.size();
+
+    PROFILER_ENTER_LEVEL(2, "Sampled Insertion Sort: Outer Loop");
+    for (int i = 1; i < n; i++) {
+        PROFILER_ENTER_SAMPLED("Sampled Insertion Sort: Element Shifting", kSampleEvery);
+        int key = arr[i];
+        int j = i - 1;
+        while (j >= 0 && arr[j] > key) {
+            arr[j + 1] = arr[j];
+            j--;
+        }
+        arr[j + 1] = key;
+        PROFILER_EXIT_SAMPLED("Sampled Insertion Sort: Element Shifting");
+    }
+    PROFILER_EXIT_LEVEL(2, "Sampled Insertion Sort: Outer Loop");
+    PROFILER_EXIT("Sampled Insertion Sort");
+}
+
+// timeSeconds: Fastest round's average time per sort (see bench_sort.cpp)
+static double timeSeconds(void (*sort)(std::vector<int>&), const std::vector<int>& input) {
+    double best = 1e30;
+    for (int round = 0; round < kRounds; round++) {
+        double total = 0.0;
+        for (int r = 0; r < kRepetitions; r++) {
+            std::vector<int> arr = input;
+            auto start = std::chrono::steady_clock::now();
+            sort(arr);
+            auto stop = std::chrono::steady_clock::now();
+            total += std::chrono::duration<double>(stop - start).count();
+        }
+        best = std::min(best, total / kRepetitions);
+    }
+    return best;
+}
+
+int main() {
+    Profiler* profiler = Profiler::GetInstance();
+    std::vector<int> input = generateArray(kArraySize);
+
+    // Warm up caches and the profiler's buffers
+    timeSeconds(plainInsertionSort, input);
+    timeSeconds(leveledInsertionSort, input);
+
+    double plainSeconds = timeSeconds(plainInsertionSort, input);
+    double leveledSeconds = timeSeconds(leveledInsertionSort, input);
+
+    std::printf("PROFILER_LEVEL %d: uninstrumented %.3f ms, instrumented %.3f ms (%+.1f%%)", PROFILER_LEVEL,
+                1e3 * plainSeconds, 1e3 * leveledSeconds, 100.0 * (leveledSeconds - plainSeconds) / plainSeconds);
+#if PROFILER_LEVEL >= 3
+    timeSeconds(sampledInsertionSort, input);
+    double sampledSeconds = timeSeconds(sampledInsertionSort, input);
+    std::printf(", inner section sampled 1 in %d %.3f ms (%+.1f%%)", kSampleEvery,
+                1e3 * sampledSeconds, 100.0 * (sampledSeconds - plainSeconds) / plainSeconds);
+#endif
+    std::printf("\n");
+
+    delete profiler;
+    return 0;
+}
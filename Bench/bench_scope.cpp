@@ -0,0 +1,67 @@
+#include "profiler.hpp"
+#include <chrono>
+#include <cstdio>
+
+// Microbenchmark: cost of a PROFILE_SCOPE section against the equivalent hand-written
+// PROFILER_ENTER/PROFILER_EXIT pair, both with the same nesting and the same number of sections.
+
+static const int kIterations = 2000000;
+static volatile int sink = 0;
+
+// runManual: One outer section wrapping one inner section, instrumented with the enter/exit macros
+static void runManual() {
+    for (int i = 0; i < kIterations; i++) {
+        PROFILER_ENTER("Manual: Outer");
+        PROFILER_ENTER("Manual: Inner");
+        sink = sink + 1;
+        PROFILER_EXIT("Manual: Inner");
+        PROFILER_EXIT("Manual: Outer");
+    }
+}
+
+// runScoped: The same shape as runManual, instrumented with PROFILE_SCOPE
+static void runScoped() {
+    for (int i = 0; i < kIterations; i++) {
+        PROFILE_SCOPE("Scoped: Outer");
+        {
+            PROFILE_SCOPE("Scoped: Inner");
+            sink = sink + 1;
+        }
+    }
+}
+
+// timeNanosecondsPerSection: Runs one variant and returns its wall-clock cost per profiled section
+static double timeNanosecondsPerSection(void (*variant)()) {
+    auto start = std::chrono::steady_clock::now();
+    variant();
+    auto stop = std::chrono::steady_clock::now();
+    double nanoseconds = std::chrono::duration<double, std::nano>(stop - start).count();
+    return nanoseconds / (2.0 * kIterations);
+}
+
+int main() {
+    Profiler* profiler = Profiler::GetInstance();
+
+    // Warm up both paths so the thread buffer and stats entries already exist
+    runManual();
+    runScoped();
+
+    double manualCost = timeNanosecondsPerSection(runManual);
+    double scopedCost = timeNanosecondsPerSection(runScoped);
+
+    profiler->calculateStats();
+    long long manualCount = profiler->GetSectionCount("Manual: Inner");
+    long long scopedCount = profiler->GetSectionCount("Scoped: Inner");
+
+    std::printf("%-28s %16s %12s\n", "variant", "ns per section", "recorded");
+    std::printf("%-28s %16.1f %12lld\n", "PROFILER_ENTER/PROFILER_EXIT", manualCost, manualCount);
+    std::printf("%-28s %16.1f %12lld\n", "PROFILE_SCOPE", scopedCost, scopedCount);
+
+    if (scopedCount != manualCount) {
+        std::fprintf(stderr, "PROFILE_SCOPE recorded %lld sections, expected %lld\n", scopedCount, manualCount);
+        return 1;
+    }
+
+    delete profiler;
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Per-section overhead on the main.cpp insertion-sort workload: the baseline insertion sort is run
+// once uninstrumented and once with the same PROFILER_ENTER/PROFILER_EXIT sections as main.cpp, and
+// the difference in time per sort is divided by the number of sections in one sort.
+
+static const int kArraySize = 5000;
+static const int kRepetitions = 20;
+static const int kRounds = 5;
+
+// generateArray: Fixed-seed random input so every run sorts the same data
+static std::vector<int> generateArray(int size) {
+    std::srand(12345);
+    std::vector<int> arr(size);
+    for (int i = 0; i < size; i++) {
+        arr[i] = std::rand() % 10000;
+    }
+    return arr;
+}
+
+// plainInsertionSort: baselineInsertionSort from main.cpp without any instrumentation
+static void plainInsertionSort(std::vector<int>& arr) {
+    int n = arr.size();
+    for (int i = 1; i < n; i++) {
+        int key = arr[i];
+        int j = i - 1;
+        while (j >= 0 && arr[j] > key) {
+            arr[j + 1] = arr[j];
+            j--;
+        }
+        arr[j + 1] = key;
+    }
+}
+
+// profiledInsertionSort: baselineInsertionSort from main.cpp, instrumented the same way
+static void profiledInsertionSort(std::vector<int>& arr) {
+    PROFILER_ENTER("Baseline Insertion Sort");
+    int n = arr.size();
+
+    PROFILER_ENTER("Insertion Sort1: Outer Loop");
+    for (int i = 1; i < n; i++) {
+        PROFILER_ENTER("Insertion Sort1: Key Selection");
+        int key = arr[i];
+        int j = i - 1;
+
+        PROFILER_ENTER("Insertion Sort1: Element Shifting");
+        while (j >= 0 && arr[j] > key) {
+            arr[j + 1] = arr[j];
+            j--;
+        }
+        arr[j + 1] = key;
+        PROFILER_EXIT("Insertion Sort1: Element Shifting");
+
+        PROFILER_EXIT("Insertion Sort1: Key Selection");
+    }
+    PROFILER_EXIT("Insertion Sort1: Outer Loop");
+    PROFILER_EXIT("Baseline Insertion Sort");
+}
+
+// timeSeconds: Sorts kRepetitions fresh copies of the input per round and returns the fastest round's
+// time per sort. Whole rounds keep the periodic buffer drains in the measurement, and taking the
+// fastest round keeps other load on the machine out of it.
+static double timeSeconds(void (*sort)(std::vector<int>&), const std::vector<int>& input) {
+    double best = 1e30;
+    for (int round = 0; round < kRounds; round++) {
+        double total = 0.0;
+        for (int r = 0; r < kRepetitions; r++) {
+            std::vector<int> arr = input;
+            auto start = std::chrono::steady_clock::now();
+            sort(arr);
+            auto stop = std::chrono::steady_clock::now();
+            total += std::chrono::duration<double>(stop - start).count();
+        }
+        best = std::min(best, total / kRepetitions);
+    }
+    return best;
+}
+
+int main() {
+    Profiler* profiler = Profiler::GetInstance();
+    std::vector<int> input = generateArray(kArraySize);
+
+    // Warm up caches, the thread buffer and the stats entries
+    timeSeconds(plainInsertionSort, input);
+    timeSeconds(profiledInsertionSort, input);
+
+    double plainSeconds = timeSeconds(plainInsertionSort, input);
+    double profiledSeconds = timeSeconds(profiledInsertionSort, input);
+
+    profiler->calculateStats();
+    long long sections = 0;
+    sections += profiler->GetSectionCount("Baseline Insertion Sort");
+    sections += profiler->GetSectionCount("Insertion Sort1: Outer Loop");
+    sections += profiler->GetSectionCount("Insertion Sort1: Key Selection");
+    sections += profiler->GetSectionCount("Insertion Sort1: Element Shifting");
+    sections /= 2 * kRounds * kRepetitions;  // Warmup and measured runs each did kRounds * kRepetitions sorts
+
+    std::printf("uninstrumented: %10.3f ms per sort\n", 1e3 * plainSeconds);
+    std::printf("instrumented:   %10.3f ms per sort\n", 1e3 * profiledSeconds);
+    std::printf("overhead:       %10.1f ns per enter/exit pair (%lld sections per sort)\n", 1e9 * (profiledSeconds - plainSeconds) / sections, sections);
+
+    delete profiler;
+    return 0;
+}
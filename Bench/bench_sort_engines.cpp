@@ -0,0 +1,66 @@
+#include "profiler.hpp"
+#include "benchmark.hpp"
+#include "sorts.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Scaling sweep of the O(n log n) sort engines in sorts.hpp from a thousand elements up to the size given
+// on the command line (default ten million, 100000000 for the full 10^8), with the parallel merge sort at
+// 1, 2, 4 and 8 threads. Every run goes through the Profiler, and the results are written where the
+// dashboard's scaling chart picks them up next to main.cpp's. A 10^8 sweep needs about 2 GB of memory.
+
+static const int kDefaultMaxSize = 10000000;
+
+// The benchmark takes plain sort functions, so each thread count gets its own instantiation
+template <int threadCount>
+static void parallelMergeSortWith(std::vector<int>& arr) {
+    parallelMergeSort(arr, threadCount);
+}
+
+// standardSort: std::sort, as the reference every engine should beat or come close to
+static void standardSort(std::vector<int>& arr) {
+    PROFILER_ENTER("std::sort");
+    PROFILER_COUNT("std::sort", "elements", arr.size());
+    std::sort(arr.begin(), arr.end());
+    PROFILER_EXIT("std::sort");
+}
+
+int main(int argc, char** argv) {
+    int maxSize = argc > 1 ? std::atoi(argv[1]) : kDefaultMaxSize;
+    if (maxSize < 1000) {
+        std::fprintf(stderr, "usage: %s [max size, at least 1000]\n", argv[0]);
+        return 2;
+    }
+    Profiler* profiler = Profiler::GetInstance();
+
+    std::vector<int> sizes;
+    for (long long size = 1000; size <= maxSize; size *= 10) {
+        sizes.push_back(static_cast<int>(size));
+    }
+
+    ProfilerBenchmark benchmark;
+    benchmark.AddVariant("std::sort", standardSort);
+    benchmark.AddVariant("Cache-Aware Merge Sort", mergeSortCacheAware);
+    benchmark.AddVariant("Parallel Merge Sort (1 thread)", parallelMergeSortWith<1>);
+    benchmark.AddVariant("Parallel Merge Sort (2 threads)", parallelMergeSortWith<2>);
+    benchmark.AddVariant("Parallel Merge Sort (4 threads)", parallelMergeSortWith<4>);
+    benchmark.AddVariant("Parallel Merge Sort (8 threads)", parallelMergeSortWith<8>);
+    benchmark.AddVariant("LSD Radix Sort", radixSortLSD);
+    benchmark.SetSizes(sizes);
+    benchmark.SetDistributions({ DISTRIBUTION_RANDOM, DISTRIBUTION_NEARLY_SORTED });
+    benchmark.SetRepetitions(1, 9);
+
+    std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    bool verified = benchmark.Run();
+    benchmark.printResults();
+    benchmark.printResultsToCSV("./Data/benchmark_engines.csv");
+
+    profiler->calculateStats();
+    profiler->printStatsToCSV("./Data/profile_sort_engines.csv");
+
+    delete profiler;
+    return verified ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include "profiler.hpp"
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+
+// Multithreaded stress benchmark: every thread hammers the profiler with enter/exit pairs. Cost is
+// reported as process CPU time per section, so it stays meaningful when there are more threads than
+// cores; with no shared state on the hot path it should stay flat from 1 thread up to N.
+
+static const int kIterationsPerThread = 200000;
+
+// runWorker: Records kIterationsPerThread pairs of nested sections
+static void runWorker() {
+    for (int i = 0; i < kIterationsPerThread; i++) {
+        PROFILER_ENTER("Stress: Outer");
+        PROFILER_ENTER("Stress: Inner");
+        PROFILER_EXIT("Stress: Inner");
+        PROFILER_EXIT("Stress: Outer");
+    }
+}
+
+int main() {
+    unsigned maxThreads = std::thread::hardware_concurrency();
+    if (maxThreads < 4) {
+        maxThreads = 4;  // Still exercise contention on small machines
+    }
+
+    std::printf("%8s %16s %14s\n", "threads", "ns per section", "sections");
+    for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+        Profiler* profiler = Profiler::GetInstance();
+
+        std::clock_t cpuStart = std::clock();
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threadCount; t++) {
+            workers.emplace_back(runWorker);
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        std::clock_t cpuStop = std::clock();
+
+        double cpuNanoseconds = 1e9 * (cpuStop - cpuStart) / CLOCKS_PER_SEC;
+        double averageCost = cpuNanoseconds / (2.0 * kIterationsPerThread * threadCount);
+
+        // Make sure nothing was lost on the way through the per-thread buffers
+        profiler->calculateStats();
+        long long recorded = 0;
+        recorded += profiler->GetSectionCount("Stress: Outer");
+        recorded += profiler->GetSectionCount("Stress: Inner");
+
+        std::printf("%8u %16.1f %14lld\n", threadCount, averageCost, recorded);
+        if (recorded != 2LL * kIterationsPerThread * threadCount) {
+            std::fprintf(stderr, "Expected %lld sections, recorded %lld\n", 2LL * kIterationsPerThread * threadCount, recorded);
+            return 1;
+        }
+
+        delete profiler;
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include "allocations.hpp"
+#include "profiler.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+static std::atomic<bool> gAllocationTracking(false);
+static thread_local int tAllocationPauseDepth = 0;
+
+// Constructor for ProfilerAllocationPause and Destructor
+ProfilerAllocationPause::ProfilerAllocationPause() {
+    tAllocationPauseDepth++;
+}
+ProfilerAllocationPause::~ProfilerAllocationPause() {
+    tAllocationPauseDepth--;
+}
+
+void SetAllocationTracking(bool enabled) {
+    gAllocationTracking.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsAllocationTracking() {
+    return gAllocationTracking.load(std::memory_order_relaxed);
+}
+
+#if !defined(PROFILER_ALLOCATION_HOOKS)
+
+bool AreAllocationHooksInstalled() {
+    return false;
+}
+
+#else
+
+bool AreAllocationHooksInstalled() {
+    return true;
+}
+
+// ProfilerAllocationHeader struct: Sits in front of every block handed out by operator new. Its size keeps
+// the block at malloc's alignment.
+struct alignas(alignof(std::max_align_t)) ProfilerAllocationHeader {
+    size_t size;
+    int sectionId;  // -1 if the allocation wasn't counted
+};
+
+// countersFor: The calling thread's counters for a section, allocating the thread's table from the
+// ProfilerArena (which never re-enters operator new) the first time. nullptr if the arena is full.
+static ProfilerAllocationCounters* countersFor(ProfilerThreadBuffer* buffer, int sectionId) {
+    ProfilerAllocationCounters* table = buffer->allocationCounters.load(std::memory_order_relaxed);
+    if (table == nullptr) {
+        size_t tableBytes = ProfilerSectionRegistry::kMaxSections * sizeof(ProfilerAllocationCounters);
+        table = static_cast<ProfilerAllocationCounters*>(ProfilerArena::GetInstance()->Allocate(tableBytes));
+        if (table == nullptr) {
+            return nullptr;
+        }
+        std::memset(static_cast<void*>(table), 0, tableBytes);
+        buffer->allocationCounters.store(table, std::memory_order_release);
+    }
+    return &table[sectionId];
+}
+
+// trackedAllocate: malloc with room for the header, charging the block to the innermost active section
+static void* trackedAllocate(size_t size) {
+    ProfilerAllocationHeader* header = static_cast<ProfilerAllocationHeader*>(std::malloc(sizeof(ProfilerAllocationHeader) + size));
+    if (header == nullptr) {
+        return nullptr;
+    }
+    header->size = size;
+    header->sectionId = -1;
+    if (gAllocationTracking.load(std::memory_order_relaxed) && tAllocationPauseDepth == 0) {
+        ProfilerThreadBuffer* buffer = Profiler::GetThreadBufferIfRegistered();
+        int sectionId = buffer != nullptr ? Profiler::GetActiveSection(buffer) : -1;
+        ProfilerAllocationCounters* counters = sectionId >= 0 ? countersFor(buffer, sectionId) : nullptr;
+        if (counters != nullptr) {
+            addRelaxed(counters->allocations, 1);
+            addRelaxed(counters->allocatedBytes, static_cast<long long>(size));
+            raiseRelaxed(counters->peakLiveBytes, addRelaxed(counters->liveBytes, static_cast<long long>(size)));
+            header->sectionId = sectionId;
+        }
+    }
+    return header + 1;
+}
+
+// trackedFree: Credits a counted block back to its section on the freeing thread, then frees it. Frees on
+// a thread that never entered a section can't be recorded anywhere and only release the memory.
+static void trackedFree(void* block) {
+    if (block == nullptr) {
+        return;
+    }
+    ProfilerAllocationHeader* header = static_cast<ProfilerAllocationHeader*>(block) - 1;
+    if (header->sectionId >= 0) {
+        ProfilerThreadBuffer* buffer = Profiler::GetThreadBufferIfRegistered();
+        ProfilerAllocationCounters* counters = buffer != nullptr ? countersFor(buffer, header->sectionId) : nullptr;
+        if (counters != nullptr) {
+            addRelaxed(counters->freedBytes, static_cast<long long>(header->size));
+            addRelaxed(counters->liveBytes, -static_cast<long long>(header->size));
+        }
+    }
+    std::free(header);
+}
+
+// allocateOrThrow: The standard operator new loop, calling the new handler until it gives up
+static void* allocateOrThrow(size_t size) {
+    for (;;) {
+        void* block = trackedAllocate(size);
+        if (block != nullptr) {
+            return block;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* operator new(size_t size) {
+    return allocateOrThrow(size);
+}
+void* operator new[](size_t size) {
+    return allocateOrThrow(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocateOrThrow(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocateOrThrow(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* block) noexcept {
+    trackedFree(block);
+}
+void operator delete[](void* block) noexcept {
+    trackedFree(block);
+}
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+    trackedFree(block);
+}
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+    trackedFree(block);
+}
+void operator delete(void* block, size_t) noexcept {
+    trackedFree(block);
+}
+void operator delete[](void* block, size_t) noexcept {
+    trackedFree(block);
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+// Allocation tracking: only a build with -DPROFILER_ALLOCATION_HOOKS (make compile has it) replaces the global
+// operator new and delete, in allocations.cpp. Without it the heap is left alone and EnableAllocationTracking
+// returns false, so benchmarks and tools run on the real allocator. Every block carries a small header with
+// its size and the section it was charged to, so a free is credited back to the same section whichever thread
+// frees it. While tracking is on, each allocation is charged to the innermost section active on the
+// allocating thread; allocations outside any section aren't counted. Plain malloc/free calls are not seen.
+
+// ProfilerAllocationCounters struct: One section's allocations as seen by one thread. Only that thread writes
+// them (relaxed atomics, so allocating never takes a lock or contends); the collector reads them when it
+// drains. liveBytes can go negative on a thread that frees blocks another thread allocated.
+struct ProfilerAllocationCounters {
+    std::atomic<long long> allocations;
+    std::atomic<long long> allocatedBytes;
+    std::atomic<long long> freedBytes;
+    std::atomic<long long> liveBytes;
+    std::atomic<long long> peakLiveBytes;
+};
+
+// addRelaxed and raiseRelaxed: Updates to the per-thread counter tables (allocations, custom counters, locks).
+// Only the owning thread writes a counter, so a load and a store are enough, no read-modify-write.
+inline long long addRelaxed(std::atomic<long long>& counter, long long amount) {
+    long long value = counter.load(std::memory_order_relaxed) + amount;
+    counter.store(value, std::memory_order_relaxed);
+    return value;
+}
+inline void raiseRelaxed(std::atomic<long long>& maximum, long long value) {
+    if (value > maximum.load(std::memory_order_relaxed)) {
+        maximum.store(value, std::memory_order_relaxed);
+    }
+}
+
+// ProfilerAllocationPause class: The calling thread's allocations aren't counted while one is in scope, so
+// the profiler's own bookkeeping (draining a full ring, opening counters) isn't charged to the user's sections
+class ProfilerAllocationPause {
+    public:
+        ProfilerAllocationPause();
+        ~ProfilerAllocationPause();
+
+        ProfilerAllocationPause(const ProfilerAllocationPause&) = delete;
+        ProfilerAllocationPause& operator=(const ProfilerAllocationPause&) = delete;
+};
+
+// Whether this build replaced operator new/delete (only with PROFILER_ALLOCATION_HOOKS)
+bool AreAllocationHooksInstalled();
+
+// Turns the counting on or off for every thread; the hooks themselves stay in place either way
+void SetAllocationTracking(bool enabled);
+bool IsAllocationTracking();
@@ -0,0 +1,183 @@
+#include "arena.hpp"
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// mapPages: Fresh zeroed pages from the OS, nullptr if there are none
+static void* mapPages(size_t bytes) {
+#if defined(_WIN32)
+    return VirtualAlloc(nullptr, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void* pages = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return pages == MAP_FAILED ? nullptr : pages;
+#endif
+}
+
+static void unmapPages(void* pages, size_t bytes) {
+#if defined(_WIN32)
+    (void)bytes;
+    VirtualFree(pages, 0, MEM_RELEASE);
+#else
+    munmap(pages, bytes);
+#endif
+}
+
+// pageRoundUp: Large blocks are mapped in whole pages, and charged to the budget that way
+static size_t pageRoundUp(size_t bytes) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    size_t pageSize = info.dwPageSize;
+#else
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    return (bytes + pageSize - 1) / pageSize * pageSize;
+}
+
+// Constructor for ProfilerArena and Destructor (returns every chunk to the OS)
+ProfilerArena::ProfilerArena()
+    : budget(kDefaultBudget),
+      bytesMapped(0),
+      bytesInUse(0),
+      peakBytesInUse(0),
+      failedAllocations(0),
+      freeLists(),
+      chunkCursor(nullptr),
+      chunkEnd(nullptr),
+      chunks(nullptr) {}
+ProfilerArena::~ProfilerArena() {
+    while (chunks != nullptr) {
+        void* next = *static_cast<void**>(chunks);
+        unmapPages(chunks, kChunkBytes);
+        chunks = next;
+    }
+}
+
+// Arena singleton: Function-local static, constructed before (and so destroyed after) the registry that uses it
+ProfilerArena* ProfilerArena::GetInstance() {
+    static ProfilerArena arena;
+    return &arena;
+}
+
+void ProfilerArena::SetBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+}
+
+size_t ProfilerArena::GetBudget() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return budget;
+}
+
+// GetPoolIndex: The smallest pool whose blocks fit, -1 if the block is too big for any pool
+int ProfilerArena::GetPoolIndex(size_t bytes) {
+    if (bytes > kMaxPooledBytes) {
+        return -1;
+    }
+    int pool = 0;
+    size_t blockBytes = kMinPooledBytes;
+    while (blockBytes < bytes) {
+        blockBytes <<= 1;
+        pool++;
+    }
+    return pool;
+}
+
+// MapChunk: Starts a new chunk for the pools if the budget allows; the old chunk's unused tail is abandoned
+bool ProfilerArena::MapChunk() {
+    if (bytesMapped > budget || budget - bytesMapped < kChunkBytes) {
+        return false;
+    }
+    char* chunk = static_cast<char*>(mapPages(kChunkBytes));
+    if (chunk == nullptr) {
+        return false;
+    }
+    bytesMapped += kChunkBytes;
+    *reinterpret_cast<void**>(chunk) = chunks;
+    chunks = chunk;
+    chunkCursor = chunk + kMinPooledBytes;  // The link takes the first slot, which keeps blocks 16-byte aligned
+    chunkEnd = chunk + kChunkBytes;
+    return true;
+}
+
+void* ProfilerArena::Allocate(size_t bytes) {
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    int pool = GetPoolIndex(bytes);
+    void* block = nullptr;
+    size_t blockBytes;
+    if (pool >= 0) {
+        blockBytes = kMinPooledBytes << pool;
+        if (freeLists[pool] != nullptr) {
+            block = freeLists[pool];
+            freeLists[pool] = *static_cast<void**>(block);
+        } else if (static_cast<size_t>(chunkEnd - chunkCursor) >= blockBytes || MapChunk()) {
+            block = chunkCursor;
+            chunkCursor += blockBytes;
+        }
+    } else {
+        blockBytes = pageRoundUp(bytes);
+        if (bytesMapped <= budget && budget - bytesMapped >= blockBytes) {
+            block = mapPages(blockBytes);
+            if (block != nullptr) {
+                bytesMapped += blockBytes;
+            }
+        }
+    }
+
+    if (block == nullptr) {
+        failedAllocations++;
+        return nullptr;
+    }
+    bytesInUse += blockBytes;
+    peakBytesInUse = std::max(peakBytesInUse, bytesInUse);
+    return block;
+}
+
+void ProfilerArena::Deallocate(void* block, size_t bytes) {
+    if (block == nullptr) {
+        return;
+    }
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    int pool = GetPoolIndex(bytes);
+    if (pool >= 0) {
+        *static_cast<void**>(block) = freeLists[pool];
+        freeLists[pool] = block;
+        bytesInUse -= kMinPooledBytes << pool;
+    } else {
+        size_t blockBytes = pageRoundUp(bytes);
+        unmapPages(block, blockBytes);
+        bytesMapped -= blockBytes;
+        bytesInUse -= blockBytes;
+    }
+}
+
+size_t ProfilerArena::GetBytesMapped() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytesMapped;
+}
+
+size_t ProfilerArena::GetBytesInUse() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytesInUse;
+}
+
+size_t ProfilerArena::GetPeakBytesInUse() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return peakBytesInUse;
+}
+
+unsigned long long ProfilerArena::GetFailedAllocations() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failedAllocations;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ProfilerArena class: Where all of the profiler's own storage comes from (thread rings, trace and counter
+// buffers, stats, call trees, the section registry and the sampler's slots), under one hard memory budget.
+// Memory is mapped straight from the OS rather than taken from malloc, so the profiler never shares or
+// fragments the heap of the code it measures. Blocks up to kMaxPooledBytes come from fixed power-of-two
+// pools carved out of kChunkBytes chunks and go back onto their pool's free list when released; anything
+// larger gets its own mapping, returned to the OS as soon as it is released. Every mapping counts against
+// the budget, and an allocation that would go over it fails instead (Allocate returns nullptr,
+// ProfilerArenaAllocator throws std::bad_alloc), which the Profiler turns into dropped data and a warning.
+//
+// Singleton pattern like the registry; set the budget before the Profiler is created. Releasing memory needs
+// the size it was allocated with, as with std::allocator.
+class ProfilerArena {
+    public:
+        static const size_t kChunkBytes = 1 << 20;
+        static const size_t kMinPooledBytes = 16;
+        static const size_t kMaxPooledBytes = 1 << 16;
+        static const int kPoolCount = 13;  // 16 bytes to 64 KB
+        static const size_t kDefaultBudget = 256u << 20;
+        static const size_t kUnlimited = SIZE_MAX;
+
+        static ProfilerArena* GetInstance();
+        ~ProfilerArena();
+
+        ProfilerArena(const ProfilerArena&) = delete;
+        ProfilerArena& operator=(const ProfilerArena&) = delete;
+
+        // Lowering the budget below what is already mapped keeps what is mapped and refuses anything new
+        void SetBudget(size_t bytes);
+        size_t GetBudget();
+
+        void* Allocate(size_t bytes);  // nullptr if it would go over the budget
+        void Deallocate(void* block, size_t bytes);
+
+        size_t GetBytesMapped();     // What the profiler holds from the OS, the number the budget caps
+        size_t GetBytesInUse();      // Handed out and not yet released
+        size_t GetPeakBytesInUse();
+        unsigned long long GetFailedAllocations();
+
+    private:
+        ProfilerArena();
+        static int GetPoolIndex(size_t bytes);
+        bool MapChunk();  // Caller holds mutex
+
+        std::mutex mutex;
+        size_t budget;
+        size_t bytesMapped;
+        size_t bytesInUse;
+        size_t peakBytesInUse;
+        unsigned long long failedAllocations;
+        void* freeLists[kPoolCount];  // Each free block holds the next one
+        char* chunkCursor;            // Unused part of the newest chunk
+        char* chunkEnd;
+        void* chunks;                 // Every chunk, linked through its first bytes, unmapped by the destructor
+};
+
+// ProfilerArenaAllocator class: std::allocator replacement over the ProfilerArena singleton, for the
+// profiler's containers. Throws std::bad_alloc once the budget is used up.
+template <typename T>
+class ProfilerArenaAllocator {
+    public:
+        typedef T value_type;
+
+        ProfilerArenaAllocator() noexcept {}
+        template <typename U>
+        ProfilerArenaAllocator(const ProfilerArenaAllocator<U>&) noexcept {}
+
+        T* allocate(size_t count) {
+            if (count > SIZE_MAX / sizeof(T)) {
+                throw std::bad_alloc();
+            }
+            void* block = ProfilerArena::GetInstance()->Allocate(count * sizeof(T));
+            if (block == nullptr) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(block);
+        }
+        void deallocate(T* block, size_t count) noexcept {
+            ProfilerArena::GetInstance()->Deallocate(block, count * sizeof(T));
+        }
+};
+
+template <typename T, typename U>
+bool operator==(const ProfilerArenaAllocator<T>&, const ProfilerArenaAllocator<U>&) noexcept {
+    return true;
+}
+template <typename T, typename U>
+bool operator!=(const ProfilerArenaAllocator<T>&, const ProfilerArenaAllocator<U>&) noexcept {
+    return false;
+}
+
+// Containers for profiler storage
+template <typename T>
+using ProfilerVector = std::vector<T, ProfilerArenaAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, ProfilerArenaAllocator<char>> ProfilerString;
+
+// ProfilerStringHash struct: std::hash only covers std::string, so ProfilerString keys use FNV-1a
+struct ProfilerStringHash {
+    size_t operator()(const ProfilerString& text) const {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : text) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+// newProfilerArenaArray: count default-constructed objects in arena memory, throwing std::bad_alloc over the budget
+template <typename T>
+T* newProfilerArenaArray(size_t count) {
+    T* array = ProfilerArenaAllocator<T>().allocate(count);
+    for (size_t i = 0; i < count; i++) {
+        new (&array[i]) T;
+    }
+    return array;
+}
+
+// deleteProfilerArenaArray: Destroys and releases an array from newProfilerArenaArray (nullptr is ignored)
+template <typename T>
+void deleteProfilerArenaArray(T* array, size_t count) {
+    if (array == nullptr) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        array[i].~T();
+    }
+    ProfilerArenaAllocator<T>().deallocate(array, count);
+}
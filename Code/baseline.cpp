@@ -0,0 +1,251 @@
+#include "baseline.hpp"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+// Filled in by the makefile from git and its own flags; builds that don't pass them record "unknown"
+#ifndef PROFILER_GIT_COMMIT
+#define PROFILER_GIT_COMMIT "unknown"
+#endif
+#ifndef PROFILER_BUILD_FLAGS
+#define PROFILER_BUILD_FLAGS "unknown"
+#endif
+
+// readCPUModel: The first "model name" in /proc/cpuinfo, where there is one
+static std::string readCPUModel() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                return line.substr(line.find_first_not_of(' ', colon + 1));
+            }
+        }
+    }
+    return "unknown";
+}
+
+static std::string formatUTCTime(std::time_t now, const char* format) {
+    std::tm utc;
+#if defined(_WIN32)
+    gmtime_s(&utc, &now);
+#else
+    gmtime_r(&now, &utc);
+#endif
+    char text[64];
+    std::strftime(text, sizeof(text), format, &utc);
+    return text;
+}
+
+std::vector<std::pair<std::string, std::string>> collectRunMetadata() {
+    // Decided once, so the live profile and the baseline saved by the same process share it
+    static const std::time_t startTime = std::time(nullptr);
+    static const std::string runId = [] {
+        std::ostringstream id;
+        id << formatUTCTime(startTime, "%Y%m%d-%H%M%S");
+#if !defined(_WIN32)
+        id << "-" << getpid();
+#endif
+        return id.str();
+    }();
+
+    std::vector<std::pair<std::string, std::string>> metadata;
+    metadata.emplace_back("Run ID", runId);
+    metadata.emplace_back("Timestamp", formatUTCTime(startTime, "%Y-%m-%dT%H:%M:%SZ"));
+    metadata.emplace_back("Git Commit", PROFILER_GIT_COMMIT);
+    metadata.emplace_back("Build Flags", PROFILER_BUILD_FLAGS);
+#if defined(__clang__)
+    metadata.emplace_back("Compiler", std::string("clang ") + __clang_version__);
+#elif defined(__GNUC__)
+    metadata.emplace_back("Compiler", std::string("g++ ") + __VERSION__);
+#elif defined(_MSC_VER)
+    metadata.emplace_back("Compiler", "MSVC " + std::to_string(_MSC_VER));
+#else
+    metadata.emplace_back("Compiler", "unknown");
+#endif
+    metadata.emplace_back("CPU", readCPUModel());
+    metadata.emplace_back("Hardware Threads", std::to_string(std::thread::hardware_concurrency()));
+    metadata.emplace_back("Clock Backend", GetClockBackendName(GetClockBackend()));
+    metadata.emplace_back("Profiler Level", std::to_string(PROFILER_LEVEL));
+    return metadata;
+}
+
+std::string getRunMetadataValue(const std::vector<std::pair<std::string, std::string>>& metadata, const char* key) {
+    for (const auto& entry : metadata) {
+        if (entry.first == key) {
+            return entry.second;
+        }
+    }
+    return "";
+}
+
+const char* GetDiffVerdictName(ProfilerDiffVerdict verdict) {
+    switch (verdict) {
+        case DIFF_UNCHANGED: return "unchanged";
+        case DIFF_REGRESSION: return "REGRESSION";
+        case DIFF_IMPROVEMENT: return "improved";
+        case DIFF_NOT_TESTED: return "too few calls";
+        case DIFF_NEW: return "new";
+        case DIFF_MISSING: return "missing";
+        default: return "unknown";
+    }
+}
+
+// bucketMidpointSeconds: Where a histogram bucket's calls are placed for the rank test
+static double bucketMidpointSeconds(int bucket, double secondsPerTick) {
+    ProfilerTicks lower = ProfilerHistogram::GetBucketLowerBound(bucket);
+    ProfilerTicks upper = bucket == ProfilerHistogram::kBucketCount - 1 ? lower : ProfilerHistogram::GetBucketUpperBound(bucket);
+    return secondsPerTick * (lower + (upper - lower) / 2.0);
+}
+
+std::pair<double, double> mannWhitneyPValues(const ProfilerHistogram& baseline, double baselineSecondsPerTick,
+                                             const ProfilerHistogram& current, double currentSecondsPerTick) {
+    // (value, baseline count, current count), one entry per non-empty bucket of either histogram
+    struct RankGroup {
+        double value;
+        double baselineCount;
+        double currentCount;
+    };
+    std::vector<RankGroup> groups;
+    for (int bucket = 0; bucket < ProfilerHistogram::kBucketCount; bucket++) {
+        if (baseline.GetBucketCount(bucket) > 0) {
+            groups.push_back(RankGroup{bucketMidpointSeconds(bucket, baselineSecondsPerTick), static_cast<double>(baseline.GetBucketCount(bucket)), 0.0});
+        }
+        if (current.GetBucketCount(bucket) > 0) {
+            groups.push_back(RankGroup{bucketMidpointSeconds(bucket, currentSecondsPerTick), 0.0, static_cast<double>(current.GetBucketCount(bucket))});
+        }
+    }
+    std::sort(groups.begin(), groups.end(), [](const RankGroup& a, const RankGroup& b) { return a.value < b.value; });
+
+    // Every call in a run of equal values gets the average of the ranks they span
+    double baselineTotal = 0.0;
+    double currentTotal = 0.0;
+    double currentRankSum = 0.0;
+    double tieCorrection = 0.0;
+    double ranked = 0.0;
+    for (size_t i = 0; i < groups.size();) {
+        size_t end = i;
+        double baselineCount = 0.0;
+        double currentCount = 0.0;
+        while (end < groups.size() && groups[end].value == groups[i].value) {
+            baselineCount += groups[end].baselineCount;
+            currentCount += groups[end].currentCount;
+            end++;
+        }
+        double tied = baselineCount + currentCount;
+        double averageRank = ranked + (tied + 1.0) / 2.0;
+        currentRankSum += currentCount * averageRank;
+        tieCorrection += tied * tied * tied - tied;
+        ranked += tied;
+        baselineTotal += baselineCount;
+        currentTotal += currentCount;
+        i = end;
+    }
+
+    double total = baselineTotal + currentTotal;
+    if (baselineTotal == 0.0 || currentTotal == 0.0 || total < 2.0) {
+        return std::make_pair(1.0, 1.0);
+    }
+    double u = currentRankSum - currentTotal * (currentTotal + 1.0) / 2.0;
+    double mean = baselineTotal * currentTotal / 2.0;
+    double variance = baselineTotal * currentTotal / 12.0 * ((total + 1.0) - tieCorrection / (total * (total - 1.0)));
+    if (variance <= 0.0) {
+        return std::make_pair(1.0, 1.0);  // Every call of both runs landed in the same bucket
+    }
+    double deviation = std::sqrt(variance);
+    double zSlower = (u - mean - 0.5) / deviation;
+    double zFaster = (mean - u - 0.5) / deviation;
+    return std::make_pair(0.5 * std::erfc(zSlower / std::sqrt(2.0)), 0.5 * std::erfc(zFaster / std::sqrt(2.0)));
+}
+
+std::vector<ProfilerSectionDiff> diffProfiles(const ProfilerBinaryProfile& baseline, const ProfilerBinaryProfile& current, const ProfilerDiffOptions& options) {
+    ProfilerVector<ProfilerStats> baselineStats = mergeProfilerBinaryThreads(baseline);
+    ProfilerVector<ProfilerStats> currentStats = mergeProfilerBinaryThreads(current);
+
+    std::unordered_map<std::string, const ProfilerStats*> currentByName;
+    for (const ProfilerStats& stat : currentStats) {
+        if (stat.count > 0) {
+            currentByName.emplace(stat.sectionName, &stat);
+        }
+    }
+
+    std::vector<ProfilerSectionDiff> diffs;
+    std::unordered_map<std::string, bool> seen;
+    for (const ProfilerStats& before : baselineStats) {
+        if (before.count == 0) {
+            continue;
+        }
+        seen[before.sectionName] = true;
+
+        ProfilerSectionDiff diff;
+        diff.sectionName = before.sectionName;
+        diff.baselineCount = before.count;
+        diff.baselineMedianTime = before.p50Time;
+        diff.baselineAvgTime = before.avgTime;
+        diff.currentCount = 0;
+        diff.currentMedianTime = 0.0;
+        diff.currentAvgTime = 0.0;
+        diff.medianChangePercent = 0.0;
+        diff.pValueSlower = 1.0;
+        diff.pValueFaster = 1.0;
+
+        auto it = currentByName.find(before.sectionName);
+        if (it == currentByName.end()) {
+            diff.verdict = DIFF_MISSING;
+            diffs.push_back(diff);
+            continue;
+        }
+        const ProfilerStats& after = *it->second;
+        diff.currentCount = after.count;
+        diff.currentMedianTime = after.p50Time;
+        diff.currentAvgTime = after.avgTime;
+        if (before.p50Time > 0.0) {
+            diff.medianChangePercent = 100.0 * (after.p50Time - before.p50Time) / before.p50Time;
+        }
+
+        if (before.count < options.minCalls || after.count < options.minCalls) {
+            diff.verdict = DIFF_NOT_TESTED;
+            diffs.push_back(diff);
+            continue;
+        }
+        std::pair<double, double> pValues = mannWhitneyPValues(before.histogram, baseline.secondsPerTick, after.histogram, current.secondsPerTick);
+        diff.pValueSlower = pValues.first;
+        diff.pValueFaster = pValues.second;
+        if (diff.pValueSlower < options.alpha && diff.medianChangePercent > options.thresholdPercent) {
+            diff.verdict = DIFF_REGRESSION;
+        } else if (diff.pValueFaster < options.alpha && diff.medianChangePercent < -options.thresholdPercent) {
+            diff.verdict = DIFF_IMPROVEMENT;
+        } else {
+            diff.verdict = DIFF_UNCHANGED;
+        }
+        diffs.push_back(diff);
+    }
+
+    for (const ProfilerStats& after : currentStats) {
+        if (after.count == 0 || seen.count(after.sectionName) > 0) {
+            continue;
+        }
+        ProfilerSectionDiff diff;
+        diff.sectionName = after.sectionName;
+        diff.baselineCount = 0;
+        diff.currentCount = after.count;
+        diff.baselineMedianTime = 0.0;
+        diff.currentMedianTime = after.p50Time;
+        diff.baselineAvgTime = 0.0;
+        diff.currentAvgTime = after.avgTime;
+        diff.medianChangePercent = 0.0;
+        diff.pValueSlower = 1.0;
+        diff.pValueFaster = 1.0;
+        diff.verdict = DIFF_NEW;
+        diffs.push_back(diff);
+    }
+    return diffs;
+}
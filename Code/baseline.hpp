@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+#include "binary.hpp"
+
+using namespace std;
+
+// Describes this run for a baseline: run ID, timestamp, git commit and build flags (passed in by the makefile),
+// compiler, CPU, clock backend and profiling level. The run ID is the same for every file one process writes.
+std::vector<std::pair<std::string, std::string>> collectRunMetadata();
+
+// getRunMetadataValue: The value stored for a metadata key, or an empty string
+std::string getRunMetadataValue(const std::vector<std::pair<std::string, std::string>>& metadata, const char* key);
+
+// How each section compares between a baseline and the current run
+enum ProfilerDiffVerdict {
+    DIFF_UNCHANGED,
+    DIFF_REGRESSION,    // Significantly slower, by more than the threshold
+    DIFF_IMPROVEMENT,   // Significantly faster, by more than the threshold
+    DIFF_NOT_TESTED,    // Too few calls in one of the runs for the test to mean anything
+    DIFF_NEW,           // Only in the current run
+    DIFF_MISSING        // Only in the baseline
+};
+
+const char* GetDiffVerdictName(ProfilerDiffVerdict verdict);
+
+// ProfilerDiffOptions struct: When a change counts as a regression
+struct ProfilerDiffOptions {
+    double thresholdPercent;  // Median change needed, in percent of the baseline median
+    double alpha;             // Significance level of the one-sided Mann-Whitney U test
+    int minCalls;             // Sections with fewer calls in either run are reported but not tested
+};
+
+// ProfilerSectionDiff struct: One section's baseline and current timing and the verdict
+struct ProfilerSectionDiff {
+    std::string sectionName;
+    int baselineCount;
+    int currentCount;
+    double baselineMedianTime;  // From the latency histograms, clamped to the observed min/max
+    double currentMedianTime;
+    double baselineAvgTime;
+    double currentAvgTime;
+    double medianChangePercent;
+    double pValueSlower;  // Chance of a shift this large towards slower calls if nothing changed
+    double pValueFaster;
+    ProfilerDiffVerdict verdict;
+};
+
+// mannWhitneyPValues: One-sided Mann-Whitney U test on two latency histograms (each bucket's count placed at
+// its midpoint, ties counted half). Returns the p-values for "current is slower" and "current is faster",
+// using the normal approximation with a tie correction.
+std::pair<double, double> mannWhitneyPValues(const ProfilerHistogram& baseline, double baselineSecondsPerTick,
+                                             const ProfilerHistogram& current, double currentSecondsPerTick);
+
+// diffProfiles: Compares every section of two runs by name, in the baseline's section order, then new sections
+std::vector<ProfilerSectionDiff> diffProfiles(const ProfilerBinaryProfile& baseline, const ProfilerBinaryProfile& current, const ProfilerDiffOptions& options);
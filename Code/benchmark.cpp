@@ -0,0 +1,222 @@
+#include "benchmark.hpp"
+#include "report.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+const char* GetDistributionName(ProfilerBenchmarkDistribution distribution) {
+    switch (distribution) {
+        case DISTRIBUTION_RANDOM: return "Random";
+        case DISTRIBUTION_SORTED: return "Sorted";
+        case DISTRIBUTION_REVERSED: return "Reversed";
+        case DISTRIBUTION_NEARLY_SORTED: return "Nearly Sorted";
+        default: return "Unknown";
+    }
+}
+
+// generateBenchmarkInput: Every configuration gets its own generator, so adding a size or distribution never changes the others
+std::vector<int> generateBenchmarkInput(int size, ProfilerBenchmarkDistribution distribution, unsigned seed) {
+    PROFILE_SCOPE_LEVEL(2, "Benchmark: Generate Input");
+    std::mt19937 generator(seed + 1000003u * static_cast<unsigned>(size) + static_cast<unsigned>(distribution));
+    std::uniform_int_distribution<int> value(0, 9999);
+    std::vector<int> arr(size);
+    for (int i = 0; i < size; i++) {
+        arr[i] = value(generator);
+    }
+    if (distribution == DISTRIBUTION_RANDOM) {
+        return arr;
+    }
+
+    std::sort(arr.begin(), arr.end());
+    if (distribution == DISTRIBUTION_REVERSED) {
+        std::reverse(arr.begin(), arr.end());
+    } else if (distribution == DISTRIBUTION_NEARLY_SORTED && size > 1) {
+        std::uniform_int_distribution<int> index(0, size - 1);
+        int swaps = std::max(1, size / 100);
+        for (int i = 0; i < swaps; i++) {
+            std::swap(arr[index(generator)], arr[index(generator)]);
+        }
+    }
+    return arr;
+}
+
+// Constructor for ProfilerBenchmark: Defaults to the array main.cpp always used, in every distribution
+ProfilerBenchmark::ProfilerBenchmark()
+    : sizes(1, 5000),
+      distributions({ DISTRIBUTION_RANDOM, DISTRIBUTION_SORTED, DISTRIBUTION_REVERSED, DISTRIBUTION_NEARLY_SORTED }),
+      warmupRuns(1),
+      repetitions(9),
+      seed(12345) {}
+
+void ProfilerBenchmark::AddVariant(const char* name, ProfilerBenchmarkFunction sort, int maxSize) {
+    variantNames.push_back(name);
+    variants.push_back(sort);
+    variantMaxSizes.push_back(maxSize);
+}
+
+void ProfilerBenchmark::SetSizes(const std::vector<int>& sizes) {
+    this->sizes = sizes;
+}
+
+void ProfilerBenchmark::SetDistributions(const std::vector<ProfilerBenchmarkDistribution>& distributions) {
+    this->distributions = distributions;
+}
+
+void ProfilerBenchmark::SetRepetitions(int warmupRuns, int repetitions) {
+    this->warmupRuns = std::max(0, warmupRuns);
+    this->repetitions = std::max(1, repetitions);
+}
+
+void ProfilerBenchmark::SetSeed(unsigned seed) {
+    this->seed = seed;
+}
+
+const std::vector<ProfilerBenchmarkResult>& ProfilerBenchmark::GetResults() const {
+    return results;
+}
+
+// Run: Sizes in the outer loop so a long sweep reports its small, quick configurations first
+bool ProfilerBenchmark::Run() {
+    results.clear();
+    bool allVerified = true;
+    for (int size : sizes) {
+        for (ProfilerBenchmarkDistribution distribution : distributions) {
+            std::vector<int> input = generateBenchmarkInput(size, distribution, seed);
+            for (size_t variantIndex = 0; variantIndex < variants.size(); variantIndex++) {
+                if (variantMaxSizes[variantIndex] > 0 && size > variantMaxSizes[variantIndex]) {
+                    continue;
+                }
+                results.push_back(RunConfiguration(variantIndex, distribution, size, input));
+                if (!results.back().verified) {
+                    std::cerr << "Error: " << variantNames[variantIndex] << " did not sort the " << GetDistributionName(distribution)
+                              << " input of size " << size << " correctly" << std::endl;
+                    allVerified = false;
+                }
+            }
+        }
+    }
+    return allVerified;
+}
+
+// RunConfiguration: Warmup runs, then timed repetitions, each on a fresh copy of the input
+ProfilerBenchmarkResult ProfilerBenchmark::RunConfiguration(size_t variantIndex, ProfilerBenchmarkDistribution distribution, int size, const std::vector<int>& input) {
+    std::ostringstream sectionName;
+    sectionName << "Benchmark: " << variantNames[variantIndex] << " [" << GetDistributionName(distribution) << ", n=" << size << "]";
+    Profiler* profiler = Profiler::GetInstance();
+    int sectionId = ProfilerSectionRegistry::GetInstance()->Intern(sectionName.str().c_str());
+
+    std::vector<int> expected = input;
+    std::sort(expected.begin(), expected.end());
+
+    ProfilerBenchmarkFunction sort = variants[variantIndex];
+    for (int run = 0; run < warmupRuns; run++) {
+        std::vector<int> arr = input;
+        sort(arr);
+    }
+
+    bool verified = true;
+    std::vector<double> times;
+    std::vector<double> compensatedTimes;
+    times.reserve(repetitions);
+    compensatedTimes.reserve(repetitions);
+    double pairOverheadSeconds = profiler->GetPairOverheadSeconds();
+    for (int run = 0; run < repetitions; run++) {
+        std::vector<int> arr;
+        {
+            PROFILE_SCOPE_LEVEL(2, "Benchmark: Copy Input");  // The by-value copy every variant sorts
+            arr = input;
+        }
+        profiler->EnterSection(sectionId);
+        unsigned long long eventsAtStart = Profiler::GetRecordedEventCount();
+        ProfilerTicks start = GetCurrentTicks();
+        sort(arr);
+        ProfilerTicks stop = GetCurrentTicks();
+        unsigned long long nestedSections = (Profiler::GetRecordedEventCount() - eventsAtStart) / 2;
+        profiler->ExitSection(sectionId, __LINE__, __FILE__, __FUNCTION__);
+        times.push_back(TicksToSeconds(stop - start));
+        compensatedTimes.push_back(std::max(0.0, times.back() - nestedSections * pairOverheadSeconds));
+        verified = verified && arr == expected;
+    }
+
+    // Distribution-free interval for the median: the rank-th smallest and rank-th largest time, with rank as
+    // high as the exact binomial(n, 1/2) tail allows while each side stays within 2.5%. The normal
+    // approximation of the ranks always gave the whole range at the run counts used here.
+    std::sort(times.begin(), times.end());
+    std::sort(compensatedTimes.begin(), compensatedTimes.end());
+    int n = static_cast<int>(times.size());
+    double probability = std::pow(0.5, n);  // P(X = j) with X the number of times below the true median
+    double cumulative = probability;        // P(X <= j)
+    double tailBelow = cumulative;          // P(X <= rank - 1), the chance the median is below the interval
+    int rank = 1;
+    for (int j = 1; 2 * (j + 1) <= n; j++) {
+        probability = probability * (n - j + 1) / j;
+        cumulative += probability;
+        if (cumulative > 0.025) {
+            break;
+        }
+        rank = j + 1;
+        tailBelow = cumulative;
+    }
+    double total = 0.0;
+    for (double time : times) {
+        total += time;
+    }
+
+    ProfilerBenchmarkResult result;
+    result.variantName = variantNames[variantIndex];
+    result.distribution = distribution;
+    result.size = size;
+    result.repetitions = n;
+    result.medianTime = n % 2 == 1 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2.0;
+    result.compensatedMedianTime = n % 2 == 1 ? compensatedTimes[n / 2] : (compensatedTimes[n / 2 - 1] + compensatedTimes[n / 2]) / 2.0;
+    result.ciLowTime = times[rank - 1];
+    result.ciHighTime = times[n - rank];
+    result.ciCoverage = 1.0 - 2.0 * tailBelow;
+    result.meanTime = total / n;
+    result.minTime = times.front();
+    result.maxTime = times.back();
+    result.verified = verified;
+    return result;
+}
+
+// printResults: One line per configuration on the console
+void ProfilerBenchmark::printResults() {
+    for (const ProfilerBenchmarkResult& result : results) {
+        std::cout << result.variantName << " [" << GetDistributionName(result.distribution) << ", n=" << result.size << "]: median "
+                  << result.medianTime << " seconds, " << result.compensatedMedianTime << " compensated (" << 100.0 * result.ciCoverage << "% CI " << result.ciLowTime << " - " << result.ciHighTime << ", "
+                  << result.repetitions << " runs)" << (result.verified ? "" : "  NOT SORTED") << "\n";
+    }
+}
+
+// printResultsToCSV: Writes one row per variant, distribution and size
+void ProfilerBenchmark::printResultsToCSV(const char* fileName) {
+    std::ofstream file(fileName);  // Open the file
+
+    // Check if the file is open
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for benchmark CSV output." << std::endl;
+        return;
+    }
+
+    file << "Variant, Distribution, Size, Repetitions, Median Time, Compensated Median Time, CI Low Time, CI High Time, CI Coverage, Mean Time, Min Time, Max Time, Verified\n";
+    for (const ProfilerBenchmarkResult& result : results) {
+        writeCSVField(file, result.variantName.c_str());
+        file << ", " 
+             << GetDistributionName(result.distribution) << ", " 
+             << result.size << ", " 
+             << result.repetitions << ", " 
+             << result.medianTime << ", " 
+             << result.compensatedMedianTime << ", " 
+             << result.ciLowTime << ", " 
+             << result.ciHighTime << ", " 
+             << result.ciCoverage << ", " 
+             << result.meanTime << ", " 
+             << result.minTime << ", " 
+             << result.maxTime << ", " 
+             << (result.verified ? "yes" : "no") << "\n";
+    }
+
+    file.close();
+    std::cout << "Benchmark results written to " << fileName << " in CSV format.\n";
+}
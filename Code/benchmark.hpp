@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "profiler.hpp"
+
+using namespace std;
+
+// Input orders the benchmark sweeps over
+enum ProfilerBenchmarkDistribution {
+    DISTRIBUTION_RANDOM,         // Uniform values in [0, 10000), like generateRandomArray in main.cpp
+    DISTRIBUTION_SORTED,
+    DISTRIBUTION_REVERSED,
+    DISTRIBUTION_NEARLY_SORTED,  // Sorted, then about 1% of the elements swapped with a random partner
+    DISTRIBUTION_COUNT
+};
+
+const char* GetDistributionName(ProfilerBenchmarkDistribution distribution);
+
+// Returns size values in the given order; the same seed, size and distribution always give the same array
+std::vector<int> generateBenchmarkInput(int size, ProfilerBenchmarkDistribution distribution, unsigned seed);
+
+typedef void (*ProfilerBenchmarkFunction)(std::vector<int>&);
+
+// ProfilerBenchmarkResult struct: Timing summary of one variant on one input size and distribution
+struct ProfilerBenchmarkResult {
+    std::string variantName;
+    ProfilerBenchmarkDistribution distribution;
+    int size;
+    int repetitions;
+    double medianTime;
+    double compensatedMedianTime;  // Median after subtracting the profiler's cost of the sections each run
+                                   // recorded on the benchmarking thread (worker threads aren't counted)
+    double ciLowTime;   // Distribution-free confidence interval of the median (order statistics), at least 95%
+    double ciHighTime;  // from 6 repetitions on; with fewer it is the min-max range at ciCoverage below 95%
+    double ciCoverage;  // Exact coverage of that interval, from the binomial distribution
+    double meanTime;
+    double minTime;
+    double maxTime;
+    bool verified;  // Every repetition's output was sorted and held the same values as the input
+};
+
+// ProfilerBenchmark class: Runs registered sort variants over a sweep of input sizes and distributions.
+// Every configuration gets warmup runs, then timed repetitions on fresh copies of the same fixed-seed input.
+// Each timed repetition is also a profiler section named after the configuration, so the Profiler's own
+// reports (call tree, trace, histograms) break the sweep down the same way. Variants instrumented more
+// densely pay more profiler overhead, so the compensated median is reported next to the raw one.
+class ProfilerBenchmark {
+    public:
+        ProfilerBenchmark();
+
+        // maxSize above 0 skips the variant on larger inputs (e.g. a quadratic sort in a sweep up to millions)
+        void AddVariant(const char* name, ProfilerBenchmarkFunction sort, int maxSize = 0);
+        void SetSizes(const std::vector<int>& sizes);
+        void SetDistributions(const std::vector<ProfilerBenchmarkDistribution>& distributions);
+        void SetRepetitions(int warmupRuns, int repetitions);
+        void SetSeed(unsigned seed);
+
+        // Runs every variant on every configuration, returning false if any output was wrong
+        bool Run();
+
+        const std::vector<ProfilerBenchmarkResult>& GetResults() const;
+        void printResults();
+        void printResultsToCSV(const char* fileName);  // Charted as scaling curves by index.html
+
+    private:
+        ProfilerBenchmarkResult RunConfiguration(size_t variantIndex, ProfilerBenchmarkDistribution distribution, int size, const std::vector<int>& input);
+
+        std::vector<std::string> variantNames;
+        std::vector<ProfilerBenchmarkFunction> variants;
+        std::vector<int> variantMaxSizes;
+        std::vector<int> sizes;
+        std::vector<ProfilerBenchmarkDistribution> distributions;
+        int warmupRuns;
+        int repetitions;
+        unsigned seed;
+        std::vector<ProfilerBenchmarkResult> results;
+};
@@ -0,0 +1,679 @@
+#include "binary.hpp"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+// appendUnsigned: Appends the low `bytes` bytes of a value, least significant first
+static void appendUnsigned(std::string& out, unsigned long long value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+static void appendInt32(std::string& out, int value) {
+    appendUnsigned(out, static_cast<unsigned int>(value), 4);
+}
+
+static void appendInt64(std::string& out, long long value) {
+    appendUnsigned(out, static_cast<unsigned long long>(value), 8);
+}
+
+static void appendDouble(std::string& out, double value) {
+    unsigned long long bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    appendUnsigned(out, bits, 8);
+}
+
+// appendRecord: Appends a record header and its payload
+static void appendRecord(std::string& out, ProfilerBinaryRecordType type, const std::string& payload) {
+    out.push_back(static_cast<char>(type));
+    appendUnsigned(out, payload.size(), 4);
+    out += payload;
+}
+
+// Constructor for ProfilerBinaryWriter and Destructor
+ProfilerBinaryWriter::ProfilerBinaryWriter() : snapshotRecords(0) {}
+ProfilerBinaryWriter::~ProfilerBinaryWriter() {
+    Close();
+}
+
+// Open: Starts a new file, replacing any previous one with the same name
+bool ProfilerBinaryWriter::Open(const char* fileName) {
+    file.open(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string header(kProfilerBinaryMagic, sizeof(kProfilerBinaryMagic));
+    appendUnsigned(header, kProfilerBinaryVersion, 4);
+    file.write(header.data(), header.size());
+    file.flush();
+    stringIds.clear();
+    sectionDefined.clear();
+    metricDefined.clear();
+    return true;
+}
+
+void ProfilerBinaryWriter::Close() {
+    if (file.is_open()) {
+        file.close();
+    }
+}
+
+void ProfilerBinaryWriter::WriteMetadata(const std::vector<std::pair<std::string, std::string>>& metadata) {
+    std::string records;
+    for (const auto& entry : metadata) {
+        std::string payload = entry.first;
+        payload.push_back('\0');
+        payload += entry.second;
+        appendRecord(records, BINARY_RECORD_METADATA, payload);
+    }
+    file.write(records.data(), records.size());
+    file.flush();
+}
+
+void ProfilerBinaryWriter::BeginSnapshot(double secondsPerTick, double innerOverheadTicks, double pairOverheadTicks, double secondsSinceStart) {
+    snapshot.clear();
+    snapshotRecords = 0;
+    std::string payload;
+    appendDouble(payload, secondsPerTick);
+    appendDouble(payload, innerOverheadTicks);
+    appendDouble(payload, pairOverheadTicks);
+    appendDouble(payload, secondsSinceStart);
+    appendRecord(snapshot, BINARY_RECORD_SNAPSHOT_BEGIN, payload);
+}
+
+unsigned ProfilerBinaryWriter::GetStringId(const char* text) {
+    if (text == nullptr) {
+        text = "";
+    }
+    auto it = stringIds.find(text);
+    if (it != stringIds.end()) {
+        return it->second;
+    }
+    unsigned stringId = static_cast<unsigned>(stringIds.size());
+    stringIds.emplace(text, stringId);
+    std::string payload;
+    appendUnsigned(payload, stringId, 4);
+    payload += text;
+    appendRecord(snapshot, BINARY_RECORD_STRING, payload);
+    return stringId;
+}
+
+void ProfilerBinaryWriter::DefineSection(int sectionId) {
+    if (sectionId < 0) {
+        return;  // The call tree's root
+    }
+    if (sectionId >= static_cast<int>(sectionDefined.size())) {
+        sectionDefined.resize(sectionId + 1, false);
+    }
+    if (sectionDefined[sectionId]) {
+        return;
+    }
+    sectionDefined[sectionId] = true;
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    unsigned nameId = GetStringId(registry->GetName(sectionId));
+    std::string payload;
+    appendInt32(payload, sectionId);
+    appendUnsigned(payload, nameId, 4);
+    appendInt32(payload, registry->GetSampleEvery(sectionId));
+    appendRecord(snapshot, BINARY_RECORD_SECTION, payload);
+}
+
+void ProfilerBinaryWriter::DefineMetric(int metricId) {
+    if (metricId >= static_cast<int>(metricDefined.size())) {
+        metricDefined.resize(metricId + 1, false);
+    }
+    if (metricDefined[metricId]) {
+        return;
+    }
+    metricDefined[metricId] = true;
+    unsigned nameId = GetStringId(ProfilerSectionRegistry::GetInstance()->GetMetricName(metricId));
+    std::string payload;
+    appendInt32(payload, metricId);
+    appendUnsigned(payload, nameId, 4);
+    appendRecord(snapshot, BINARY_RECORD_METRIC, payload);
+}
+
+// WriteThread: Adds one thread's recorded sections and call tree (root included) to the snapshot
+void ProfilerBinaryWriter::WriteThread(int threadId, const ProfilerVector<ProfilerStats>& stats, const ProfilerVector<ProfilerCallNode>& callTree) {
+    std::string payload;
+    for (size_t sectionId = 0; sectionId < stats.size(); sectionId++) {
+        const ProfilerStats& stat = stats[sectionId];
+        if (!stat.HasData()) {
+            continue;
+        }
+        DefineSection(static_cast<int>(sectionId));
+        unsigned fileId = GetStringId(stat.fileName);
+        unsigned functionId = GetStringId(stat.functionName);
+
+        payload.clear();
+        appendInt32(payload, threadId);
+        appendInt32(payload, static_cast<int>(sectionId));
+        appendInt64(payload, stat.count);
+        appendInt64(payload, stat.totalTicks);
+        appendInt64(payload, stat.minTicks);
+        appendInt64(payload, stat.maxTicks);
+        appendInt64(payload, stat.selfTicks);
+        appendInt64(payload, stat.compensatedTotalTicks);
+        appendInt64(payload, stat.compensatedSelfTicks);
+        appendUnsigned(payload, fileId, 4);
+        appendUnsigned(payload, functionId, 4);
+        appendInt32(payload, stat.lineNumber);
+
+        // Only the non-empty buckets, most sections touch a few dozen of the 1408
+        size_t bucketCountOffset = payload.size();
+        appendUnsigned(payload, 0, 4);
+        unsigned nonEmptyBuckets = 0;
+        for (int bucket = 0; bucket < ProfilerHistogram::kBucketCount; bucket++) {
+            unsigned int bucketCount = stat.histogram.GetBucketCount(bucket);
+            if (bucketCount != 0) {
+                appendUnsigned(payload, bucket, 2);
+                appendUnsigned(payload, bucketCount, 4);
+                nonEmptyBuckets++;
+            }
+        }
+        std::string bucketCountBytes;
+        appendUnsigned(bucketCountBytes, nonEmptyBuckets, 4);
+        payload.replace(bucketCountOffset, 4, bucketCountBytes);
+
+        appendRecord(snapshot, BINARY_RECORD_STATS, payload);
+        snapshotRecords++;
+
+        if (stat.counterCalls > 0) {
+            payload.clear();
+            appendInt32(payload, threadId);
+            appendInt32(payload, static_cast<int>(sectionId));
+            appendInt64(payload, stat.counterCalls);
+            appendUnsigned(payload, stat.counterMask, 4);
+            for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+                if (stat.counterMask & (1u << event)) {
+                    appendUnsigned(payload, stat.counterTotals[event], 8);
+                }
+            }
+            appendRecord(snapshot, BINARY_RECORD_COUNTERS, payload);
+            snapshotRecords++;
+        }
+
+        if (stat.allocationCount > 0 || stat.freedBytes > 0) {
+            payload.clear();
+            appendInt32(payload, threadId);
+            appendInt32(payload, static_cast<int>(sectionId));
+            appendInt64(payload, stat.allocationCount);
+            appendInt64(payload, stat.allocatedBytes);
+            appendInt64(payload, stat.freedBytes);
+            appendInt64(payload, stat.peakLiveBytes);
+            appendRecord(snapshot, BINARY_RECORD_ALLOCATIONS, payload);
+            snapshotRecords++;
+        }
+
+        if (stat.metricMask != 0) {
+            for (int metric = 0; metric < ProfilerSectionRegistry::kMaxMetrics; metric++) {
+                if (stat.metricMask & (1u << metric)) {
+                    DefineMetric(metric);
+                }
+            }
+            payload.clear();
+            appendInt32(payload, threadId);
+            appendInt32(payload, static_cast<int>(sectionId));
+            appendUnsigned(payload, stat.metricMask, 4);
+            for (int metric = 0; metric < ProfilerSectionRegistry::kMaxMetrics; metric++) {
+                if (stat.metricMask & (1u << metric)) {
+                    appendInt64(payload, stat.metricTotals[metric]);
+                }
+            }
+            appendRecord(snapshot, BINARY_RECORD_METRICS, payload);
+            snapshotRecords++;
+        }
+
+        if (stat.asyncCount > 0) {
+            payload.clear();
+            appendInt32(payload, threadId);
+            appendInt32(payload, static_cast<int>(sectionId));
+            appendInt64(payload, stat.asyncCount);
+            appendInt64(payload, stat.handOffCount);
+            appendInt64(payload, stat.queueTicks);
+            appendInt64(payload, stat.maxQueueTicks);
+            appendRecord(snapshot, BINARY_RECORD_ASYNC, payload);
+            snapshotRecords++;
+        }
+
+        if (stat.outermostCount != stat.count) {
+            payload.clear();
+            appendInt32(payload, threadId);
+            appendInt32(payload, static_cast<int>(sectionId));
+            appendInt64(payload, stat.outermostCount);
+            appendRecord(snapshot, BINARY_RECORD_RECURSION, payload);
+            snapshotRecords++;
+        }
+    }
+
+    for (size_t nodeIndex = 0; nodeIndex < callTree.size(); nodeIndex++) {
+        const ProfilerCallNode& node = callTree[nodeIndex];
+        DefineSection(node.sectionId);
+
+        payload.clear();
+        appendInt32(payload, threadId);
+        appendInt32(payload, static_cast<int>(nodeIndex));
+        appendInt32(payload, node.parentIndex);
+        appendInt32(payload, node.sectionId);
+        appendInt32(payload, node.depth);
+        appendInt64(payload, node.count);
+        appendInt64(payload, node.inclusiveTicks);
+        appendInt64(payload, node.selfTicks);
+        appendInt64(payload, node.compensatedInclusiveTicks);
+        appendInt64(payload, node.compensatedSelfTicks);
+        appendRecord(snapshot, BINARY_RECORD_CALL_NODE, payload);
+        snapshotRecords++;
+    }
+}
+
+// EndSnapshot: Writes the finished snapshot in one go and pushes it to the OS
+void ProfilerBinaryWriter::EndSnapshot() {
+    std::string payload;
+    appendUnsigned(payload, snapshotRecords, 4);
+    appendRecord(snapshot, BINARY_RECORD_SNAPSHOT_END, payload);
+    file.write(snapshot.data(), snapshot.size());
+    file.flush();
+    snapshot.clear();
+}
+
+// ProfilerBinaryCursor class: Bounds-checked little-endian reads from one record's payload
+class ProfilerBinaryCursor {
+    public:
+        ProfilerBinaryCursor(const char* data, size_t size) : data(data), size(size), offset(0), failed(false) {}
+
+        unsigned long long ReadUnsigned(int bytes) {
+            if (failed || size - offset < static_cast<size_t>(bytes)) {
+                failed = true;
+                return 0;
+            }
+            unsigned long long value = 0;
+            for (int i = 0; i < bytes; i++) {
+                value |= static_cast<unsigned long long>(static_cast<unsigned char>(data[offset + i])) << (8 * i);
+            }
+            offset += bytes;
+            return value;
+        }
+        int ReadInt32() {
+            return static_cast<int>(static_cast<unsigned int>(ReadUnsigned(4)));
+        }
+        long long ReadInt64() {
+            return static_cast<long long>(ReadUnsigned(8));
+        }
+        double ReadDouble() {
+            unsigned long long bits = ReadUnsigned(8);
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        std::string ReadRest() {
+            std::string rest(data + offset, size - offset);
+            offset = size;
+            return rest;
+        }
+
+        const char* data;
+        size_t size;
+        size_t offset;
+        bool failed;
+};
+
+// findThread: Returns the snapshot's entry for a thread, adding it the first time the thread is seen
+static ProfilerBinaryThread& findThread(std::vector<ProfilerBinaryThread>& threads, int threadId) {
+    for (ProfilerBinaryThread& thread : threads) {
+        if (thread.threadId == threadId) {
+            return thread;
+        }
+    }
+    threads.push_back(ProfilerBinaryThread{threadId, ProfilerVector<ProfilerStats>(), ProfilerVector<ProfilerCallNode>()});
+    return threads.back();
+}
+
+// stringFor: The text of a string ID, or an empty string if the ID was never defined
+static const char* stringFor(const ProfilerBinaryProfile& profile, unsigned stringId) {
+    return stringId < profile.strings.size() ? profile.strings[stringId].c_str() : "";
+}
+
+bool readProfilerBinaryFile(const char* fileName, ProfilerBinaryProfile& profile) {
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << fileName << " for reading." << std::endl;
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    const std::string data = contents.str();
+
+    if (data.size() < 8 || std::memcmp(data.data(), kProfilerBinaryMagic, sizeof(kProfilerBinaryMagic)) != 0) {
+        std::cerr << fileName << " is not a binary profile." << std::endl;
+        return false;
+    }
+    ProfilerBinaryCursor header(data.data() + 4, 4);
+    unsigned version = static_cast<unsigned>(header.ReadUnsigned(4));
+    if (version > kProfilerBinaryVersion) {
+        std::cerr << fileName << " is binary profile version " << version << ", this build reads up to version " << kProfilerBinaryVersion << "." << std::endl;
+        return false;
+    }
+
+    profile.secondsPerTick = 0.0;
+    profile.innerOverheadTicks = 0.0;
+    profile.pairOverheadTicks = 0.0;
+    profile.secondsSinceStart = 0.0;
+    profile.snapshotCount = 0;
+    profile.truncated = false;
+    profile.corrupt = false;
+    profile.metadata.clear();
+    profile.strings.clear();
+    profile.sectionNames.clear();
+    profile.sectionSampleEvery.clear();
+    profile.metricNames.clear();
+    profile.threads.clear();
+
+    // The snapshot being read only replaces the profile's threads once its end record is reached
+    std::vector<ProfilerBinaryThread> pendingThreads;
+    double pendingHeader[4] = { 0.0, 0.0, 0.0, 0.0 };
+    bool inSnapshot = false;
+
+    size_t offset = 8;
+    while (offset < data.size() && !profile.corrupt) {
+        if (data.size() - offset < 5) {
+            profile.truncated = true;
+            break;
+        }
+        ProfilerBinaryCursor recordHeader(data.data() + offset, 5);
+        int type = static_cast<int>(recordHeader.ReadUnsigned(1));
+        size_t length = static_cast<size_t>(recordHeader.ReadUnsigned(4));
+        if (data.size() - offset - 5 < length) {
+            profile.truncated = true;
+            break;
+        }
+        ProfilerBinaryCursor record(data.data() + offset + 5, length);
+        offset += 5 + length;
+
+        switch (type) {
+            case BINARY_RECORD_STRING: {
+                unsigned stringId = static_cast<unsigned>(record.ReadUnsigned(4));
+                if (record.failed) {
+                    break;
+                }
+                // The writer numbers strings in order, so an ID past the next one can only come from damage
+                if (stringId > profile.strings.size()) {
+                    profile.corrupt = true;
+                    break;
+                }
+                if (stringId == profile.strings.size()) {
+                    profile.strings.emplace_back();
+                }
+                profile.strings[stringId] = record.ReadRest();
+                break;
+            }
+            case BINARY_RECORD_SECTION: {
+                int sectionId = record.ReadInt32();
+                int nameId = static_cast<int>(record.ReadUnsigned(4));
+                int sampleEvery = record.ReadInt32();
+                if (record.failed) {
+                    break;
+                }
+                if (sectionId < 0 || sectionId >= ProfilerSectionRegistry::kMaxSections) {
+                    profile.corrupt = true;
+                    break;
+                }
+                if (sectionId >= static_cast<int>(profile.sectionNames.size())) {
+                    profile.sectionNames.resize(sectionId + 1, -1);
+                    profile.sectionSampleEvery.resize(sectionId + 1, 1);
+                }
+                profile.sectionNames[sectionId] = nameId;
+                profile.sectionSampleEvery[sectionId] = sampleEvery;
+                break;
+            }
+            case BINARY_RECORD_SNAPSHOT_BEGIN: {
+                for (int i = 0; i < 4; i++) {
+                    pendingHeader[i] = record.ReadDouble();
+                }
+                pendingThreads.clear();
+                inSnapshot = !record.failed;
+                break;
+            }
+            case BINARY_RECORD_STATS: {
+                int threadId = record.ReadInt32();
+                int sectionId = record.ReadInt32();
+                if (!inSnapshot || record.failed || sectionId < 0 || sectionId >= static_cast<int>(profile.sectionNames.size())) {
+                    break;
+                }
+                ProfilerVector<ProfilerStats>& stats = findThread(pendingThreads, threadId).stats;
+                while (static_cast<int>(stats.size()) <= sectionId) {
+                    int nameId = profile.sectionNames[stats.size()];
+                    stats.emplace_back(nameId >= 0 ? stringFor(profile, nameId) : "");
+                }
+                ProfilerStats& stat = stats[sectionId];
+                stat.count = static_cast<int>(record.ReadInt64());
+                stat.outermostCount = stat.count;  // Unless a recursion record follows
+                stat.totalTicks = record.ReadInt64();
+                stat.minTicks = record.ReadInt64();
+                stat.maxTicks = record.ReadInt64();
+                stat.selfTicks = record.ReadInt64();
+                stat.compensatedTotalTicks = record.ReadInt64();
+                stat.compensatedSelfTicks = record.ReadInt64();
+                stat.fileName = stringFor(profile, static_cast<unsigned>(record.ReadUnsigned(4)));
+                stat.functionName = stringFor(profile, static_cast<unsigned>(record.ReadUnsigned(4)));
+                stat.lineNumber = record.ReadInt32();
+                stat.sampleEvery = profile.sectionSampleEvery[sectionId];
+                unsigned nonEmptyBuckets = static_cast<unsigned>(record.ReadUnsigned(4));
+                for (unsigned i = 0; i < nonEmptyBuckets && !record.failed; i++) {
+                    int bucket = static_cast<int>(record.ReadUnsigned(2));
+                    unsigned int bucketCount = static_cast<unsigned int>(record.ReadUnsigned(4));
+                    if (!record.failed && bucket < ProfilerHistogram::kBucketCount) {
+                        stat.histogram.AddToBucket(bucket, bucketCount);
+                    }
+                }
+                break;
+            }
+            case BINARY_RECORD_COUNTERS: {
+                int threadId = record.ReadInt32();
+                int sectionId = record.ReadInt32();
+                long long counterCalls = record.ReadInt64();
+                unsigned mask = static_cast<unsigned>(record.ReadUnsigned(4));
+                if (!inSnapshot || record.failed || sectionId < 0) {
+                    break;
+                }
+                ProfilerVector<ProfilerStats>& stats = findThread(pendingThreads, threadId).stats;
+                if (sectionId >= static_cast<int>(stats.size())) {
+                    break;  // No stats record for the section
+                }
+                ProfilerStats& stat = stats[sectionId];
+                stat.counterCalls = static_cast<int>(counterCalls);
+                for (int event = 0; event < 32 && !record.failed; event++) {
+                    if ((mask & (1u << event)) == 0) {
+                        continue;
+                    }
+                    unsigned long long total = record.ReadUnsigned(8);
+                    if (event < COUNTER_EVENT_COUNT) {  // Events from a newer writer are skipped
+                        stat.counterTotals[event] = total;
+                        stat.counterMask |= 1u << event;
+                    }
+                }
+                break;
+            }
+            case BINARY_RECORD_ALLOCATIONS: {
+                int threadId = record.ReadInt32();
+                int sectionId = record.ReadInt32();
+                long long allocationCount = record.ReadInt64();
+                long long allocatedBytes = record.ReadInt64();
+                long long freedBytes = record.ReadInt64();
+                long long peakLiveBytes = record.ReadInt64();
+                if (!inSnapshot || record.failed || sectionId < 0) {
+                    break;
+                }
+                ProfilerVector<ProfilerStats>& stats = findThread(pendingThreads, threadId).stats;
+                if (sectionId >= static_cast<int>(stats.size())) {
+                    break;  // No stats record for the section
+                }
+                ProfilerStats& stat = stats[sectionId];
+                stat.allocationCount = allocationCount;
+                stat.allocatedBytes = allocatedBytes;
+                stat.freedBytes = freedBytes;
+                stat.peakLiveBytes = peakLiveBytes;
+                break;
+            }
+            case BINARY_RECORD_METRIC: {
+                int metricId = record.ReadInt32();
+                int nameId = static_cast<int>(record.ReadUnsigned(4));
+                if (record.failed || metricId < 0 || metricId >= ProfilerSectionRegistry::kMaxMetrics) {
+                    break;
+                }
+                if (metricId >= static_cast<int>(profile.metricNames.size())) {
+                    profile.metricNames.resize(metricId + 1, -1);
+                }
+                profile.metricNames[metricId] = nameId;
+                break;
+            }
+            case BINARY_RECORD_METRICS: {
+                int threadId = record.ReadInt32();
+                int sectionId = record.ReadInt32();
+                unsigned mask = static_cast<unsigned>(record.ReadUnsigned(4));
+                if (!inSnapshot || record.failed || sectionId < 0) {
+                    break;
+                }
+                ProfilerVector<ProfilerStats>& stats = findThread(pendingThreads, threadId).stats;
+                if (sectionId >= static_cast<int>(stats.size())) {
+                    break;  // No stats record for the section
+                }
+                ProfilerStats& stat = stats[sectionId];
+                for (int metric = 0; metric < 32 && !record.failed; metric++) {
+                    if ((mask & (1u << metric)) == 0) {
+                        continue;
+                    }
+                    long long total = record.ReadInt64();
+                    if (metric < ProfilerSectionRegistry::kMaxMetrics && !record.failed) {  // Metrics past this build's table are skipped
+                        stat.metricTotals[metric] = total;
+                        stat.metricMask |= 1u << metric;
+                    }
+                }
+                break;
+            }
+            case BINARY_RECORD_ASYNC: {
+                int threadId = record.ReadInt32();
+                int sectionId = record.ReadInt32();
+                long long asyncCount = record.ReadInt64();
+                long long handOffCount = record.ReadInt64();
+                long long queueTicks = record.ReadInt64();
+                long long maxQueueTicks = record.ReadInt64();
+                if (!inSnapshot || record.failed || sectionId < 0) {
+                    break;
+                }
+                ProfilerVector<ProfilerStats>& stats = findThread(pendingThreads, threadId).stats;
+                if (sectionId >= static_cast<int>(stats.size())) {
+                    break;  // No stats record for the section
+                }
+                ProfilerStats& stat = stats[sectionId];
+                stat.asyncCount = asyncCount;
+                stat.handOffCount = handOffCount;
+                stat.queueTicks = queueTicks;
+                stat.maxQueueTicks = maxQueueTicks;
+                break;
+            }
+            case BINARY_RECORD_RECURSION: {
+                int threadId = record.ReadInt32();
+                int sectionId = record.ReadInt32();
+                long long outermostCount = record.ReadInt64();
+                if (!inSnapshot || record.failed || sectionId < 0) {
+                    break;
+                }
+                ProfilerVector<ProfilerStats>& stats = findThread(pendingThreads, threadId).stats;
+                if (sectionId >= static_cast<int>(stats.size())) {
+                    break;  // No stats record for the section
+                }
+                stats[sectionId].outermostCount = static_cast<int>(outermostCount);
+                break;
+            }
+            case BINARY_RECORD_CALL_NODE: {
+                int threadId = record.ReadInt32();
+                int nodeIndex = record.ReadInt32();
+                int parentIndex = record.ReadInt32();
+                int sectionId = record.ReadInt32();
+                int depth = record.ReadInt32();
+                if (!inSnapshot || record.failed) {
+                    break;
+                }
+                // Only the root has no section; any other node's section must have been defined already
+                if (sectionId >= 0 && (sectionId >= static_cast<int>(profile.sectionNames.size()) || profile.sectionNames[sectionId] < 0)) {
+                    profile.corrupt = true;
+                    break;
+                }
+                ProfilerVector<ProfilerCallNode>& callTree = findThread(pendingThreads, threadId).callTree;
+
+                // Nodes are written parents first, in index order, so every parent already exists
+                if (nodeIndex != static_cast<int>(callTree.size()) || parentIndex >= nodeIndex || (nodeIndex > 0 && parentIndex < 0)) {
+                    break;
+                }
+                callTree.emplace_back(sectionId, parentIndex, depth);
+                ProfilerCallNode& node = callTree.back();
+                node.count = static_cast<int>(record.ReadInt64());
+                node.inclusiveTicks = record.ReadInt64();
+                node.selfTicks = record.ReadInt64();
+                node.compensatedInclusiveTicks = record.ReadInt64();
+                node.compensatedSelfTicks = record.ReadInt64();
+                if (parentIndex >= 0) {
+                    callTree[parentIndex].children.push_back(nodeIndex);
+                }
+                break;
+            }
+            case BINARY_RECORD_SNAPSHOT_END: {
+                if (!inSnapshot) {
+                    break;
+                }
+                profile.secondsPerTick = pendingHeader[0];
+                profile.innerOverheadTicks = pendingHeader[1];
+                profile.pairOverheadTicks = pendingHeader[2];
+                profile.secondsSinceStart = pendingHeader[3];
+                profile.threads.swap(pendingThreads);
+                profile.snapshotCount++;
+                pendingThreads.clear();
+                inSnapshot = false;
+                break;
+            }
+            case BINARY_RECORD_METADATA: {
+                std::string entry = record.ReadRest();
+                size_t separator = entry.find('\0');
+                if (separator != std::string::npos) {
+                    profile.metadata.emplace_back(entry.substr(0, separator), entry.substr(separator + 1));
+                }
+                break;
+            }
+            default:
+                break;  // A record type from a newer writer
+        }
+    }
+    if (inSnapshot) {
+        profile.truncated = true;
+    }
+    if (profile.corrupt) {
+        std::cerr << "Warning: " << fileName << " has a record with an impossible ID before byte " << offset << ", the rest of the file was not read." << std::endl;
+    }
+
+    if (profile.snapshotCount == 0) {
+        std::cerr << fileName << " has no complete snapshot." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+ProfilerVector<ProfilerStats> mergeProfilerBinaryThreads(const ProfilerBinaryProfile& profile) {
+    ProfilerVector<ProfilerStats> merged;
+    for (size_t sectionId = 0; sectionId < profile.sectionNames.size(); sectionId++) {
+        int nameId = profile.sectionNames[sectionId];
+        merged.emplace_back(nameId >= 0 ? stringFor(profile, nameId) : "");
+        merged.back().sampleEvery = profile.sectionSampleEvery[sectionId];
+    }
+    for (const ProfilerBinaryThread& thread : profile.threads) {
+        for (size_t sectionId = 0; sectionId < thread.stats.size() && sectionId < merged.size(); sectionId++) {
+            if (thread.stats[sectionId].HasData()) {
+                merged[sectionId].Merge(thread.stats[sectionId]);
+            }
+        }
+    }
+    for (ProfilerStats& stat : merged) {
+        stat.ConvertTicksToSeconds(profile.secondsPerTick);
+    }
+    return merged;
+}
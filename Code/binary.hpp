@@ -0,0 +1,105 @@
+#pragma once
+#include <deque>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "profiler.hpp"
+
+using namespace std;
+
+// Binary profile format, version 1. All integers are little-endian and doubles are IEEE 754 bit patterns
+// stored the same way. A file is an 8-byte header ("PROF" then a uint32 version) followed by records, each
+// a uint8 type, a uint32 payload length and the payload, so readers can skip record types they don't know.
+//
+// The Profiler appends a snapshot of every thread's raw stats and call tree each time it flushes. Each
+// snapshot is complete on its own, so a reader only needs the last one whose end record made it to disk;
+// a snapshot cut short by the process dying is ignored. Strings and sections are defined once per file, the
+// first time a snapshot refers to them.
+static const char kProfilerBinaryMagic[4] = { 'P', 'R', 'O', 'F' };
+static const unsigned kProfilerBinaryVersion = 1;
+
+enum ProfilerBinaryRecordType {
+    BINARY_RECORD_STRING = 1,          // uint32 string ID, then the bytes (no terminator)
+    BINARY_RECORD_SECTION = 2,         // int32 section ID, uint32 name string ID, int32 sample every
+    BINARY_RECORD_SNAPSHOT_BEGIN = 3,  // double seconds per tick, double inner and pair overhead ticks, double seconds since start
+    BINARY_RECORD_STATS = 4,           // int32 thread, int32 section, int64 count, six int64 tick totals (total, min, max, self,
+                                       // compensated total, compensated self), uint32 file and function string IDs, int32 line,
+                                       // uint32 bucket count, then a uint16 bucket index and uint32 count per non-empty bucket
+    BINARY_RECORD_CALL_NODE = 5,       // int32 thread, node, parent, section, depth, int64 count, four int64 tick totals
+    BINARY_RECORD_SNAPSHOT_END = 6,    // uint32 number of stats, counter, allocation, metric, async, recursion and call node records in the snapshot
+    BINARY_RECORD_METADATA = 7,        // Key bytes, a zero byte, then value bytes (written once, before the first snapshot)
+    BINARY_RECORD_COUNTERS = 8,        // int32 thread, int32 section, int64 counted calls, uint32 event mask, then a uint64
+                                       // total per event in the mask, lowest bit first (follows the section's stats record)
+    BINARY_RECORD_ALLOCATIONS = 9,     // int32 thread, int32 section, int64 allocations, allocated bytes, freed bytes and
+                                       // peak live bytes (follows the section's stats record)
+    BINARY_RECORD_METRIC = 10,         // int32 custom counter (metric) ID, uint32 name string ID
+    BINARY_RECORD_METRICS = 11,        // int32 thread, int32 section, uint32 metric mask, then an int64 total per metric in
+                                       // the mask, lowest bit first (follows the section's stats record)
+    BINARY_RECORD_ASYNC = 12,          // int32 thread, int32 section, int64 async spans, hand-offs, queue ticks and longest
+                                       // hand-off in ticks (follows the section's stats record)
+    BINARY_RECORD_RECURSION = 13       // int32 thread, int32 section, int64 outermost calls (follows the section's stats record,
+                                       // only when some calls were nested; without it every call was outermost)
+};
+
+// ProfilerBinaryWriter class: Appends snapshots to a binary profile file. A whole snapshot is built in memory
+// and written with a single write and flush, so the profiled process pays for one I/O call per snapshot.
+class ProfilerBinaryWriter {
+    public:
+        ProfilerBinaryWriter();
+        ~ProfilerBinaryWriter();
+
+        bool Open(const char* fileName);
+        void Close();
+
+        // Describes the run (see collectRunMetadata in baseline.hpp), written straight to the file
+        void WriteMetadata(const std::vector<std::pair<std::string, std::string>>& metadata);
+
+        void BeginSnapshot(double secondsPerTick, double innerOverheadTicks, double pairOverheadTicks, double secondsSinceStart);
+        void WriteThread(int threadId, const ProfilerVector<ProfilerStats>& stats, const ProfilerVector<ProfilerCallNode>& callTree);
+        void EndSnapshot();
+
+    private:
+        unsigned GetStringId(const char* text);  // Defines the string in the snapshot the first time its pointer is seen
+        void DefineSection(int sectionId);
+        void DefineMetric(int metricId);
+
+        std::ofstream file;
+        std::string snapshot;  // Records of the snapshot being built
+        unsigned snapshotRecords;
+        std::unordered_map<const char*, unsigned> stringIds;
+        std::vector<bool> sectionDefined;  // Indexed by section ID
+        std::vector<bool> metricDefined;   // Indexed by metric ID
+};
+
+// ProfilerBinaryThread struct: One thread's raw stats (indexed by the file's section IDs) and call tree
+struct ProfilerBinaryThread {
+    int threadId;
+    ProfilerVector<ProfilerStats> stats;
+    ProfilerVector<ProfilerCallNode> callTree;
+};
+
+// ProfilerBinaryProfile struct: The last complete snapshot of a binary profile file. The stats point into
+// strings, so a profile must stay where it was read into for as long as they are used.
+struct ProfilerBinaryProfile {
+    double secondsPerTick;
+    double innerOverheadTicks;
+    double pairOverheadTicks;
+    double secondsSinceStart;
+    int snapshotCount;
+    bool truncated;  // The file ended in the middle of a snapshot, which was ignored
+    bool corrupt;    // A record held an impossible string or section ID; nothing from it on was read
+    std::vector<std::pair<std::string, std::string>> metadata;
+    std::deque<std::string> strings;  // Indexed by string ID; a deque so adding strings never moves earlier ones
+    std::vector<int> sectionNames;    // String ID of each section's name, -1 if the section was never defined
+    std::vector<int> sectionSampleEvery;
+    std::vector<int> metricNames;     // String ID of each custom counter's name, -1 if the metric was never defined
+    std::vector<ProfilerBinaryThread> threads;
+};
+
+// mergeProfilerBinaryThreads: Every thread's stats merged per section (indexed by the file's section IDs) and
+// converted to seconds with the file's tick length
+ProfilerVector<ProfilerStats> mergeProfilerBinaryThreads(const ProfilerBinaryProfile& profile);
+
+// readProfilerBinaryFile: Reads the last complete snapshot of a file, returning false (after printing why) if there is none
+bool readProfilerBinaryFile(const char* fileName, ProfilerBinaryProfile& profile);
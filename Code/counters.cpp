@@ -0,0 +1,288 @@
+#include "counters.hpp"
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PROFILER_HAS_PERF_EVENTS 1
+#else
+#define PROFILER_HAS_PERF_EVENTS 0
+#endif
+
+#if PROFILER_HAS_PERF_EVENTS && (defined(__x86_64__) || defined(__i386__))
+#define PROFILER_HAS_RDPMC 1
+#else
+#define PROFILER_HAS_RDPMC 0
+#endif
+
+static int gLastCounterError = 0;  // errno of the last perf_event_open that failed, 0 if none did
+
+const char* GetCounterEventName(ProfilerCounterEvent event) {
+    switch (event) {
+        case COUNTER_CYCLES: return "Cycles";
+        case COUNTER_INSTRUCTIONS: return "Instructions";
+        case COUNTER_CACHE_REFERENCES: return "Cache References";
+        case COUNTER_CACHE_MISSES: return "Cache Misses";
+        case COUNTER_BRANCHES: return "Branches";
+        case COUNTER_BRANCH_MISSES: return "Branch Misses";
+        case COUNTER_PAGE_FAULTS: return "Page Faults";
+        case COUNTER_CONTEXT_SWITCHES: return "Context Switches";
+        default: return "unknown";
+    }
+}
+
+std::vector<ProfilerCounterEvent> GetDefaultCounterEvents() {
+    return std::vector<ProfilerCounterEvent>{ COUNTER_CYCLES, COUNTER_INSTRUCTIONS, COUNTER_CACHE_REFERENCES,
+                                              COUNTER_CACHE_MISSES, COUNTER_BRANCHES, COUNTER_BRANCH_MISSES };
+}
+
+bool ParseCounterEvents(const char* names, std::vector<ProfilerCounterEvent>& events) {
+    static const char* const perfNames[COUNTER_EVENT_COUNT] = {
+        "cycles", "instructions", "cache-references", "cache-misses",
+        "branches", "branch-misses", "page-faults", "context-switches"
+    };
+    events.clear();
+    std::string list = names;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string name = list.substr(start, end - start);
+        if (!name.empty()) {
+            int event = 0;
+            while (event < COUNTER_EVENT_COUNT && name != perfNames[event]) {
+                event++;
+            }
+            if (event == COUNTER_EVENT_COUNT) {
+                return false;
+            }
+            events.push_back(static_cast<ProfilerCounterEvent>(event));
+        }
+        start = end + 1;
+    }
+    return !events.empty();
+}
+
+const char* GetCounterUnavailableReason() {
+#if PROFILER_HAS_PERF_EVENTS
+    if (gLastCounterError == EACCES || gLastCounterError == EPERM) {
+        return "perf_event_open not permitted (see /proc/sys/kernel/perf_event_paranoid)";
+    }
+    if (gLastCounterError == ENOENT || gLastCounterError == EOPNOTSUPP || gLastCounterError == ENODEV) {
+        return "the CPU or kernel does not expose these events (no PMU, e.g. in a VM)";
+    }
+    return gLastCounterError != 0 ? std::strerror(gLastCounterError) : "no events requested";
+#else
+    return "performance counters are only supported on Linux";
+#endif
+}
+
+#if PROFILER_HAS_PERF_EVENTS
+// isHardwareEvent: Whether the event lives on the PMU (and can join the rdpmc group)
+static bool isHardwareEvent(ProfilerCounterEvent event) {
+    return event != COUNTER_PAGE_FAULTS && event != COUNTER_CONTEXT_SWITCHES;
+}
+
+// openEvent: Opens one event on the calling thread, any CPU, as part of groupLeader's group (or as a new
+// leader if that is -1). Kernel time is included when allowed, otherwise only user space is counted.
+static int openEvent(ProfilerCounterEvent event, int groupLeader) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.read_format = PERF_FORMAT_GROUP;
+    switch (event) {
+        case COUNTER_CYCLES: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case COUNTER_INSTRUCTIONS: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case COUNTER_CACHE_REFERENCES: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CACHE_REFERENCES; break;
+        case COUNTER_CACHE_MISSES: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+        case COUNTER_BRANCHES: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS; break;
+        case COUNTER_BRANCH_MISSES: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+        case COUNTER_PAGE_FAULTS: attr.type = PERF_TYPE_SOFTWARE; attr.config = PERF_COUNT_SW_PAGE_FAULTS; break;
+        case COUNTER_CONTEXT_SWITCHES: attr.type = PERF_TYPE_SOFTWARE; attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES; break;
+        default: return -1;
+    }
+
+    for (int userOnly = 0; userOnly < 2; userOnly++) {
+        attr.exclude_kernel = userOnly;
+        attr.exclude_hv = userOnly;
+        int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, groupLeader, 0));
+        if (fd >= 0) {
+            return fd;
+        }
+        gLastCounterError = errno;
+        if (errno != EACCES && errno != EPERM) {
+            break;
+        }
+    }
+    return -1;
+}
+#endif
+
+#if PROFILER_HAS_RDPMC
+static inline unsigned long long readPmc(unsigned counter) {
+    unsigned low;
+    unsigned high;
+    __asm__ volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(counter));
+    return low | (static_cast<unsigned long long>(high) << 32);
+}
+#endif
+
+// Constructor for ProfilerCounterGroup and Destructor
+ProfilerCounterGroup::ProfilerCounterGroup(unsigned configuration)
+    : configuration(configuration),
+      openMask(0),
+      hardwareLeader(-1),
+      softwareLeader(-1),
+      rdpmc(false) {}
+ProfilerCounterGroup::~ProfilerCounterGroup() {
+#if PROFILER_HAS_PERF_EVENTS
+    long pageSize = sysconf(_SC_PAGESIZE);
+    for (void* page : hardwarePages) {
+        munmap(page, pageSize);
+    }
+    for (int fd : hardwareFds) {
+        close(fd);
+    }
+    for (int fd : softwareFds) {
+        close(fd);
+    }
+#endif
+}
+
+// Groups are allocated from the ProfilerArena, like the thread buffers that own them
+void* ProfilerCounterGroup::operator new(size_t size) {
+    return ProfilerArenaAllocator<char>().allocate(size);
+}
+void ProfilerCounterGroup::operator delete(void* block, size_t size) {
+    ProfilerArena::GetInstance()->Deallocate(block, size);
+}
+
+ProfilerCounterGroup* ProfilerCounterGroup::Open(const std::vector<ProfilerCounterEvent>& events, unsigned configuration) {
+#if PROFILER_HAS_PERF_EVENTS
+    ProfilerCounterGroup* group = new ProfilerCounterGroup(configuration);
+    try {
+        // Room for every event up front, so nothing below allocates once file descriptors are open
+        group->hardwareFds.reserve(COUNTER_EVENT_COUNT);
+        group->softwareFds.reserve(COUNTER_EVENT_COUNT);
+        group->hardwareEvents.reserve(COUNTER_EVENT_COUNT);
+        group->softwareEvents.reserve(COUNTER_EVENT_COUNT);
+        group->hardwarePages.reserve(COUNTER_EVENT_COUNT);
+    } catch (const std::bad_alloc&) {
+        delete group;
+        throw;
+    }
+    for (ProfilerCounterEvent event : events) {
+        if (event < 0 || event >= COUNTER_EVENT_COUNT || (group->openMask & (1u << event)) != 0) {
+            continue;
+        }
+        bool hardware = isHardwareEvent(event);
+        int& leader = hardware ? group->hardwareLeader : group->softwareLeader;
+        int fd = openEvent(event, leader);
+        if (fd < 0) {
+            continue;  // Not countable here, or the group is already as big as the PMU allows
+        }
+        if (leader < 0) {
+            leader = fd;
+        }
+        (hardware ? group->hardwareFds : group->softwareFds).push_back(fd);
+        (hardware ? group->hardwareEvents : group->softwareEvents).push_back(event);
+        group->openMask |= 1u << event;
+    }
+    if (group->openMask == 0) {
+        delete group;
+        return nullptr;
+    }
+
+#if PROFILER_HAS_RDPMC
+    // rdpmc needs every hardware event's mmap page, and the kernel's permission in each of them
+    long pageSize = sysconf(_SC_PAGESIZE);
+    group->rdpmc = !group->hardwareFds.empty();
+    for (int fd : group->hardwareFds) {
+        void* page = mmap(nullptr, pageSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (page == MAP_FAILED) {
+            group->rdpmc = false;
+            break;
+        }
+        group->hardwarePages.push_back(page);
+        if (!static_cast<perf_event_mmap_page*>(page)->cap_user_rdpmc) {
+            group->rdpmc = false;
+        }
+    }
+#endif
+    return group;
+#else
+    (void)events;
+    (void)configuration;
+    return nullptr;
+#endif
+}
+
+// ReadHardwareWithRdpmc: Reads every hardware counter from the PMU under each mmap page's seqlock, returning
+// false if any of them isn't on the PMU right now (descheduled or multiplexed out)
+bool ProfilerCounterGroup::ReadHardwareWithRdpmc(ProfilerCounterSample& sample) {
+#if PROFILER_HAS_RDPMC
+    for (size_t i = 0; i < hardwarePages.size(); i++) {
+        volatile perf_event_mmap_page* page = static_cast<volatile perf_event_mmap_page*>(hardwarePages[i]);
+        unsigned sequence;
+        long long count;
+        do {
+            sequence = page->lock;
+            __asm__ volatile("" ::: "memory");
+            unsigned index = page->index;
+            if (!page->cap_user_rdpmc || index == 0) {
+                return false;
+            }
+            int shift = 64 - page->pmc_width;
+            long long pmc = static_cast<long long>(readPmc(index - 1) << shift) >> shift;
+            count = page->offset + pmc;
+            __asm__ volatile("" ::: "memory");
+        } while (page->lock != sequence);
+        sample.values[hardwareEvents[i]] = static_cast<unsigned long long>(count);
+    }
+    return true;
+#else
+    (void)sample;
+    return false;
+#endif
+}
+
+// ReadGroup: One read() of a whole group, whose values come back in the order the events joined it
+void ProfilerCounterGroup::ReadGroup(int leader, const ProfilerVector<ProfilerCounterEvent>& events, ProfilerCounterSample& sample) {
+#if PROFILER_HAS_PERF_EVENTS
+    unsigned long long buffer[1 + COUNTER_EVENT_COUNT];
+    ssize_t bytes = read(leader, buffer, sizeof(buffer));
+    size_t values = bytes > 0 ? static_cast<size_t>(bytes) / sizeof(buffer[0]) : 0;
+    for (size_t i = 0; i < events.size(); i++) {
+        sample.values[events[i]] = (values > 0 && i < buffer[0] && i + 1 < values) ? buffer[i + 1] : 0;
+    }
+#else
+    (void)leader;
+    (void)events;
+    (void)sample;
+#endif
+}
+
+void ProfilerCounterGroup::Read(ProfilerCounterSample& sample) {
+    sample.mask = openMask;
+    sample.configuration = configuration;
+    if (hardwareLeader >= 0 && !(rdpmc && ReadHardwareWithRdpmc(sample))) {
+        ReadGroup(hardwareLeader, hardwareEvents, sample);
+    }
+    if (softwareLeader >= 0) {
+        ReadGroup(softwareLeader, softwareEvents, sample);
+    }
+}
+
+unsigned ProfilerCounterGroup::GetOpenMask() const {
+    return openMask;
+}
+
+bool ProfilerCounterGroup::UsesRdpmc() const {
+    return rdpmc;
+}
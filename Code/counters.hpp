@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include "arena.hpp"
+
+using namespace std;
+
+// Events a section can count besides time, read through Linux perf_event_open for the calling thread only
+// and in user space only (so a perf_event_paranoid of 2, the usual default, is enough)
+enum ProfilerCounterEvent {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_CACHE_REFERENCES,  // Last-level cache accesses
+    COUNTER_CACHE_MISSES,
+    COUNTER_BRANCHES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_PAGE_FAULTS,       // Software events, counted by the kernel, so also available in VMs and
+    COUNTER_CONTEXT_SWITCHES,  // containers without a PMU, but each read is a system call
+    COUNTER_EVENT_COUNT
+};
+
+const char* GetCounterEventName(ProfilerCounterEvent event);
+
+// The hardware events above, the default group
+std::vector<ProfilerCounterEvent> GetDefaultCounterEvents();
+
+// Parses a comma-separated list of perf's event names ("cycles,instructions,cache-references,cache-misses,
+// branches,branch-misses,page-faults,context-switches"), returning false on an unknown name
+bool ParseCounterEvents(const char* names, std::vector<ProfilerCounterEvent>& events);
+
+// ProfilerCounterSample struct: One reading of a counter group, indexed by ProfilerCounterEvent
+struct ProfilerCounterSample {
+    unsigned long long values[COUNTER_EVENT_COUNT];
+    unsigned mask;           // Bit per event that was read, 0 if the section had no counters
+    unsigned configuration;  // Which Profiler::EnableCounters call the group came from; readings
+                             // from different groups can't be subtracted
+};
+
+// ProfilerCounterGroup class: The calling thread's open counters. Hardware events share one perf group so
+// they are scheduled together, and are read with rdpmc straight from the PMU when the kernel allows it
+// (x86 only), falling back to a single read() of the whole group. Software events are a second group that
+// is always read with read(). Groups larger than the PMU are multiplexed by the kernel and undercount.
+class ProfilerCounterGroup {
+    public:
+        // Opens whichever of the events this thread may count, returning nullptr if none of them opened
+        // (the group lives in the ProfilerArena, and std::bad_alloc is thrown when the budget can't hold it)
+        static ProfilerCounterGroup* Open(const std::vector<ProfilerCounterEvent>& events, unsigned configuration);
+        ~ProfilerCounterGroup();
+
+        ProfilerCounterGroup(const ProfilerCounterGroup&) = delete;
+        ProfilerCounterGroup& operator=(const ProfilerCounterGroup&) = delete;
+
+        static void* operator new(size_t size);
+        static void operator delete(void* block, size_t size);
+
+        void Read(ProfilerCounterSample& sample);
+
+        unsigned GetOpenMask() const;
+        bool UsesRdpmc() const;
+
+    private:
+        ProfilerCounterGroup(unsigned configuration);
+        bool ReadHardwareWithRdpmc(ProfilerCounterSample& sample);
+        static void ReadGroup(int leader, const ProfilerVector<ProfilerCounterEvent>& events, ProfilerCounterSample& sample);
+
+        unsigned configuration;
+        unsigned openMask;
+        int hardwareLeader;  // -1 if no hardware event opened
+        int softwareLeader;
+        ProfilerVector<int> hardwareFds;
+        ProfilerVector<int> softwareFds;
+        ProfilerVector<ProfilerCounterEvent> hardwareEvents;  // In the order they joined the group
+        ProfilerVector<ProfilerCounterEvent> softwareEvents;
+        ProfilerVector<void*> hardwarePages;  // perf_event_mmap_page of each hardware event, for rdpmc
+        bool rdpmc;
+};
+
+// Returns a message describing why no counters could be opened (errno of the last failed
+// perf_event_open, or the platform), for the fallback warning
+const char* GetCounterUnavailableReason();
@@ -0,0 +1,96 @@
+#include "histogram.hpp"
+#include <cstring>
+#include <limits>
+
+// Constructor for ProfilerHistogram: Starts with every bucket empty
+ProfilerHistogram::ProfilerHistogram() : totalCount(0) {
+    std::memset(counts, 0, sizeof(counts));
+}
+
+// highestBit: Position of the most significant set bit of a positive value
+static inline int highestBit(unsigned long long value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+// GetBucketIndex: Exponent picks the power of two, the next kSubBucketBits bits below the top one pick the sub-bucket
+int ProfilerHistogram::GetBucketIndex(ProfilerTicks value) {
+    if (value < 2 * kSubBucketCount) {
+        return value < 0 ? 0 : static_cast<int>(value);
+    }
+    int exponent = highestBit(static_cast<unsigned long long>(value)) - kSubBucketBits;
+    if (exponent > kMaxExponent) {
+        return kBucketCount - 1;
+    }
+    int subBucket = static_cast<int>(value >> exponent) - kSubBucketCount;
+    return (exponent + 1) * kSubBucketCount + subBucket;
+}
+
+ProfilerTicks ProfilerHistogram::GetBucketLowerBound(int bucket) {
+    if (bucket < 2 * kSubBucketCount) {
+        return bucket;
+    }
+    int exponent = bucket / kSubBucketCount - 1;
+    ProfilerTicks mantissa = bucket % kSubBucketCount + kSubBucketCount;
+    return mantissa << exponent;
+}
+
+ProfilerTicks ProfilerHistogram::GetBucketUpperBound(int bucket) {
+    if (bucket == kBucketCount - 1) {
+        return std::numeric_limits<ProfilerTicks>::max();
+    }
+    return GetBucketLowerBound(bucket + 1) - 1;
+}
+
+void ProfilerHistogram::Record(ProfilerTicks value) {
+    counts[GetBucketIndex(value)]++;
+    totalCount++;
+}
+
+void ProfilerHistogram::Merge(const ProfilerHistogram& other) {
+    for (int i = 0; i < kBucketCount; i++) {
+        counts[i] += other.counts[i];
+    }
+    totalCount += other.totalCount;
+}
+
+void ProfilerHistogram::AddToBucket(int bucket, unsigned int bucketCount) {
+    counts[bucket] += bucketCount;
+    totalCount += bucketCount;
+}
+
+// GetPercentile: Walks the buckets until the running count covers the fraction, then reports the middle of that bucket
+ProfilerTicks ProfilerHistogram::GetPercentile(double fraction) const {
+    if (totalCount == 0) {
+        return 0;
+    }
+    unsigned long long target = static_cast<unsigned long long>(fraction * totalCount + 0.5);
+    if (target < 1) {
+        target = 1;
+    }
+    unsigned long long seen = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        seen += counts[i];
+        if (seen >= target) {
+            ProfilerTicks lower = GetBucketLowerBound(i);
+            ProfilerTicks upper = i == kBucketCount - 1 ? lower : GetBucketUpperBound(i);
+            return lower + (upper - lower) / 2;
+        }
+    }
+    return GetBucketLowerBound(kBucketCount - 1);
+}
+
+unsigned long long ProfilerHistogram::GetTotalCount() const {
+    return totalCount;
+}
+
+unsigned int ProfilerHistogram::GetBucketCount(int bucket) const {
+    return counts[bucket];
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "time.hpp"
+
+using namespace std;
+
+// ProfilerHistogram class: Fixed-size log-linear (HDR-style) histogram of section durations in ticks.
+// Values below 64 get a bucket each; above that every power of two is split into 32 equal buckets, so
+// any recorded value is known to within about 3%. Recording is O(1) and never allocates.
+class ProfilerHistogram {
+    public:
+        static const int kSubBucketBits = 5;
+        static const int kSubBucketCount = 1 << kSubBucketBits;
+        static const int kMaxExponent = 42;  // Everything from 2^47 ticks up (over a day at 1 GHz) shares the last bucket
+        static const int kBucketCount = (kMaxExponent + 2) * kSubBucketCount;
+
+        ProfilerHistogram();
+
+        void Record(ProfilerTicks value);
+        void Merge(const ProfilerHistogram& other);
+        void AddToBucket(int bucket, unsigned int bucketCount);  // For rebuilding a histogram from its saved buckets
+
+        // Returns an estimate of the value below which the given fraction (0 to 1) of recorded values fall
+        ProfilerTicks GetPercentile(double fraction) const;
+
+        unsigned long long GetTotalCount() const;
+        unsigned int GetBucketCount(int bucket) const;
+        static int GetBucketIndex(ProfilerTicks value);
+        static ProfilerTicks GetBucketLowerBound(int bucket);
+        static ProfilerTicks GetBucketUpperBound(int bucket);  // Inclusive
+
+    private:
+        unsigned long long totalCount;
+        unsigned int counts[kBucketCount];
+};
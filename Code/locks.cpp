@@ -0,0 +1,399 @@
+#include "locks.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+
+// Constructor for ProfilerLockStats: Zero totals under the registered lock's name and kind
+ProfilerLockStats::ProfilerLockStats(int lockId)
+    : lockId(lockId),
+      lockName(ProfilerSectionRegistry::GetInstance()->GetLockName(lockId)),
+      kind(ProfilerSectionRegistry::GetInstance()->GetLockKind(lockId)),
+      acquisitions(0),
+      sharedAcquisitions(0),
+      contentions(0),
+      waitTicks(0),
+      maxWaitTicks(0),
+      holdTicks(0),
+      maxHoldTicks(0),
+      blockerCount(0),
+      waitTime(0.0),
+      avgWaitTime(0.0),
+      maxWaitTime(0.0),
+      holdTime(0.0),
+      avgHoldTime(0.0),
+      maxHoldTime(0.0),
+      contentionRate(0.0) {}
+
+// Merge: Adds another thread's totals; blocking sections are combined by section and the heaviest kept
+void ProfilerLockStats::Merge(const ProfilerLockStats& source) {
+    acquisitions += source.acquisitions;
+    sharedAcquisitions += source.sharedAcquisitions;
+    contentions += source.contentions;
+    waitTicks += source.waitTicks;
+    maxWaitTicks = std::max(maxWaitTicks, source.maxWaitTicks);
+    holdTicks += source.holdTicks;
+    maxHoldTicks = std::max(maxHoldTicks, source.maxHoldTicks);
+
+    ProfilerLockBlocker combined[2 * kLockBlockerSlots];
+    int combinedCount = 0;
+    for (int i = 0; i < blockerCount; i++) {
+        combined[combinedCount++] = blockers[i];
+    }
+    for (int i = 0; i < source.blockerCount; i++) {
+        int j = 0;
+        while (j < combinedCount && combined[j].sectionId != source.blockers[i].sectionId) {
+            j++;
+        }
+        if (j == combinedCount) {
+            combined[combinedCount++] = source.blockers[i];
+        } else {
+            combined[j].waitTicks += source.blockers[i].waitTicks;
+        }
+    }
+    // Heaviest first. At most 2 * kLockBlockerSlots entries, so an insertion sort (std::sort over this small
+    // array also trips GCC's -Warray-bounds at -O2)
+    for (int i = 1; i < combinedCount; i++) {
+        ProfilerLockBlocker blocker = combined[i];
+        int j = i;
+        while (j > 0 && combined[j - 1].waitTicks < blocker.waitTicks) {
+            combined[j] = combined[j - 1];
+            j--;
+        }
+        combined[j] = blocker;
+    }
+    blockerCount = std::min(combinedCount, kLockBlockerSlots);
+    std::copy(combined, combined + blockerCount, blockers);
+}
+
+void ProfilerLockStats::ConvertTicksToSeconds() {
+    waitTime = TicksToSeconds(waitTicks);
+    avgWaitTime = contentions > 0 ? waitTime / contentions : 0.0;
+    maxWaitTime = TicksToSeconds(maxWaitTicks);
+    holdTime = TicksToSeconds(holdTicks);
+    avgHoldTime = acquisitions > 0 ? holdTime / acquisitions : 0.0;
+    maxHoldTime = TicksToSeconds(maxHoldTicks);
+    contentionRate = acquisitions > 0 ? static_cast<double>(contentions) / acquisitions : 0.0;
+    for (int i = 0; i < blockerCount; i++) {
+        blockers[i].waitTime = TicksToSeconds(blockers[i].waitTicks);
+    }
+}
+
+// internLock: Registers the lock's name, unless this build has no profiling at all
+static int internLock(const char* lockName, ProfilerLockKind kind) {
+#if PROFILER_LEVEL >= 1
+    return ProfilerSectionRegistry::GetInstance()->InternLock(lockName, kind);
+#else
+    (void)lockName;
+    (void)kind;
+    return -1;
+#endif
+}
+
+// totalsFor: The calling thread's totals for a lock, nullptr while nothing is being profiled
+static ProfilerLockTotals* totalsFor(int lockId, ProfilerThreadBuffer** bufferOut) {
+    ProfilerThreadBuffer* buffer = Profiler::GetThreadBufferIfProfiling();
+    if (bufferOut != nullptr) {
+        *bufferOut = buffer;
+    }
+    return buffer != nullptr ? Profiler::GetLockTotals(buffer, lockId) : nullptr;
+}
+
+// chargeBlocker: Adds a wait to the blocking section's slot, taking over the lightest slot if none is free
+static void chargeBlocker(ProfilerLockTotals* totals, int sectionId, long long waitTicks) {
+    int lightest = 0;
+    for (int slot = 0; slot < kLockBlockerSlots; slot++) {
+        int slotSection = totals->blockerSections[slot].load(std::memory_order_relaxed);
+        if (slotSection == sectionId || slotSection == kFreeBlockerSlot) {
+            totals->blockerSections[slot].store(sectionId, std::memory_order_relaxed);
+            addRelaxed(totals->blockerWaitTicks[slot], waitTicks);
+            return;
+        }
+        if (totals->blockerWaitTicks[slot].load(std::memory_order_relaxed) < totals->blockerWaitTicks[lightest].load(std::memory_order_relaxed)) {
+            lightest = slot;
+        }
+    }
+    totals->blockerSections[lightest].store(sectionId, std::memory_order_relaxed);
+    addRelaxed(totals->blockerWaitTicks[lightest], waitTicks);
+}
+
+// recordAcquire: Counts an acquire on the calling thread and returns when the hold started (0 if untimed)
+static ProfilerTicks recordAcquire(int lockId, bool shared, std::atomic<int>& ownerSection) {
+    ProfilerThreadBuffer* buffer;
+    ProfilerLockTotals* totals = totalsFor(lockId, &buffer);
+    if (totals == nullptr) {
+        ownerSection.store(-1, std::memory_order_relaxed);
+        return 0;
+    }
+    addRelaxed(totals->acquisitions, 1);
+    if (shared) {
+        addRelaxed(totals->sharedAcquisitions, 1);
+    }
+    ownerSection.store(Profiler::GetActiveSection(buffer), std::memory_order_relaxed);
+    return GetCurrentTicks();
+}
+
+// recordHold: Adds a finished hold to the calling thread's totals
+static void recordHold(int lockId, ProfilerTicks holdTicks) {
+    ProfilerLockTotals* totals = totalsFor(lockId, nullptr);
+    if (totals != nullptr) {
+        addRelaxed(totals->holdTicks, holdTicks);
+        raiseRelaxed(totals->maxHoldTicks, holdTicks);
+    }
+}
+
+// recordFailedTry: A try_lock that found the lock taken is a contention that didn't wait
+static void recordFailedTry(int lockId) {
+    ProfilerLockTotals* totals = totalsFor(lockId, nullptr);
+    if (totals != nullptr) {
+        addRelaxed(totals->contentions, 1);
+    }
+}
+
+// ProfilerLockWait class: One blocking wait, recorded as the lock's wait section from construction to Finish
+class ProfilerLockWait {
+    public:
+        ProfilerLockWait(int waitSectionId)
+            : waitSectionId(waitSectionId),
+              profiler(Profiler::gProfiler.load(std::memory_order_acquire)),
+              startTicks(0) {
+            if (profiler != nullptr) {
+                profiler->EnterSection(waitSectionId);
+                startTicks = GetCurrentTicks();
+            }
+        }
+
+        // Finish: Exits the wait section (unless the Profiler changed meanwhile) and charges the wait
+        void Finish(int lockId, int blockerSection) {
+            if (profiler == nullptr) {
+                return;
+            }
+            long long waitTicks = GetCurrentTicks() - startTicks;
+            if (Profiler::gProfiler.load(std::memory_order_acquire) != profiler) {
+                return;
+            }
+            profiler->ExitSection(waitSectionId, __LINE__, __FILE__, __FUNCTION__);
+            ProfilerLockTotals* totals = totalsFor(lockId, nullptr);
+            if (totals == nullptr) {
+                return;
+            }
+            addRelaxed(totals->contentions, 1);
+            addRelaxed(totals->waitTicks, waitTicks);
+            raiseRelaxed(totals->maxWaitTicks, waitTicks);
+            chargeBlocker(totals, blockerSection, waitTicks);
+        }
+
+    private:
+        int waitSectionId;
+        Profiler* profiler;  // nullptr if nothing was profiling when the wait started
+        ProfilerTicks startTicks;
+};
+
+// Constructor for ProfiledMutex
+ProfiledMutex::ProfiledMutex(const char* lockName)
+    : lockId(internLock(lockName, LOCK_KIND_MUTEX)),
+      waitSectionId(lockId >= 0 ? ProfilerSectionRegistry::GetInstance()->GetLockWaitSection(lockId) : -1),
+      ownerSection(-1),
+      acquiredTicks(0) {}
+
+// lock: The uncontended path is one try_lock plus recordAcquire; only a lock that is taken enters the wait section
+void ProfiledMutex::lock() {
+    if (lockId < 0) {
+        mutex.lock();
+        return;
+    }
+    if (!mutex.try_lock()) {
+        int blocker = ownerSection.load(std::memory_order_relaxed);
+        ProfilerLockWait wait(waitSectionId);
+        mutex.lock();
+        wait.Finish(lockId, blocker);
+    }
+    acquiredTicks = recordAcquire(lockId, false, ownerSection);
+}
+
+bool ProfiledMutex::try_lock() {
+    if (!mutex.try_lock()) {
+        if (lockId >= 0) {
+            recordFailedTry(lockId);
+        }
+        return false;
+    }
+    if (lockId >= 0) {
+        acquiredTicks = recordAcquire(lockId, false, ownerSection);
+    }
+    return true;
+}
+
+// unlock: The hold ends before the unlock, it's recorded after so the lock is released as early as possible
+void ProfiledMutex::unlock() {
+    ProfilerTicks startTicks = acquiredTicks;
+    ProfilerTicks endTicks = startTicks != 0 ? GetCurrentTicks() : 0;
+    acquiredTicks = 0;
+    mutex.unlock();
+    if (startTicks != 0) {
+        recordHold(lockId, endTicks - startTicks);
+    }
+}
+
+// Constructor for ProfiledSharedMutex
+ProfiledSharedMutex::ProfiledSharedMutex(const char* lockName)
+    : lockId(internLock(lockName, LOCK_KIND_SHARED_MUTEX)),
+      waitSectionId(lockId >= 0 ? ProfilerSectionRegistry::GetInstance()->GetLockWaitSection(lockId) : -1),
+      ownerSection(-1),
+      acquiredTicks(0) {}
+
+void ProfiledSharedMutex::lock() {
+    if (lockId < 0) {
+        mutex.lock();
+        return;
+    }
+    if (!mutex.try_lock()) {
+        int blocker = ownerSection.load(std::memory_order_relaxed);
+        ProfilerLockWait wait(waitSectionId);
+        mutex.lock();
+        wait.Finish(lockId, blocker);
+    }
+    acquiredTicks = recordAcquire(lockId, false, ownerSection);
+}
+
+bool ProfiledSharedMutex::try_lock() {
+    if (!mutex.try_lock()) {
+        if (lockId >= 0) {
+            recordFailedTry(lockId);
+        }
+        return false;
+    }
+    if (lockId >= 0) {
+        acquiredTicks = recordAcquire(lockId, false, ownerSection);
+    }
+    return true;
+}
+
+void ProfiledSharedMutex::unlock() {
+    ProfilerTicks startTicks = acquiredTicks;
+    ProfilerTicks endTicks = startTicks != 0 ? GetCurrentTicks() : 0;
+    acquiredTicks = 0;
+    mutex.unlock();
+    if (startTicks != 0) {
+        recordHold(lockId, endTicks - startTicks);
+    }
+}
+
+// sharedAcquired: Remembers when the calling thread took the lock shared, in its own totals
+static void sharedAcquired(int lockId, ProfilerTicks startTicks) {
+    ProfilerLockTotals* totals = startTicks != 0 ? totalsFor(lockId, nullptr) : nullptr;
+    if (totals != nullptr) {
+        totals->sharedAcquiredTicks = startTicks;
+    }
+}
+
+// lock_shared: Waits behind a writer are charged to the writer's section, the last holder of any kind
+void ProfiledSharedMutex::lock_shared() {
+    if (lockId < 0) {
+        mutex.lock_shared();
+        return;
+    }
+    if (!mutex.try_lock_shared()) {
+        int blocker = ownerSection.load(std::memory_order_relaxed);
+        ProfilerLockWait wait(waitSectionId);
+        mutex.lock_shared();
+        wait.Finish(lockId, blocker);
+    }
+    sharedAcquired(lockId, recordAcquire(lockId, true, ownerSection));
+}
+
+bool ProfiledSharedMutex::try_lock_shared() {
+    if (!mutex.try_lock_shared()) {
+        if (lockId >= 0) {
+            recordFailedTry(lockId);
+        }
+        return false;
+    }
+    if (lockId >= 0) {
+        sharedAcquired(lockId, recordAcquire(lockId, true, ownerSection));
+    }
+    return true;
+}
+
+void ProfiledSharedMutex::unlock_shared() {
+    ProfilerLockTotals* totals = lockId >= 0 ? totalsFor(lockId, nullptr) : nullptr;
+    ProfilerTicks startTicks = totals != nullptr ? totals->sharedAcquiredTicks : 0;
+    ProfilerTicks endTicks = startTicks != 0 ? GetCurrentTicks() : 0;
+    mutex.unlock_shared();
+    if (startTicks != 0) {
+        totals->sharedAcquiredTicks = 0;
+        addRelaxed(totals->holdTicks, endTicks - startTicks);
+        raiseRelaxed(totals->maxHoldTicks, endTicks - startTicks);
+    }
+}
+
+// Constructor for ProfiledConditionVariable
+ProfiledConditionVariable::ProfiledConditionVariable(const char* lockName)
+    : lockId(internLock(lockName, LOCK_KIND_CONDITION_VARIABLE)),
+      waitSectionId(lockId >= 0 ? ProfilerSectionRegistry::GetInstance()->GetLockWaitSection(lockId) : -1),
+      notifierSection(-1) {}
+
+// notify_one/notify_all: Note the notifying section first, the woken waiters charge their wait to it
+void ProfiledConditionVariable::notify_one() {
+    if (lockId >= 0) {
+        ProfilerThreadBuffer* buffer = Profiler::GetThreadBufferIfRegistered();
+        notifierSection.store(buffer != nullptr ? Profiler::GetActiveSection(buffer) : -1, std::memory_order_relaxed);
+    }
+    condition.notify_one();
+}
+void ProfiledConditionVariable::notify_all() {
+    if (lockId >= 0) {
+        ProfilerThreadBuffer* buffer = Profiler::GetThreadBufferIfRegistered();
+        notifierSection.store(buffer != nullptr ? Profiler::GetActiveSection(buffer) : -1, std::memory_order_relaxed);
+    }
+    condition.notify_all();
+}
+
+void ProfiledConditionVariable::wait(std::unique_lock<ProfiledMutex>& lock) {
+    ProfiledMutex* mutex = lock.mutex();
+    ProfilerTicks startTicks = BeginWait(mutex);
+    std::unique_lock<std::mutex> inner(mutex->mutex, std::adopt_lock);
+    condition.wait(inner);
+    inner.release();
+    EndWait(mutex, startTicks);
+}
+
+// BeginWait: The mutex is released by the wait, so its hold ends here
+ProfilerTicks ProfiledConditionVariable::BeginWait(ProfiledMutex* mutex) {
+    if (mutex->acquiredTicks != 0) {
+        recordHold(mutex->lockId, GetCurrentTicks() - mutex->acquiredTicks);
+        mutex->acquiredTicks = 0;
+    }
+    if (lockId < 0) {
+        return 0;
+    }
+    ProfilerTicks startTicks = GetCurrentTicks();
+    Profiler* profiler = Profiler::gProfiler.load(std::memory_order_acquire);
+    if (profiler == nullptr) {
+        return 0;
+    }
+    profiler->EnterSection(waitSectionId);
+    return startTicks;
+}
+
+// EndWait: Records the wait against the last notifier and restarts the mutex's hold (not counted as another acquire)
+void ProfiledConditionVariable::EndWait(ProfiledMutex* mutex, ProfilerTicks startTicks) {
+    if (startTicks != 0) {
+        long long waitTicks = GetCurrentTicks() - startTicks;
+        Profiler* profiler = Profiler::gProfiler.load(std::memory_order_acquire);
+        ProfilerThreadBuffer* buffer;
+        ProfilerLockTotals* totals = profiler != nullptr ? totalsFor(lockId, &buffer) : nullptr;
+        // A Profiler created during the wait never saw it start
+        if (totals != nullptr && Profiler::GetActiveSection(buffer) == waitSectionId) {
+            profiler->ExitSection(waitSectionId, __LINE__, __FILE__, __FUNCTION__);
+            addRelaxed(totals->acquisitions, 1);
+            addRelaxed(totals->contentions, 1);
+            addRelaxed(totals->waitTicks, waitTicks);
+            raiseRelaxed(totals->maxWaitTicks, waitTicks);
+            chargeBlocker(totals, notifierSection.load(std::memory_order_relaxed), waitTicks);
+        }
+    }
+    if (mutex->lockId >= 0) {
+        ProfilerThreadBuffer* buffer = Profiler::GetThreadBufferIfProfiling();
+        mutex->ownerSection.store(buffer != nullptr ? Profiler::GetActiveSection(buffer) : -1, std::memory_order_relaxed);
+        mutex->acquiredTicks = buffer != nullptr ? GetCurrentTicks() : 0;
+    }
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include "registry.hpp"
+#include "time.hpp"
+
+using namespace std;
+
+// Lock profiling: ProfiledMutex, ProfiledSharedMutex and ProfiledConditionVariable are drop-in replacements for
+// the standard primitives (they work with std::lock_guard, std::unique_lock and std::shared_lock) that count,
+// per lock name and thread, how often the lock was taken, how long callers waited for it and how long it was
+// held. Taking a free lock costs a try_lock, a clock read and a few relaxed stores to the thread's own table.
+// Only a contended acquire does more: the wait is recorded as the section "Lock Wait: <name>", so it shows up
+// in the call tree under whatever the waiting thread was doing, and it is charged to the section the holder was
+// in when it took the lock (the blocking section). Profiler::printLocksToCSV/JSON rank the locks by wait time.
+// At PROFILER_LEVEL 0 the wrappers only forward to the standard primitives.
+
+class ProfiledConditionVariable;
+class ProfilerThreadBuffer;
+
+static const int kLockBlockerSlots = 4;   // Blocking sections kept per lock and thread, heaviest first in reports
+static const int kFreeBlockerSlot = -2;   // -1 is already "not in any section"
+
+// ProfilerLockTotals struct: One lock's running totals on one thread. Only that thread writes them (relaxed
+// atomics, like ProfilerAllocationCounters); the report reads them whenever it is written.
+struct ProfilerLockTotals {
+    std::atomic<long long> acquisitions;
+    std::atomic<long long> sharedAcquisitions;
+    std::atomic<long long> contentions;
+    std::atomic<long long> waitTicks;
+    std::atomic<long long> maxWaitTicks;
+    std::atomic<long long> holdTicks;
+    std::atomic<long long> maxHoldTicks;
+
+    // The sections that made this thread wait, with the time waited on each. When all slots are taken, a new
+    // section replaces the lightest one and inherits its time, so the heavy blockers are never pushed out.
+    std::atomic<int> blockerSections[kLockBlockerSlots];
+    std::atomic<long long> blockerWaitTicks[kLockBlockerSlots];
+
+    ProfilerTicks sharedAcquiredTicks;  // When this thread last took the lock shared, 0 if it wasn't timed
+};
+
+// ProfilerLockBlocker struct: A section that held a lock while others waited for it
+struct ProfilerLockBlocker {
+    int sectionId;  // -1 if the holder wasn't in any section
+    long long waitTicks;
+    double waitTime;
+};
+
+// ProfilerLockStats class: One lock's totals for one thread, or merged across threads
+class ProfilerLockStats {
+    public:
+        ProfilerLockStats(int lockId);
+
+        void Merge(const ProfilerLockStats& source);
+        void ConvertTicksToSeconds();
+
+        int lockId;
+        char const* lockName;
+        ProfilerLockKind kind;
+        long long acquisitions;        // For a condition variable, the number of waits
+        long long sharedAcquisitions;
+        long long contentions;         // Acquires that had to wait, including failed try_locks
+        long long waitTicks;
+        long long maxWaitTicks;
+        long long holdTicks;
+        long long maxHoldTicks;
+        ProfilerLockBlocker blockers[kLockBlockerSlots];  // Heaviest first, unused ones have waitTicks 0
+        int blockerCount;
+
+        // Filled in by ConvertTicksToSeconds
+        double waitTime;
+        double avgWaitTime;  // Per contention, since uncontended acquires don't wait
+        double maxWaitTime;
+        double holdTime;
+        double avgHoldTime;
+        double maxHoldTime;
+        double contentionRate;  // Contentions per acquisition
+};
+
+// ProfiledMutex class: std::mutex that records its contention under a name shared by every lock of the same name
+class ProfiledMutex {
+    public:
+        explicit ProfiledMutex(const char* lockName = "Unnamed Mutex");
+
+        ProfiledMutex(const ProfiledMutex&) = delete;
+        ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+        void lock();
+        bool try_lock();  // A failed try counts as a contention with no wait
+        void unlock();
+
+    private:
+        friend class ProfiledConditionVariable;
+
+        std::mutex mutex;
+        int lockId;  // -1 when the lock isn't profiled
+        int waitSectionId;
+        std::atomic<int> ownerSection;  // The holder's innermost section when it took the lock, read by waiters
+        ProfilerTicks acquiredTicks;    // Written and read by the holder only, 0 if the hold isn't timed
+};
+
+// ProfiledSharedMutex class: The same for a reader/writer lock (std::shared_timed_mutex, this is C++14).
+// Shared and exclusive acquires are counted together; sharedAcquisitions tells how many were shared.
+class ProfiledSharedMutex {
+    public:
+        explicit ProfiledSharedMutex(const char* lockName = "Unnamed Shared Mutex");
+
+        ProfiledSharedMutex(const ProfiledSharedMutex&) = delete;
+        ProfiledSharedMutex& operator=(const ProfiledSharedMutex&) = delete;
+
+        void lock();
+        bool try_lock();
+        void unlock();
+
+        void lock_shared();
+        bool try_lock_shared();
+        void unlock_shared();
+
+    private:
+        std::shared_timed_mutex mutex;
+        int lockId;
+        int waitSectionId;
+        std::atomic<int> ownerSection;  // The last holder's section, shared or exclusive
+        ProfilerTicks acquiredTicks;    // Exclusive holds only, shared ones are timed in the thread's totals
+};
+
+// ProfiledConditionVariable class: std::condition_variable for a std::unique_lock<ProfiledMutex>. Every wait
+// counts as a contention, its time blocked as wait time, and the section that notified as the blocking section.
+// The mutex's hold is split around the wait, since the mutex isn't held while waiting.
+class ProfiledConditionVariable {
+    public:
+        explicit ProfiledConditionVariable(const char* lockName = "Unnamed Condition Variable");
+
+        ProfiledConditionVariable(const ProfiledConditionVariable&) = delete;
+        ProfiledConditionVariable& operator=(const ProfiledConditionVariable&) = delete;
+
+        void notify_one();
+        void notify_all();
+
+        void wait(std::unique_lock<ProfiledMutex>& lock);
+
+        template <class Predicate>
+        void wait(std::unique_lock<ProfiledMutex>& lock, Predicate predicate) {
+            while (!predicate()) {
+                wait(lock);
+            }
+        }
+
+        template <class Clock, class Duration>
+        std::cv_status wait_until(std::unique_lock<ProfiledMutex>& lock, const std::chrono::time_point<Clock, Duration>& deadline) {
+            ProfiledMutex* mutex = lock.mutex();
+            ProfilerTicks startTicks = BeginWait(mutex);
+            std::unique_lock<std::mutex> inner(mutex->mutex, std::adopt_lock);
+            std::cv_status status = condition.wait_until(inner, deadline);
+            inner.release();
+            EndWait(mutex, startTicks);
+            return status;
+        }
+
+        template <class Clock, class Duration, class Predicate>
+        bool wait_until(std::unique_lock<ProfiledMutex>& lock, const std::chrono::time_point<Clock, Duration>& deadline, Predicate predicate) {
+            while (!predicate()) {
+                if (wait_until(lock, deadline) == std::cv_status::timeout) {
+                    return predicate();
+                }
+            }
+            return true;
+        }
+
+        template <class Rep, class Period>
+        std::cv_status wait_for(std::unique_lock<ProfiledMutex>& lock, const std::chrono::duration<Rep, Period>& timeout) {
+            return wait_until(lock, std::chrono::steady_clock::now() + timeout);
+        }
+
+        template <class Rep, class Period, class Predicate>
+        bool wait_for(std::unique_lock<ProfiledMutex>& lock, const std::chrono::duration<Rep, Period>& timeout, Predicate predicate) {
+            return wait_until(lock, std::chrono::steady_clock::now() + timeout, predicate);
+        }
+
+    private:
+        // Around every wait: BeginWait ends the mutex's hold and enters the wait section, EndWait records the
+        // wait and restarts the hold. Returns/takes the wait's start, 0 when it isn't timed.
+        ProfilerTicks BeginWait(ProfiledMutex* mutex);
+        void EndWait(ProfiledMutex* mutex, ProfilerTicks startTicks);
+
+        std::condition_variable condition;
+        int lockId;
+        int waitSectionId;
+        std::atomic<int> notifierSection;  // Section of the last notify, the blocking section of the waits it ends
+};
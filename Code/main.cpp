@@ -1,124 +1,89 @@
 #include "profiler.hpp"
+#include "server.hpp"
+#include "benchmark.hpp"
+#include "sampler.hpp"
+#include "sorts.hpp"
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
 #include <cmath>
-#include <thread>  // For std::this_thread::sleep_for
-#include <chrono>  // For std::chrono::milliseconds
 
 Profiler* profiler = nullptr;
 
 using namespace std;
 
-// Function to start Python HTTP server
-void startServer() {
-    // First kill any existing Python servers
-    #ifdef _WIN32
-    system("taskkill /F /IM python.exe > nul 2>&1");
-    system("start /B python -m http.server 8080");
-    #else
-    system("pkill -f 'python3 -m http.server' > /dev/null 2>&1");
-    system("python3 -m http.server 8080 &");
-    #endif
-    
-    // Give the server time to start
-    std::this_thread::sleep_for(std::chrono::seconds(2));
-}
-
-// Function to open browser for both visualizers
-void openBrowsers() {
-    #ifdef _WIN32
-    system("start http://localhost:8080/Code/index.html");
-    #elif __APPLE__
-    system("open http://localhost:8080/Code/index.html");
-    #else
-    system("xdg-open http://localhost:8080/Code/index.html");
-    #endif
-}
-
-void cleanupServer() {
-    #ifdef _WIN32
-    system("taskkill /F /IM python.exe > nul 2>&1");
-    #else
-    system("pkill -f 'python3 -m http.server' > /dev/null 2>&1");
-    #endif
-}
-
-
-// Generate a large random array
-std::vector<int> generateRandomArray(int size) {
-    std::vector<int> arr(size);
-    for (int i = 0; i < size; i++) {
-        arr[i] = rand() % 10000;  // Random numbers between 0 and 9999
-    }
-    return arr;
-}
+static const int kDashboardPort = 8080;
 
 void baselineInsertionSort(std::vector<int>& arr) {
     PROFILER_ENTER("Baseline Insertion Sort");
     int n = arr.size();
+    PROFILER_COUNT("Baseline Insertion Sort", "elements", n);
     
-    PROFILER_ENTER("Insertion Sort1: Outer Loop");
+    PROFILER_ENTER_LEVEL(2, "Insertion Sort1: Outer Loop");
     for (int i = 1; i < n; i++) {
-        PROFILER_ENTER("Insertion Sort1: Key Selection");
+        PROFILER_ENTER_LEVEL(3, "Insertion Sort1: Key Selection");
         int key = arr[i];
         int j = i - 1;
         
-        PROFILER_ENTER("Insertion Sort1: Element Shifting");
+        PROFILER_ENTER_LEVEL(3, "Insertion Sort1: Element Shifting");
         while (j >= 0 && arr[j] > key) {
             arr[j + 1] = arr[j];
             j--;
         }
         arr[j + 1] = key;
-        PROFILER_EXIT("Insertion Sort1: Element Shifting");
+        // The loop compares once per shifted element, plus once more for the element it stops at
+        PROFILER_COUNT_LEVEL(3, "Insertion Sort1: Element Shifting", "moves", i - 1 - j);
+        PROFILER_COUNT_LEVEL(3, "Insertion Sort1: Element Shifting", "comparisons", i - 1 - j + (j >= 0 ? 1 : 0));
+        PROFILER_EXIT_LEVEL(3, "Insertion Sort1: Element Shifting");
         
-        PROFILER_EXIT("Insertion Sort1: Key Selection");
+        PROFILER_EXIT_LEVEL(3, "Insertion Sort1: Key Selection");
     }
-    PROFILER_EXIT("Insertion Sort1: Outer Loop");    
+    PROFILER_EXIT_LEVEL(2, "Insertion Sort1: Outer Loop");    
     PROFILER_EXIT("Baseline Insertion Sort");
 }
 
 void insertionSortShifting2(std::vector<int>& arr) {
     PROFILER_ENTER("Optimized Insertion Sort2 - Shifting");
     int n = arr.size();
+    PROFILER_COUNT("Optimized Insertion Sort2 - Shifting", "elements", n);
     
-    PROFILER_ENTER("Insertion Sort2: Outer Loop");
+    PROFILER_ENTER_LEVEL(2, "Insertion Sort2: Outer Loop");
     for (int i = 1; i < n; i++) {
-        PROFILER_ENTER("Insertion Sort2: Key Selection");
+        PROFILER_ENTER_LEVEL(3, "Insertion Sort2: Key Selection");
         int key = arr[i];
         int j = i - 1;
         
-        PROFILER_ENTER("Insertion Sort2: Element Shifting");
+        PROFILER_ENTER_LEVEL(3, "Insertion Sort2: Element Shifting");
         while (j >= 0 && arr[j] > key) {
             arr[j + 1] = arr[j];
             j--;
         }
-        PROFILER_EXIT("Insertion Sort2: Element Shifting");
+        PROFILER_COUNT_LEVEL(3, "Insertion Sort2: Element Shifting", "moves", i - 1 - j);
+        PROFILER_COUNT_LEVEL(3, "Insertion Sort2: Element Shifting", "comparisons", i - 1 - j + (j >= 0 ? 1 : 0));
+        PROFILER_EXIT_LEVEL(3, "Insertion Sort2: Element Shifting");
         
-        PROFILER_ENTER("Insertion Sort2: Key Placement");
+        PROFILER_ENTER_LEVEL(3, "Insertion Sort2: Key Placement");
         arr[j + 1] = key;
-        PROFILER_EXIT("Insertion Sort2: Key Placement");
+        PROFILER_EXIT_LEVEL(3, "Insertion Sort2: Key Placement");
         
-        PROFILER_EXIT("Insertion Sort2: Key Selection");
+        PROFILER_EXIT_LEVEL(3, "Insertion Sort2: Key Selection");
     }
-    PROFILER_EXIT("Insertion Sort2: Outer Loop");
+    PROFILER_EXIT_LEVEL(2, "Insertion Sort2: Outer Loop");
     
     PROFILER_EXIT("Optimized Insertion Sort2 - Shifting");
 }
 
+// binarySearch: Returns where item belongs in arr[low..high], after any elements equal to it
 int binarySearch(const std::vector<int>& arr, int item, int low, int high) {
     //PROFILER_ENTER("Binary Search Operation");
-    int result = low;
     
     //PROFILER_ENTER("Search Loop");
+    int comparisons = 0;
     while (low <= high) {
+        comparisons++;
         int mid = (low + high) / 2;
-        if (item == arr[mid]) {
-            result = mid + 1;
-            break;
-        }
-        else if (item > arr[mid]) {
+        if (item >= arr[mid]) {
             low = mid + 1;
         }
         else {
@@ -126,132 +91,183 @@ int binarySearch(const std::vector<int>& arr, int item, int low, int high) {
         }
     }
     //PROFILER_EXIT("Search Loop");
-    
-    if (result == low) {
-        result = low;
-    }
+    PROFILER_COUNT_LEVEL(3, "Insertion Sort3: Binary Search", "comparisons", comparisons);
     
     //PROFILER_EXIT("Binary Search Operation");
-    return result;
+    return low;
 }
 
 void insertionSortBinary3(std::vector<int>& arr) {
     PROFILER_ENTER("Optimized Insertion Sort3 - Binary Search");
     int n = arr.size();
+    PROFILER_COUNT("Optimized Insertion Sort3 - Binary Search", "elements", n);
     
-    PROFILER_ENTER("Insertion Sort3: Outer Loop");
+    PROFILER_ENTER_LEVEL(2, "Insertion Sort3: Outer Loop");
     for (int i = 1; i < n; i++) {
-        PROFILER_ENTER("Insertion Sort3: Key Selection");
+        PROFILER_ENTER_LEVEL(3, "Insertion Sort3: Key Selection");
         int key = arr[i];
         int j = i - 1;
         
-        PROFILER_ENTER("Insertion Sort3: Binary Search");
+        PROFILER_ENTER_LEVEL(3, "Insertion Sort3: Binary Search");
         int loc = binarySearch(arr, key, 0, j);
-        PROFILER_EXIT("Insertion Sort3: Binary Search");
+        PROFILER_EXIT_LEVEL(3, "Insertion Sort3: Binary Search");
         
-        PROFILER_ENTER("Insertion Sort3: Element Shifting");
+        PROFILER_ENTER_LEVEL(3, "Insertion Sort3: Element Shifting");
         while (j >= loc) {
             arr[j + 1] = arr[j];
             j--;
         }
-        PROFILER_EXIT("Insertion Sort3: Element Shifting");
+        PROFILER_COUNT_LEVEL(3, "Insertion Sort3: Element Shifting", "moves", i - loc);  // As many as Sort1, with no comparisons
+        PROFILER_EXIT_LEVEL(3, "Insertion Sort3: Element Shifting");
         
         arr[loc] = key;
-        PROFILER_EXIT("Insertion Sort3: Key Selection");
+        PROFILER_EXIT_LEVEL(3, "Insertion Sort3: Key Selection");
     }
-    PROFILER_EXIT("Insertion Sort3: Outer Loop");
+    PROFILER_EXIT_LEVEL(2, "Insertion Sort3: Outer Loop");
     
     PROFILER_EXIT("Optimized Insertion Sort3 - Binary Search");
 }
 
+// insertionSortEarlyExit4: Skips the already sorted prefix (returning straight away if that's the whole
+// array), and skips the shifting for any element that is already in place
 void insertionSortEarlyExit4(std::vector<int>& arr) {
     PROFILER_ENTER("Optimized Insertion Sort4 - Early Exit");
     int n = arr.size();
-    bool sorted = true;
+    PROFILER_COUNT("Optimized Insertion Sort4 - Early Exit", "elements", n);
     
-    PROFILER_ENTER("Insertion Sort4: Outer Loop");
-    for (int i = 1; i < n; i++) {
-        PROFILER_ENTER("Insertion Sort4: Key Selection");
+    PROFILER_ENTER_LEVEL(3, "Insertion Sort4: Early Exit Check");
+    int firstUnsorted = 1;
+    while (firstUnsorted < n && arr[firstUnsorted - 1] <= arr[firstUnsorted]) {
+        firstUnsorted++;
+    }
+    PROFILER_EXIT_LEVEL(3, "Insertion Sort4: Early Exit Check");
+    
+    PROFILER_ENTER_LEVEL(2, "Insertion Sort4: Outer Loop");
+    for (int i = firstUnsorted; i < n; i++) {
+        PROFILER_ENTER_LEVEL(3, "Insertion Sort4: Key Selection");
         int key = arr[i];
         int j = i - 1;
         
-        sorted = true;
-        PROFILER_ENTER("Insertion Sort4: Element Shifting");
-        while (j >= 0 && arr[j] > key) {
-            arr[j + 1] = arr[j];
-            j--;
-            sorted = false;
+        if (arr[j] > key) {
+            PROFILER_ENTER_LEVEL(3, "Insertion Sort4: Element Shifting");
+            while (j >= 0 && arr[j] > key) {
+                arr[j + 1] = arr[j];
+                j--;
+            }
+            arr[j + 1] = key;
+            PROFILER_COUNT_LEVEL(3, "Insertion Sort4: Element Shifting", "moves", i - 1 - j);
+            PROFILER_COUNT_LEVEL(3, "Insertion Sort4: Element Shifting", "comparisons", i - 1 - j + (j >= 0 ? 1 : 0));
+            PROFILER_EXIT_LEVEL(3, "Insertion Sort4: Element Shifting");
         }
-        PROFILER_EXIT("Insertion Sort4: Element Shifting");
-        
-        arr[j + 1] = key;
-        PROFILER_EXIT("Insertion Sort4: Key Selection");
         
-        if (sorted) {
-            PROFILER_ENTER("Insertion Sort4: Early Exit Check");
-            PROFILER_EXIT("Insertion Sort4: Early Exit Check");
-            break;
-        }
+        PROFILER_EXIT_LEVEL(3, "Insertion Sort4: Key Selection");
     }
-    PROFILER_EXIT("Insertion Sort4: Outer Loop");
+    PROFILER_EXIT_LEVEL(2, "Insertion Sort4: Outer Loop");
     
     PROFILER_EXIT("Optimized Insertion Sort4 - Early Exit");
 }
 
-void runTest(vector<int> arrCopy1, vector <int> arrCopy2, vector <int> arrCopy3, vector <int> arrCopy4 ) {
-    // Profile Baseline Insertion Sort
-    baselineInsertionSort(arrCopy1);
-    
-    // Profile Optimized Insertion Sort - Shifting
-    insertionSortShifting2(arrCopy2);
+// The benchmark takes plain sort functions, so each thread count of the parallel sort gets its own
+void parallelMergeSort2(std::vector<int>& arr) {
+    parallelMergeSort(arr, 2);
+}
 
-    // Profile Optimized Insertion Sort - Binary Search
-    insertionSortBinary3(arrCopy3);
+void parallelMergeSort4(std::vector<int>& arr) {
+    parallelMergeSort(arr, 4);
+}
 
-    // Profile Optimized Insertion Sort - Early Exit
-    insertionSortEarlyExit4(arrCopy4);
+// runBenchmarks: Every variant on every distribution; the insertion sorts stop at the 5000 elements main.cpp
+// always used, the O(n log n) engines go on to a million (Bench/bench_sort_engines goes further)
+bool runBenchmarks() {
+    static const int kInsertionSortMaxSize = 5000;
+    ProfilerBenchmark benchmark;
+    benchmark.AddVariant("Baseline Insertion Sort", baselineInsertionSort, kInsertionSortMaxSize);
+    benchmark.AddVariant("Optimized Insertion Sort2 - Shifting", insertionSortShifting2, kInsertionSortMaxSize);
+    benchmark.AddVariant("Optimized Insertion Sort3 - Binary Search", insertionSortBinary3, kInsertionSortMaxSize);
+    benchmark.AddVariant("Optimized Insertion Sort4 - Early Exit", insertionSortEarlyExit4, kInsertionSortMaxSize);
+    benchmark.AddVariant("Cache-Aware Merge Sort", mergeSortCacheAware);
+    benchmark.AddVariant("Parallel Merge Sort (2 threads)", parallelMergeSort2);
+    benchmark.AddVariant("Parallel Merge Sort (4 threads)", parallelMergeSort4);
+    benchmark.AddVariant("LSD Radix Sort", radixSortLSD);
+    benchmark.SetSizes({ 625, 1250, 2500, 5000, 100000, 1000000 });
+    benchmark.SetRepetitions(1, 9);  // The fewest runs whose median interval is narrower than min..max at 95%
 
+    bool verified = benchmark.Run();
+    benchmark.printResults();
+    benchmark.printResultsToCSV("./Data/benchmark_results.csv");
+    return verified;
 }
 
 
 int main() {
-    cleanupServer();
-    // Seed for random number generation
-    srand(time(0));
+    // Cap on the profiler's own memory (rings, traces, stats), e.g. PROFILER_MEMORY_MB=64; past it data is
+    // dropped with a warning instead of the profiler growing. Must be set before the Profiler is created.
+    const char* memoryMegabytes = getenv("PROFILER_MEMORY_MB");
+    if (memoryMegabytes != nullptr && atoi(memoryMegabytes) > 0) {
+        ProfilerArena::GetInstance()->SetBudget(static_cast<size_t>(atoi(memoryMegabytes)) << 20);
+    }
+    profiler = Profiler::GetInstance();
 
-    // Generate a large random array of size 5000
-    std::vector<int> arr = generateRandomArray(5000);
+    // The dashboard polls /stats while the sorts run, so start serving before them (localhost only)
+    ProfilerHttpServer server;
+    if (server.Start(kDashboardPort, ".")) {
+        cout << "Dashboard running at http://localhost:" << server.GetPort() << "/Code/index.html" << endl;
+    }
 
-    // Make copies of the array for each sort to compare
-    std::vector<int> arrCopy1 = arr;
-    std::vector<int> arrCopy2 = arr;
-    std::vector<int> arrCopy3 = arr;
-    std::vector<int> arrCopy4 = arr;
+    // Per-section hardware counters, e.g. PROFILER_COUNTERS=cycles,instructions,branch-misses (perf's event names);
+    // without PMU access this only prints why and the sections keep recording time
+    std::vector<ProfilerCounterEvent> counterEvents = GetDefaultCounterEvents();
+    const char* counterNames = getenv("PROFILER_COUNTERS");
+    if (counterNames != nullptr && !ParseCounterEvents(counterNames, counterEvents)) {
+        cerr << "Unknown event in PROFILER_COUNTERS, using the default hardware counters" << endl;
+        counterEvents = GetDefaultCounterEvents();
+    }
+    profiler->EnableCounters(counterEvents);
+    profiler->EnableAllocationTracking();  // Heap use per section, next to the times in every report
 
-    profiler = Profiler::GetInstance();
+    profiler->EnableWindows(1000, 120);  // Per-second stats for the last two minutes, plotted over time by the dashboard
+    profiler->EnableTrace(1 << 18, TRACE_POLICY_STOP_WHEN_FULL);  // 4 MB per thread, keeps the start of the sweep
+    profiler->OpenBinaryOutput("./Data/profile_stats.prof", 1000);  // Snapshot every second, see make profile_convert
+    if (profiler->OpenSharedStats(nullptr, 250)) {  // Costs nothing until a reader attaches
+        cout << "Live stats shared, watch them with make profiler_top && ./profiler_top " << profiler->GetSharedStatsName() << endl;
+    }
 
-    runTest(arrCopy1, arrCopy2, arrCopy3, arrCopy4);
+    // Statistical samples of the sweep, attributed to the innermost section; stopped before the Profiler is deleted
+    ProfilerSampler sampler;
+    bool sampling = sampler.Start(997, 1 << 16);  // Prime, so the timer doesn't beat in step with periodic work
+    bool verified = runBenchmarks();
+    sampler.Stop();
+    profiler->MarkFrame();  // The last partial second becomes a window of its own
+    profiler->DisableWindows();
     profiler->calculateStats();  // Aggregate the statistics
     //profiler->printStats();
     // In main.cpp, update these lines to use the correct case
     profiler->printStatsToCSV("./Data/profile_stats.csv");
     profiler->printStatsToJSON("./Data/profile_stats.json");
+    profiler->printCallTreeToCSV("./Data/profile_calltree.csv");
+    profiler->printTraceToJSON("./Data/profile_trace.json");  // Open in chrome://tracing or ui.perfetto.dev
+    profiler->printWindowsToJSON("./Data/profile_windows.json");
+    profiler->printLocksToCSV("./Data/profile_locks.csv");
+    profiler->printLocksToJSON("./Data/profile_locks.json");
+    profiler->CloseBinaryOutput();
+    if (sampling) {
+        sampler.printSamplesToFolded("./Data/profile_samples.folded");  // flamegraph.pl or speedscope
+        sampler.printSectionSummary();
+    }
+    profiler->SaveBaseline("./Data/Baselines");  // Compare the next run against it with make regression_check
 
-    // Open the visualizer in the default browser - index.html
-    cout << "Starting local server..." << endl;
-    startServer();
-    cout << "Opening visualizers in browser..." << endl;
-    openBrowsers();
-    cout << "Visualizers are running at:" << endl;
-    cout << "1. http://localhost:8080/Code/index.html" << endl;
     cout << "Press Enter to exit and stop the server..." << endl;
-    
     cin.get();
-    
-    // Cleanup
-    cleanupServer();
+    server.Stop();
 
     delete profiler;
     profiler = nullptr;
-    return 0;
+    ProfilerArena* arena = ProfilerArena::GetInstance();
+    cout << "Profiler memory: peak " << arena->GetPeakBytesInUse() << " bytes in use, " << arena->GetBytesMapped()
+         << " bytes still mapped, budget " << arena->GetBudget() << " bytes";
+    if (arena->GetFailedAllocations() > 0) {
+        cout << ", " << arena->GetFailedAllocations() << " allocations refused";
+    }
+    cout << endl;
+    return verified ? 0 : 1;
 }
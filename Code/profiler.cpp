@@ -1,11 +1,33 @@
 #include "profiler.hpp"
-#include "time.hpp"
+#include "report.hpp"
+#include "binary.hpp"
+#include "baseline.hpp"
+#include "shared.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
-//create a macro
-#define PROFILER_ENTER(sectionName) Profiler::GetInstance()->EnterSection(sectionName);
-#define PROFILER_EXIT(sectionName) Profiler::GetInstance()->ExitSection(sectionName, __LINE__, __FILE__, __FUNCTION__);
+std::atomic<Profiler*> Profiler::gProfiler(nullptr);
 
-Profiler* Profiler::gProfiler = nullptr;
+// The calling thread's buffer and the Profiler generation it belongs to, cached by GetThreadBuffer
+static thread_local unsigned tCachedGeneration = 0;
+static thread_local ProfilerThreadBuffer* tCachedBuffer = nullptr;
+
+// warnMemoryBudgetExhausted: Says once that the ProfilerArena is full, whichever part of the profiler found out first
+static void warnMemoryBudgetExhausted() {
+    static std::atomic<bool> warned(false);
+    if (!warned.exchange(true)) {
+        std::cerr << "Warning: Profiler memory budget of " << ProfilerArena::GetInstance()->GetBudget()
+                  << " bytes exhausted, profiling data is being dropped." << std::endl;
+    }
+}
 
 // Constructor for Time Record Start and Destructor
 TimeRecordStart::TimeRecordStart(char const* sectionName, double secondsAtStart) : sectionName(sectionName), secondsAtStart(secondsAtStart) { };
@@ -16,101 +38,1060 @@ TimeRecordStop::TimeRecordStop(char const* sectionName, double secondsAtStop, in
 TimeRecordStop::TimeRecordStop(char const* sectionName, double secondsAtStop ) : sectionName(sectionName), elapsedTime(secondsAtStop), lineNumber(0), fileName("null"), functionName("null") { };
 TimeRecordStop::~TimeRecordStop() { };
 
-// Constructor for ProfilerScopeObject and Destructor
-ProfilerScopeObject::ProfilerScopeObject(char const* sectionName) : sectionName(sectionName) {
-    Profiler::GetInstance()->EnterSection(sectionName);
+// Constructors for ProfilerScopeObject and Destructor
+ProfilerScopeObject::ProfilerScopeObject(char const* sectionName) : sectionId(ProfilerSectionRegistry::GetInstance()->Intern(sectionName)), site(nullptr), profiler(Profiler::GetInstance()) {
+    profiler->EnterSection(sectionId);
+}
+ProfilerScopeObject::ProfilerScopeObject(const ProfilerSectionSite* site) : sectionId(site->sectionId), site(site), profiler(Profiler::GetInstance()) {
+    profiler->EnterSection(sectionId);
 }
 ProfilerScopeObject::~ProfilerScopeObject() {
-    Profiler::GetInstance()->ExitSection(sectionName);
+    if (site != nullptr) {
+        profiler->ExitSection(sectionId, site->lineNumber, site->fileName, site->functionName);
+    } else {
+        profiler->ExitSection(sectionId, 0, "null", "null");
+    }
+}
+
+// Constructors for ProfilerAsyncSpan and Destructor
+ProfilerAsyncSpan::ProfilerAsyncSpan() : sectionId(-1), spanId(0), startTicks(0), handOffTicks(0), queueTicks(0), maxQueueTicks(0), handOffCount(0) {}
+ProfilerAsyncSpan::ProfilerAsyncSpan(ProfilerAsyncSpan&& other) noexcept
+    : sectionId(other.sectionId),
+      spanId(other.spanId),
+      startTicks(other.startTicks),
+      handOffTicks(other.handOffTicks),
+      queueTicks(other.queueTicks),
+      maxQueueTicks(other.maxQueueTicks),
+      handOffCount(other.handOffCount) {
+    other.sectionId = -1;
+}
+ProfilerAsyncSpan::~ProfilerAsyncSpan() {
+    End();
+}
+
+ProfilerAsyncSpan& ProfilerAsyncSpan::operator=(ProfilerAsyncSpan&& other) noexcept {
+    if (this != &other) {
+        End();
+        sectionId = other.sectionId;
+        spanId = other.spanId;
+        startTicks = other.startTicks;
+        handOffTicks = other.handOffTicks;
+        queueTicks = other.queueTicks;
+        maxQueueTicks = other.maxQueueTicks;
+        handOffCount = other.handOffCount;
+        other.sectionId = -1;
+    }
+    return *this;
+}
+
+bool ProfilerAsyncSpan::IsOpen() const {
+    return sectionId >= 0;
+}
+
+// The span methods never create a Profiler: a span that outlives it (ended or destroyed after `delete profiler`)
+// is closed without being recorded, the way ProfilerLockWait gives up.
+void ProfilerAsyncSpan::HandOff() {
+    Profiler* profiler = Profiler::gProfiler.load(std::memory_order_acquire);
+    if (IsOpen() && profiler != nullptr) {
+        profiler->HandOffAsyncSpan(*this);
+    }
+}
+
+void ProfilerAsyncSpan::Resume() {
+    Profiler* profiler = Profiler::gProfiler.load(std::memory_order_acquire);
+    if (IsOpen() && profiler != nullptr) {
+        profiler->ResumeAsyncSpan(*this);
+    }
+}
+
+void ProfilerAsyncSpan::End() {
+    End(0, "null", "null");
+}
+void ProfilerAsyncSpan::End(int lineNumber, const char* fileName, const char* functionName) {
+    if (!IsOpen()) {
+        return;
+    }
+    Profiler* profiler = Profiler::gProfiler.load(std::memory_order_acquire);
+    if (profiler == nullptr) {
+        sectionId = -1;
+        return;
+    }
+    profiler->EndAsyncSpan(*this, lineNumber, fileName, functionName);
 }
 
 // Constructor for ProfilerStats and Destructor
 ProfilerStats::ProfilerStats(char const* sectionName)
     : sectionName(sectionName),
       count(0),
+      outermostCount(0),
+      totalTicks(0),
+      minTicks(std::numeric_limits<ProfilerTicks>::max()),
+      maxTicks(0),
+      selfTicks(0),
+      compensatedTotalTicks(0),
+      compensatedSelfTicks(0),
       totalTime(0.0),
       minTime(std::numeric_limits<double>::max()),  // Set to the maximum possible value
       maxTime(0.0),
       avgTime(0.0),
+      selfTime(0.0),
+      compensatedTotalTime(0.0),
+      compensatedAvgTime(0.0),
+      compensatedSelfTime(0.0),
+      p50Time(0.0),
+      p90Time(0.0),
+      p99Time(0.0),
+      p999Time(0.0),
+      sampleEvery(1),
+      counterCalls(0),
+      counterMask(0),
+      counterTotals(),
+      instructionsPerCycle(0.0),
+      cacheMissRate(0.0),
+      branchMissRate(0.0),
+      allocationCount(0),
+      allocatedBytes(0),
+      freedBytes(0),
+      peakLiveBytes(0),
+      asyncCount(0),
+      handOffCount(0),
+      queueTicks(0),
+      maxQueueTicks(0),
+      queueTime(0.0),
+      avgQueueTime(0.0),
+      maxQueueTime(0.0),
+      metricMask(0),
+      metricTotals(),
+      metricRates(),
+      metricSecondsPerUnit(),
       fileName(nullptr),
       functionName(nullptr),
       lineNumber(0) {}
 // Destructor for ProfilerStats (no dynamic memory to clean up here)
 ProfilerStats::~ProfilerStats() {}
 
-// Profiler constructor: Initializes the Profiler instance and reserves space for elapsed times
-Profiler::Profiler() {
-    gProfiler = this;
-    elapsedTimes.reserve(1000000); //Pre-allocate memory to store profiling data
+void ProfilerStats::ConvertTicksToSeconds() {
+    ConvertTicksToSeconds(TicksToSeconds(1));
+}
+void ProfilerStats::ConvertTicksToSeconds(double secondsPerTick) {
+    totalTime = secondsPerTick * totalTicks;
+    minTime = count > 0 ? secondsPerTick * minTicks : 0.0;
+    maxTime = secondsPerTick * maxTicks;
+    // A recursive call's time is already in its outermost call's, so the averages are per outermost call
+    avgTime = outermostCount > 0 ? totalTime / outermostCount : 0.0;
+    selfTime = secondsPerTick * selfTicks;
+    compensatedTotalTime = secondsPerTick * compensatedTotalTicks;
+    compensatedAvgTime = outermostCount > 0 ? compensatedTotalTime / outermostCount : 0.0;
+    compensatedSelfTime = secondsPerTick * compensatedSelfTicks;
+
+    // A bucket's midpoint can fall outside what was actually observed, so keep percentiles within [min, max]
+    const double fractions[] = { 0.5, 0.9, 0.99, 0.999 };
+    double* percentiles[] = { &p50Time, &p90Time, &p99Time, &p999Time };
+    for (int i = 0; i < 4; i++) {
+        ProfilerTicks ticks = histogram.GetPercentile(fractions[i]);
+        if (count > 0) {
+            ticks = std::max(minTicks, std::min(maxTicks, ticks));
+        }
+        *percentiles[i] = secondsPerTick * ticks;
+    }
+
+    const unsigned ipcEvents = (1u << COUNTER_CYCLES) | (1u << COUNTER_INSTRUCTIONS);
+    const unsigned cacheEvents = (1u << COUNTER_CACHE_REFERENCES) | (1u << COUNTER_CACHE_MISSES);
+    const unsigned branchEvents = (1u << COUNTER_BRANCHES) | (1u << COUNTER_BRANCH_MISSES);
+    instructionsPerCycle = (counterMask & ipcEvents) == ipcEvents && counterTotals[COUNTER_CYCLES] > 0
+        ? static_cast<double>(counterTotals[COUNTER_INSTRUCTIONS]) / counterTotals[COUNTER_CYCLES] : 0.0;
+    cacheMissRate = (counterMask & cacheEvents) == cacheEvents && counterTotals[COUNTER_CACHE_REFERENCES] > 0
+        ? static_cast<double>(counterTotals[COUNTER_CACHE_MISSES]) / counterTotals[COUNTER_CACHE_REFERENCES] : 0.0;
+    branchMissRate = (counterMask & branchEvents) == branchEvents && counterTotals[COUNTER_BRANCHES] > 0
+        ? static_cast<double>(counterTotals[COUNTER_BRANCH_MISSES]) / counterTotals[COUNTER_BRANCHES] : 0.0;
+
+    queueTime = secondsPerTick * queueTicks;
+    avgQueueTime = handOffCount > 0 ? queueTime / handOffCount : 0.0;
+    maxQueueTime = secondsPerTick * maxQueueTicks;
+
+    // Custom counters count every call, sampled sections only time one in sampleEvery of them
+    double countedSeconds = totalTime * sampleEvery;
+    for (int metric = 0; metric < ProfilerSectionRegistry::kMaxMetrics; metric++) {
+        metricRates[metric] = countedSeconds > 0.0 ? metricTotals[metric] / countedSeconds : 0.0;
+        metricSecondsPerUnit[metric] = metricTotals[metric] != 0 ? countedSeconds / metricTotals[metric] : 0.0;
+    }
+}
+
+bool ProfilerStats::HasData() const {
+    return count > 0 || allocationCount > 0 || freedBytes > 0;
+}
+
+// Merge: Adds another set of raw stats for the same section (another thread's or another run's, in the same tick unit)
+void ProfilerStats::Merge(const ProfilerStats& source) {
+    count += source.count;
+    outermostCount += source.outermostCount;
+    totalTicks += source.totalTicks;
+    selfTicks += source.selfTicks;
+    compensatedTotalTicks += source.compensatedTotalTicks;
+    compensatedSelfTicks += source.compensatedSelfTicks;
+    minTicks = std::min(minTicks, source.minTicks);
+    maxTicks = std::max(maxTicks, source.maxTicks);
+    histogram.Merge(source.histogram);
+    counterCalls += source.counterCalls;
+    counterMask |= source.counterMask;
+    for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+        counterTotals[event] += source.counterTotals[event];
+    }
+    allocationCount += source.allocationCount;
+    allocatedBytes += source.allocatedBytes;
+    freedBytes += source.freedBytes;
+    peakLiveBytes = std::max(peakLiveBytes, source.peakLiveBytes);
+    asyncCount += source.asyncCount;
+    handOffCount += source.handOffCount;
+    queueTicks += source.queueTicks;
+    maxQueueTicks = std::max(maxQueueTicks, source.maxQueueTicks);
+    metricMask |= source.metricMask;
+    for (int metric = 0; metric < ProfilerSectionRegistry::kMaxMetrics; metric++) {
+        metricTotals[metric] += source.metricTotals[metric];
+    }
+
+    fileName = source.fileName;
+    functionName = source.functionName;
+    lineNumber = source.lineNumber;
+}
+
+// Constructor for ProfilerCallNode and Destructor
+ProfilerCallNode::ProfilerCallNode(int sectionId, int parentIndex, int depth)
+    : sectionId(sectionId),
+      parentIndex(parentIndex),
+      depth(depth),
+      count(0),
+      inclusiveTicks(0),
+      selfTicks(0),
+      compensatedInclusiveTicks(0),
+      compensatedSelfTicks(0) {}
+ProfilerCallNode::~ProfilerCallNode() {}
+
+// findOrAddChild: Returns the index of parentIndex's child for sectionId, creating the node if needed
+static int findOrAddChild(ProfilerVector<ProfilerCallNode>& tree, int parentIndex, int sectionId) {
+    for (int childIndex : tree[parentIndex].children) {
+        if (tree[childIndex].sectionId == sectionId) {
+            return childIndex;
+        }
+    }
+    int childIndex = static_cast<int>(tree.size());
+    tree.emplace_back(sectionId, parentIndex, tree[parentIndex].depth + 1);
+    tree[parentIndex].children.push_back(childIndex);
+    return childIndex;
+}
+
+// mergeCallTree: Adds the subtree rooted at sourceIndex onto the node at targetIndex, matching children by section
+void mergeCallTree(ProfilerVector<ProfilerCallNode>& target, int targetIndex, const ProfilerVector<ProfilerCallNode>& source, int sourceIndex) {
+    target[targetIndex].count += source[sourceIndex].count;
+    target[targetIndex].inclusiveTicks += source[sourceIndex].inclusiveTicks;
+    target[targetIndex].selfTicks += source[sourceIndex].selfTicks;
+    target[targetIndex].compensatedInclusiveTicks += source[sourceIndex].compensatedInclusiveTicks;
+    target[targetIndex].compensatedSelfTicks += source[sourceIndex].compensatedSelfTicks;
+    for (int sourceChild : source[sourceIndex].children) {
+        int targetChild = findOrAddChild(target, targetIndex, source[sourceChild].sectionId);
+        mergeCallTree(target, targetChild, source, sourceChild);
+    }
+}
+
+// Constructor for ProfilerThreadBuffer and Destructor
+ProfilerThreadBuffer::ProfilerThreadBuffer(int threadId, size_t capacity)
+    : threadId(threadId),
+      counters(nullptr),
+      counterConfiguration(0),
+      activeDepth(0),
+      allocationCounters(nullptr),
+      metricTotals(nullptr),
+      lockTotals(nullptr),
+      trace(nullptr),
+      outOfMemory(false),
+      droppedEvents(0),
+      events(newProfilerArenaArray<ProfilerEvent>(capacity)),
+      counterSamples(nullptr),
+      capacity(capacity),
+      head(0),
+      tail(0) {
+    try {
+        callTree.emplace_back(-1, -1, 0);
+    } catch (...) {
+        deleteProfilerArenaArray(events, capacity);  // The destructor won't run for a half-built buffer
+        throw;
+    }
+}
+ProfilerThreadBuffer::~ProfilerThreadBuffer() {
+    delete counters;
+    delete trace;
+    deleteProfilerArenaArray(events, capacity);
+    deleteProfilerArenaArray(counterSamples, capacity);
+    ProfilerArena::GetInstance()->Deallocate(allocationCounters.load(), ProfilerSectionRegistry::kMaxSections * sizeof(ProfilerAllocationCounters));
+    ProfilerArena::GetInstance()->Deallocate(metricTotals.load(), ProfilerSectionRegistry::kMaxSections * sizeof(ProfilerMetricTotals));
+    ProfilerArena::GetInstance()->Deallocate(lockTotals.load(), ProfilerSectionRegistry::kMaxLocks * sizeof(ProfilerLockTotals));
+}
+
+// Buffers are allocated from the ProfilerArena, like everything they hold
+void* ProfilerThreadBuffer::operator new(size_t size) {
+    return ProfilerArenaAllocator<char>().allocate(size);
+}
+void ProfilerThreadBuffer::operator delete(void* block, size_t size) {
+    ProfilerArena::GetInstance()->Deallocate(block, size);
+}
+
+// statsFor: Returns the stats slot for a section, growing the array to cover every section registered so far
+static ProfilerStats& statsFor(ProfilerVector<ProfilerStats>& stats, int sectionId) {
+    if (sectionId >= static_cast<int>(stats.size())) {
+        ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+        int sectionCount = registry->GetSectionCount();
+        stats.reserve(sectionCount);
+        for (int i = static_cast<int>(stats.size()); i < sectionCount; i++) {
+            stats.emplace_back(registry->GetName(i));
+        }
+    }
+    return stats[sectionId];
+}
+
+// Constructor for ProfilerWindowStats
+ProfilerWindowStats::ProfilerWindowStats() : dropped(false) {}
+
+// StatsFor: The section's entry in the window, added with an empty ProfilerStats on the section's first call
+ProfilerStats& ProfilerWindowStats::StatsFor(int sectionId) {
+    if (sectionId >= static_cast<int>(positions.size())) {
+        int sectionCount = ProfilerSectionRegistry::GetInstance()->GetSectionCount();
+        positions.resize(std::max(sectionId + 1, sectionCount), -1);
+    }
+    int position = positions[sectionId];
+    if (position < 0) {
+        sectionIds.push_back(sectionId);
+        try {
+            stats.emplace_back(ProfilerSectionRegistry::GetInstance()->GetName(sectionId));
+        } catch (const std::bad_alloc&) {
+            sectionIds.pop_back();
+            throw;
+        }
+        position = static_cast<int>(stats.size()) - 1;
+        positions[sectionId] = position;
+    }
+    return stats[position];
+}
+
+// Clear: Empties the window for its next interval; only the entries that were used need their position reset
+void ProfilerWindowStats::Clear() {
+    for (int sectionId : sectionIds) {
+        positions[sectionId] = -1;
+    }
+    stats.clear();
+    sectionIds.clear();
+    dropped = false;
+}
+
+// Drop: Like Clear, also releasing the storage (the flag stays set until the next Clear)
+void ProfilerWindowStats::Drop() {
+    ProfilerVector<ProfilerStats>().swap(stats);
+    ProfilerVector<int>().swap(sectionIds);
+    ProfilerVector<int>().swap(positions);
+    dropped = true;
+}
+
+// Push: Appends an event to the ring; only ever called by the owning thread
+bool ProfilerThreadBuffer::Push(const ProfilerEvent& event) {
+    size_t currentHead = head.load(std::memory_order_relaxed);
+    if (currentHead - tail.load(std::memory_order_acquire) == capacity) {
+        return false;
+    }
+    events[currentHead & (capacity - 1)] = event;
+    head.store(currentHead + 1, std::memory_order_release);
+    return true;
+}
+
+size_t ProfilerThreadBuffer::GetPushedCount() const {
+    return head.load(std::memory_order_relaxed);
+}
+
+// Pop: Removes the oldest event from the ring; only called while holding the drain flag
+bool ProfilerThreadBuffer::Pop(ProfilerEvent& event) {
+    size_t currentTail = tail.load(std::memory_order_relaxed);
+    if (currentTail == head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = events[currentTail & (capacity - 1)];
+    tail.store(currentTail + 1, std::memory_order_release);
+    return true;
+}
+
+// Push (with counters): The counter sample goes into the parallel ring before the event is published
+bool ProfilerThreadBuffer::Push(const ProfilerEvent& event, const ProfilerCounterSample& counters) {
+    size_t currentHead = head.load(std::memory_order_relaxed);
+    if (currentHead - tail.load(std::memory_order_acquire) == capacity) {
+        return false;
+    }
+    events[currentHead & (capacity - 1)] = event;
+    counterSamples[currentHead & (capacity - 1)] = counters;
+    head.store(currentHead + 1, std::memory_order_release);
+    return true;
+}
+
+// Pop (with counters): counters.mask is 0 if the event had no sample
+bool ProfilerThreadBuffer::Pop(ProfilerEvent& event, ProfilerCounterSample& counters) {
+    size_t currentTail = tail.load(std::memory_order_relaxed);
+    if (currentTail == head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = events[currentTail & (capacity - 1)];
+    if (event.hasCounters) {
+        counters = counterSamples[currentTail & (capacity - 1)];
+    } else {
+        counters.mask = 0;
+        counters.configuration = 0;
+    }
+    tail.store(currentTail + 1, std::memory_order_release);
+    return true;
+}
+
+// AllocateCounterSamples: Done once by the producer; published to the consumer by the next Push
+void ProfilerThreadBuffer::AllocateCounterSamples() {
+    if (counterSamples == nullptr) {
+        counterSamples = newProfilerArenaArray<ProfilerCounterSample>(capacity);
+    }
+}
+
+bool ProfilerThreadBuffer::TryLockDrain() {
+    return !draining.test_and_set(std::memory_order_acquire);
+}
+void ProfilerThreadBuffer::LockDrain() {
+    while (draining.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+void ProfilerThreadBuffer::UnlockDrain() {
+    draining.clear(std::memory_order_release);
+}
+
+std::atomic<unsigned> Profiler::nextGeneration(1);
+
+// Profiler constructor: Initializes the Profiler instance, its clock and its overhead calibration
+Profiler::Profiler()
+    : innerOverheadTicks(0.0),
+      pairOverheadTicks(0.0),
+      generation(nextGeneration.fetch_add(1)),
+      traceEnabled(false),
+      traceEventsPerThread(0),
+      tracePolicy(TRACE_POLICY_STOP_WHEN_FULL),
+      nextAsyncSpanId(1),
+      counterConfiguration(0),
+      counterMask(0),
+      binaryWriter(nullptr),
+      binaryFlushIntervalMilliseconds(0),
+      binaryFlushStop(false),
+      sharedWriter(nullptr),
+      sharedIntervalMilliseconds(0),
+      sharedStop(false),
+      windowsEnabled(false),
+      windowIntervalMilliseconds(0),
+      windowStop(false),
+      windowStartTicks(0),
+      publishedWindows(0) {
+    InitializeClock();
+    startTicks = GetCurrentTicks();
+    callTree.emplace_back(-1, -1, 0);
+    calibrateOverhead();
 }
 
-// Profiler singleton: Creates or retrieves the single instance of the Profiler
+// Profiler singleton: Creates or retrieves the single instance of the Profiler (safe to call from any thread)
 Profiler* Profiler::GetInstance() {
-    if(gProfiler == nullptr) {
-        gProfiler = new Profiler();
+    Profiler* instance = gProfiler.load(std::memory_order_acquire);
+    if (instance == nullptr) {
+        static std::mutex creationMutex;
+        std::lock_guard<std::mutex> lock(creationMutex);
+        instance = gProfiler.load(std::memory_order_relaxed);
+        if (instance == nullptr) {
+            instance = new Profiler();
+            gProfiler.store(instance, std::memory_order_release);
+        }
+    }
+    return instance;
+}
+// Destructor for Profiler: Stops the window and binary output threads, then frees the thread buffers and merged stats
+Profiler::~Profiler() {
+    DisableWindows();
+    CloseBinaryOutput();
+    CloseSharedStats();
+    Profiler* expected = this;
+    gProfiler.compare_exchange_strong(expected, nullptr);
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        delete buffer;
+    }
+}
+
+// GetThreadBuffer: Returns the calling thread's buffer, registering it on first use (nullptr if it didn't fit in the budget)
+ProfilerThreadBuffer* Profiler::GetThreadBuffer() {
+    if (tCachedGeneration != generation) {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        ProfilerThreadBuffer* buffer = nullptr;
+        try {
+            buffer = new ProfilerThreadBuffer(static_cast<int>(threadBuffers.size()), kThreadBufferCapacity);
+            threadBuffers.push_back(buffer);
+        } catch (const std::bad_alloc&) {
+            // The thread goes unprofiled for the rest of this Profiler's life rather than retrying on every section
+            delete buffer;
+            buffer = nullptr;
+            warnMemoryBudgetExhausted();
+        }
+        if (buffer != nullptr && traceEnabled) {
+            try {
+                buffer->trace = new ProfilerTraceBuffer(traceEventsPerThread, tracePolicy);
+            } catch (const std::bad_alloc&) {
+                warnMemoryBudgetExhausted();  // Still profiled, just not traced
+            }
+        }
+        tCachedBuffer = buffer;
+        std::atomic_signal_fence(std::memory_order_release);  // A signal handler checking the generation sees the new buffer
+        tCachedGeneration = generation;
+    }
+    return tCachedBuffer;
+}
+
+// GetThreadBufferIfRegistered: The cached buffer, if it belongs to the Profiler that exists right now
+ProfilerThreadBuffer* Profiler::GetThreadBufferIfRegistered() {
+    Profiler* profiler = gProfiler.load(std::memory_order_acquire);
+    if (profiler == nullptr || tCachedGeneration != profiler->generation) {
+        return nullptr;
+    }
+    std::atomic_signal_fence(std::memory_order_acquire);
+    return tCachedBuffer;
+}
+
+// GetActiveSection: Reads the top of a buffer's active-section stack, from its own thread
+int Profiler::GetActiveSection(ProfilerThreadBuffer* buffer) {
+    int depth = buffer->activeDepth.load(std::memory_order_relaxed);
+    if (depth <= 0) {
+        return -1;
+    }
+    return buffer->activeSections[depth < ProfilerThreadBuffer::kMaxActiveSections ? depth - 1 : ProfilerThreadBuffer::kMaxActiveSections - 1];
+}
+
+// GetThreadBufferIfProfiling: GetThreadBuffer of the Profiler that exists right now, if any
+ProfilerThreadBuffer* Profiler::GetThreadBufferIfProfiling() {
+    Profiler* profiler = gProfiler.load(std::memory_order_acquire);
+    return profiler != nullptr ? profiler->GetThreadBuffer() : nullptr;
+}
+
+// GetLockTotals: Allocates the thread's lock table the first time, like AddToMetric's table, with every blocker slot free
+ProfilerLockTotals* Profiler::GetLockTotals(ProfilerThreadBuffer* buffer, int lockId) {
+    ProfilerLockTotals* table = buffer->lockTotals.load(std::memory_order_relaxed);
+    if (table == nullptr) {
+        size_t tableBytes = ProfilerSectionRegistry::kMaxLocks * sizeof(ProfilerLockTotals);
+        table = static_cast<ProfilerLockTotals*>(ProfilerArena::GetInstance()->Allocate(tableBytes));
+        if (table == nullptr) {
+            warnMemoryBudgetExhausted();
+            return nullptr;
+        }
+        std::memset(static_cast<void*>(table), 0, tableBytes);
+        for (int i = 0; i < ProfilerSectionRegistry::kMaxLocks; i++) {
+            for (int slot = 0; slot < kLockBlockerSlots; slot++) {
+                table[i].blockerSections[slot].store(kFreeBlockerSlot, std::memory_order_relaxed);
+            }
+        }
+        buffer->lockTotals.store(table, std::memory_order_release);
+    }
+    return &table[lockId];
+}
+
+unsigned long long Profiler::GetRecordedEventCount() {
+    ProfilerThreadBuffer* buffer = GetThreadBufferIfRegistered();
+    return buffer != nullptr ? buffer->GetPushedCount() : 0;
+}
+
+int Profiler::GetActiveSectionForSignal() {
+    ProfilerThreadBuffer* buffer = GetThreadBufferIfRegistered();
+    return buffer != nullptr ? GetActiveSection(buffer) : -1;
+}
+
+// RecordEvent: Pushes an event into the calling thread's ring, folding the ring into stats when it fills up
+void Profiler::RecordEvent(ProfilerThreadBuffer* buffer, const ProfilerEvent& event) {
+    while (!buffer->Push(event)) {
+        // If the collector already holds the drain flag it is emptying the ring for us
+        if (buffer->TryLockDrain()) {
+            DrainBuffer(buffer);
+            buffer->UnlockDrain();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+void Profiler::RecordEvent(ProfilerThreadBuffer* buffer, const ProfilerEvent& event, const ProfilerCounterSample& counters) {
+    while (!buffer->Push(event, counters)) {
+        if (buffer->TryLockDrain()) {
+            DrainBuffer(buffer);
+            buffer->UnlockDrain();
+        } else {
+            std::this_thread::yield();
+        }
     }
-    return gProfiler;
 }
-// Destructor for Profiler (could clean up dynamic resources here if necessary)
-Profiler::~Profiler() {}   
 
-// EnterSection: Records the start time for a section and stores it in the section map
+// GetThreadCounters: Returns the calling thread's counter group, reopening it first if the settings changed
+ProfilerCounterGroup* Profiler::GetThreadCounters(ProfilerThreadBuffer* buffer) {
+    unsigned configuration = counterConfiguration.load(std::memory_order_acquire);
+    if (buffer->counterConfiguration != configuration) {
+        ProfilerAllocationPause pause;
+        std::vector<ProfilerCounterEvent> events;
+        {
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            events = counterEvents;
+        }
+        delete buffer->counters;
+        buffer->counters = nullptr;
+        try {
+            buffer->counters = events.empty() ? nullptr : ProfilerCounterGroup::Open(events, configuration);
+            if (buffer->counters != nullptr) {
+                buffer->AllocateCounterSamples();
+            }
+        } catch (const std::bad_alloc&) {
+            delete buffer->counters;  // No room for the group or its samples, so this thread records time only
+            buffer->counters = nullptr;
+            warnMemoryBudgetExhausted();
+        }
+        buffer->counterConfiguration = configuration;
+    }
+    return buffer->counters;
+}
+
+// DrainBuffer: Replays one thread's enter/exit events against its call stack and folds them into that thread's stats.
+// If the arena runs out partway, the thread's stats stop where they are and its later events are only counted.
+void Profiler::DrainBuffer(ProfilerThreadBuffer* buffer) {
+    ProfilerAllocationPause pause;  // Often runs inline on a recording thread, inside one of its sections
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    ProfilerVector<ProfilerFrame>& frameStack = buffer->frameStack;
+    ProfilerEvent event;
+    ProfilerCounterSample counters;
+    if (!buffer->outOfMemory) {
+        try {
+            while (buffer->Pop(event, counters)) {
+                if (buffer->trace != nullptr) {
+                    buffer->trace->Record(ProfilerTraceEvent{event.ticks, event.sectionId, static_cast<unsigned short>(buffer->threadId), event.isEnter});
+                }
+
+                if (event.isEnter) {
+                    // Every activation gets its own frame, so recursive and re-entrant sections nest instead of colliding
+                    int parentNode = frameStack.empty() ? 0 : frameStack.back().nodeIndex;
+                    int node = findOrAddChild(buffer->callTree, parentNode, event.sectionId);
+                    frameStack.push_back(ProfilerFrame{event.sectionId, event.ticks, 0, 0, 0, node, counters});
+                    continue;
+                }
+
+                // Find the innermost active frame for this section
+                int frameIndex = static_cast<int>(frameStack.size()) - 1;
+                while (frameIndex >= 0 && frameStack[frameIndex].sectionId != event.sectionId) {
+                    frameIndex--;
+                }
+
+                if (frameIndex < 0) {
+                    std::cerr << "Error: Mismatched section exit for " << registry->GetName(event.sectionId) << " on thread " << buffer->threadId << std::endl;
+                    continue;
+                }
+
+                // Anything opened after it was never exited, so drop those frames rather than charge them a bogus time
+                while (static_cast<int>(frameStack.size()) - 1 > frameIndex) {
+                    std::cerr << "Error: Section " << registry->GetName(frameStack.back().sectionId) << " was never exited on thread " << buffer->threadId << std::endl;
+                    frameStack.pop_back();
+                }
+
+                ProfilerFrame frame = frameStack.back();
+                frameStack.pop_back();
+
+                // Calculate the inclusive and self time, raw and with the cost of this section's own
+                // bookkeeping and of every profiled section nested inside it taken out
+                ProfilerSectionTiming timing;
+                timing.elapsedTicks = event.ticks - frame.ticksAtStart;
+                timing.selfTicks = timing.elapsedTicks - frame.childTicks;
+                double overheadTicks = innerOverheadTicks + frame.descendantCount * pairOverheadTicks;
+                timing.compensatedTicks = std::max<ProfilerTicks>(0, timing.elapsedTicks - static_cast<ProfilerTicks>(overheadTicks + 0.5));
+                timing.compensatedSelfTicks = std::max<ProfilerTicks>(0, timing.compensatedTicks - frame.childCompensatedTicks);
+                timing.counterDeltas.mask = 0;
+                if (frame.countersAtStart.configuration == counters.configuration) {
+                    timing.counterDeltas.mask = frame.countersAtStart.mask & counters.mask;
+                    for (int counter = 0; counter < COUNTER_EVENT_COUNT; counter++) {
+                        if (timing.counterDeltas.mask & (1u << counter)) {
+                            timing.counterDeltas.values[counter] = counters.values[counter] - frame.countersAtStart.values[counter];
+                        }
+                    }
+                }
+                if (!frameStack.empty()) {
+                    ProfilerFrame& parent = frameStack.back();
+                    parent.childTicks += timing.elapsedTicks;
+                    parent.childCompensatedTicks += timing.compensatedTicks;
+                    parent.descendantCount += 1 + frame.descendantCount;
+                }
+
+                ProfilerCallNode& node = buffer->callTree[frame.nodeIndex];
+                node.count++;
+                node.inclusiveTicks += timing.elapsedTicks;
+                node.selfTicks += timing.selfTicks;
+                node.compensatedInclusiveTicks += timing.compensatedTicks;
+                node.compensatedSelfTicks += timing.compensatedSelfTicks;
+
+                // A recursive call is already covered by its outermost activation's total
+                bool isOutermost = true;
+                for (const ProfilerFrame& outer : frameStack) {
+                    if (outer.sectionId == event.sectionId) {
+                        isOutermost = false;
+                        break;
+                    }
+                }
+
+                // Report the time spent in this section
+                ReportSectionTime(statsFor(buffer->stats, event.sectionId), timing, isOutermost, event.lineNumber, event.fileName, event.functionName);
+                if (windowsEnabled.load(std::memory_order_relaxed) && !buffer->windowStats.dropped) {
+                    try {
+                        ReportSectionTime(buffer->windowStats.StatsFor(event.sectionId), timing, isOutermost, event.lineNumber, event.fileName, event.functionName);
+                    } catch (const std::bad_alloc&) {
+                        buffer->windowStats.Drop();  // Only this window loses the thread, the whole-run stats go on
+                        warnMemoryBudgetExhausted();
+                    }
+                }
+            }
+        } catch (const std::bad_alloc&) {
+            buffer->outOfMemory = true;
+            buffer->droppedEvents++;  // The event being replayed
+            warnMemoryBudgetExhausted();
+        }
+    }
+
+    // With no room left to grow its frame stack, call tree or stats, the thread's events can only be counted
+    while (buffer->Pop(event, counters)) {
+        buffer->droppedEvents++;
+    }
+}
+
+// EnterSection: Records the start time for a section in the calling thread's buffer
 void Profiler::EnterSection(char const* sectionName) {
-    double secondsAtStart = GetCurrentTimeSeconds();
-    sectionMap.emplace(sectionName, TimeRecordStart(sectionName, secondsAtStart));
+    EnterSection(ProfilerSectionRegistry::GetInstance()->Intern(sectionName));
+}
+void Profiler::EnterSection(int sectionId) {
+    ProfilerThreadBuffer* buffer = GetThreadBuffer();
+    if (buffer == nullptr) {
+        return;
+    }
+    int depth = buffer->activeDepth.load(std::memory_order_relaxed);
+    if (depth < ProfilerThreadBuffer::kMaxActiveSections) {
+        buffer->activeSections[depth] = sectionId;
+    }
+    buffer->activeDepth.store(depth + 1, std::memory_order_release);
+
+    ProfilerCounterGroup* counterGroup = GetThreadCounters(buffer);
+    if (counterGroup == nullptr) {
+        ProfilerTicks ticksAtStart = GetCurrentTicks();
+        RecordEvent(buffer, ProfilerEvent{sectionId, ticksAtStart, 0, nullptr, nullptr, true, false});
+        return;
+    }
+    // Counters first and the clock last, so the counter read isn't part of the section's time
+    ProfilerCounterSample counters;
+    counterGroup->Read(counters);
+    ProfilerTicks ticksAtStart = GetCurrentTicks();
+    RecordEvent(buffer, ProfilerEvent{sectionId, ticksAtStart, 0, nullptr, nullptr, true, true}, counters);
 }
 
-// ExitSection: Overloaded function to support simple section exit (delegates to full exit function with additional details)
+// ExitSection: Overloaded function to support simple section exit when no call site is known
 void Profiler::ExitSection(char const* sectionName) {
-    double secondsAtStop = GetCurrentTimeSeconds();    
+    ExitSection(ProfilerSectionRegistry::GetInstance()->Intern(sectionName), 0, "null", "null");
 }
 
-// ExitSection (overloaded): Completes profiling for a section, calculates elapsed time, and reports the data
+// ExitSection (overloaded): Records the stop time and call site for a section in the calling thread's buffer
 void Profiler::ExitSection(char const* sectionName, int lineNumber, const char* fileName, const char* functionName) {
-    double secondsAtStop = GetCurrentTimeSeconds();
+    ExitSection(ProfilerSectionRegistry::GetInstance()->Intern(sectionName), lineNumber, fileName, functionName);
+}
+void Profiler::ExitSection(int sectionId, int lineNumber, const char* fileName, const char* functionName) {
+    ProfilerTicks ticksAtStop = GetCurrentTicks();
+    ProfilerThreadBuffer* buffer = GetThreadBuffer();
+    if (buffer == nullptr) {
+        return;
+    }
+    int depth = buffer->activeDepth.load(std::memory_order_relaxed);
+    buffer->activeDepth.store(depth > 0 ? depth - 1 : 0, std::memory_order_release);
+
+    ProfilerCounterGroup* counterGroup = GetThreadCounters(buffer);
+    if (counterGroup == nullptr) {
+        RecordEvent(buffer, ProfilerEvent{sectionId, ticksAtStop, lineNumber, fileName, functionName, false, false});
+        return;
+    }
+    ProfilerCounterSample counters;
+    counterGroup->Read(counters);
+    RecordEvent(buffer, ProfilerEvent{sectionId, ticksAtStop, lineNumber, fileName, functionName, false, true}, counters);
+}
+
+// EnterSectionSampled: Counts down this thread's calls of the section and records every Nth one
+void Profiler::EnterSectionSampled(int sectionId) {
+    ProfilerThreadBuffer* buffer = GetThreadBuffer();
+    if (buffer == nullptr) {
+        return;
+    }
+    if (sectionId >= static_cast<int>(buffer->sampling.size())) {
+        ProfilerAllocationPause pause;
+        try {
+            buffer->sampling.resize(ProfilerSectionRegistry::GetInstance()->GetSectionCount(), ProfilerSamplingState{1, 0});
+        } catch (const std::bad_alloc&) {
+            warnMemoryBudgetExhausted();
+            return;  // The exit finds no state for the section either, so nothing is recorded
+        }
+    }
+    ProfilerSamplingState& state = buffer->sampling[sectionId];
+    bool sampled = --state.countdown == 0;
+    state.sampledBits = (state.sampledBits << 1) | (sampled ? 1 : 0);
+    if (sampled) {
+        state.countdown = ProfilerSectionRegistry::GetInstance()->GetSampleEvery(sectionId);
+        EnterSection(sectionId);
+    }
+}
+
+// ExitSectionSampled: Records the exit only if the matching enter was recorded
+void Profiler::ExitSectionSampled(int sectionId, int lineNumber, const char* fileName, const char* functionName) {
+    ProfilerThreadBuffer* buffer = GetThreadBuffer();
+    if (buffer == nullptr || sectionId >= static_cast<int>(buffer->sampling.size())) {
+        return;  // Never entered on this thread
+    }
+    ProfilerSamplingState& state = buffer->sampling[sectionId];
+    bool sampled = (state.sampledBits & 1) != 0;
+    state.sampledBits >>= 1;
+    if (sampled) {
+        ExitSection(sectionId, lineNumber, fileName, functionName);
+    }
+}
+
+// AddToMetric: Bumps the calling thread's running total, allocating the thread's table from the arena the first
+// time. Only this thread writes the table, so a relaxed load and store are enough.
+void Profiler::AddToMetric(int sectionId, int metricId, long long amount) {
+    if (metricId < 0) {
+        return;  // The registry had no room for the counter's name
+    }
+    ProfilerThreadBuffer* buffer = GetThreadBuffer();
+    if (buffer == nullptr) {
+        return;
+    }
+    ProfilerMetricTotals* table = buffer->metricTotals.load(std::memory_order_relaxed);
+    if (table == nullptr) {
+        size_t tableBytes = ProfilerSectionRegistry::kMaxSections * sizeof(ProfilerMetricTotals);
+        table = static_cast<ProfilerMetricTotals*>(ProfilerArena::GetInstance()->Allocate(tableBytes));
+        if (table == nullptr) {
+            warnMemoryBudgetExhausted();
+            return;
+        }
+        std::memset(static_cast<void*>(table), 0, tableBytes);
+        buffer->metricTotals.store(table, std::memory_order_release);
+    }
+    addRelaxed(table[sectionId].values[metricId], amount);
+}
+
+// BeginAsyncSpan: Starts the clock of a new span; the calling thread only shows up in the trace
+ProfilerAsyncSpan Profiler::BeginAsyncSpan(int sectionId) {
+    ProfilerAsyncSpan span;
+    span.sectionId = sectionId;
+    span.spanId = nextAsyncSpanId.fetch_add(1, std::memory_order_relaxed);
+    span.startTicks = GetCurrentTicks();
+    ProfilerThreadBuffer* buffer = traceEnabled.load(std::memory_order_relaxed) ? GetThreadBuffer() : nullptr;
+    if (buffer != nullptr) {
+        buffer->LockDrain();
+        RecordAsyncStep(buffer, span, ASYNC_PHASE_BEGIN, span.startTicks);
+        buffer->UnlockDrain();
+    }
+    return span;
+}
 
-    // Find the section in the map to retrieve its start time
-    auto it = sectionMap.find(sectionName);
+// HandOffAsyncSpan: Starts the span's queueing delay
+void Profiler::HandOffAsyncSpan(ProfilerAsyncSpan& span) {
+    if (span.handOffTicks != 0) {
+        return;
+    }
+    span.handOffTicks = GetCurrentTicks();
+    ProfilerThreadBuffer* buffer = traceEnabled.load(std::memory_order_relaxed) ? GetThreadBuffer() : nullptr;
+    if (buffer != nullptr) {
+        buffer->LockDrain();
+        RecordAsyncStep(buffer, span, ASYNC_PHASE_HAND_OFF, span.handOffTicks);
+        buffer->UnlockDrain();
+    }
+}
 
-    if (it != sectionMap.end()) {
-        TimeRecordStart sectionStart = it->second;
+// ResumeAsyncSpan: Ends the pending hand-off, adding its wait to the span's queueing delay
+void Profiler::ResumeAsyncSpan(ProfilerAsyncSpan& span) {
+    if (span.handOffTicks == 0) {
+        return;
+    }
+    ProfilerTicks ticks = GetCurrentTicks();
+    ProfilerTicks waited = ticks - span.handOffTicks;
+    span.queueTicks += waited;
+    span.maxQueueTicks = std::max(span.maxQueueTicks, waited);
+    span.handOffCount++;
+    span.handOffTicks = 0;
+    ProfilerThreadBuffer* buffer = traceEnabled.load(std::memory_order_relaxed) ? GetThreadBuffer() : nullptr;
+    if (buffer != nullptr) {
+        buffer->LockDrain();
+        RecordAsyncStep(buffer, span, ASYNC_PHASE_RESUME, ticks);
+        buffer->UnlockDrain();
+    }
+}
 
-        // Calculate the elapsed time
-        double elapsedTime = secondsAtStop - sectionStart.secondsAtStart;
+// EndAsyncSpan: Folds the span straight into the calling thread's stats under its drain flag, the way DrainBuffer
+// folds in an exit (a hand-off still pending counts as resumed now). The span is closed afterwards either way.
+void Profiler::EndAsyncSpan(ProfilerAsyncSpan& span, int lineNumber, const char* fileName, const char* functionName) {
+    ResumeAsyncSpan(span);
+    ProfilerTicks ticksAtEnd = GetCurrentTicks();
+    int sectionId = span.sectionId;
+    ProfilerThreadBuffer* buffer = GetThreadBuffer();
+    if (buffer == nullptr) {
+        span.sectionId = -1;
+        return;
+    }
 
-        // Remove the section from the map
-        sectionMap.erase(it);
+    ProfilerSectionTiming timing;
+    timing.elapsedTicks = ticksAtEnd - span.startTicks;
+    timing.selfTicks = timing.elapsedTicks;
+    timing.compensatedTicks = std::max<ProfilerTicks>(0, timing.elapsedTicks - static_cast<ProfilerTicks>(innerOverheadTicks + 0.5));
+    timing.compensatedSelfTicks = timing.compensatedTicks;
+    timing.counterDeltas.mask = 0;
 
-        // Report the time spent in this section
-        ReportSectionTime(sectionName, elapsedTime, lineNumber, fileName, functionName);
+    ProfilerAllocationPause pause;
+    buffer->LockDrain();
+    if (buffer->outOfMemory) {
+        buffer->droppedEvents++;
     } else {
-        std::cerr << "Error: Mismatched section exit for " << sectionName << std::endl;
+        // Into the whole-run stats, and the current window's
+        auto report = [&](ProfilerStats& sectionStats) {
+            ReportSectionTime(sectionStats, timing, true, lineNumber, fileName, functionName);
+            sectionStats.asyncCount++;
+            sectionStats.handOffCount += span.handOffCount;
+            sectionStats.queueTicks += span.queueTicks;
+            sectionStats.maxQueueTicks = std::max(sectionStats.maxQueueTicks, span.maxQueueTicks);
+        };
+        try {
+            report(statsFor(buffer->stats, sectionId));
+            if (windowsEnabled.load(std::memory_order_relaxed) && !buffer->windowStats.dropped) {
+                try {
+                    report(buffer->windowStats.StatsFor(sectionId));
+                } catch (const std::bad_alloc&) {
+                    buffer->windowStats.Drop();
+                    warnMemoryBudgetExhausted();
+                }
+            }
+            RecordAsyncStep(buffer, span, ASYNC_PHASE_END, ticksAtEnd);
+        } catch (const std::bad_alloc&) {
+            buffer->outOfMemory = true;
+            buffer->droppedEvents++;
+            warnMemoryBudgetExhausted();
+        }
     }
+    buffer->UnlockDrain();
+    span.sectionId = -1;
 }
 
-// ReportSectionTime: Updates the statistics for a given section based on its elapsed time
-void Profiler::ReportSectionTime(char const* sectionName, double elapsedTime, int lineNumber, const char* fileName, const char* functionName) {
-    // Check if the section already exists in the stats map
-    if (stats.find(sectionName) == stats.end()) {
-        stats[sectionName] = new ProfilerStats(sectionName);  // Create a new stats entry if it doesn't exist
+// RecordAsyncStep: Adds a step of a span to the thread's trace, if it has one
+void Profiler::RecordAsyncStep(ProfilerThreadBuffer* buffer, const ProfilerAsyncSpan& span, ProfilerAsyncPhase phase, ProfilerTicks ticks) {
+    if (buffer->trace != nullptr) {
+        buffer->trace->RecordAsync(ProfilerAsyncTraceEvent{ticks, span.spanId, span.sectionId, static_cast<unsigned short>(buffer->threadId), static_cast<unsigned char>(phase)});
     }
+}
 
+// ReportSectionTime: Updates the statistics for a given section based on its elapsed time
+// (nested recursive calls count towards calls, min/max and self time but not again towards total time)
+void Profiler::ReportSectionTime(ProfilerStats& sectionStats, const ProfilerSectionTiming& timing, bool isOutermost, int lineNumber, const char* fileName, const char* functionName) {
     // Update the stats for the section
-    ProfilerStats* sectionStats = stats[sectionName];
-    sectionStats->count++;  // Increment the count of calls
-    sectionStats->totalTime += elapsedTime;  // Add to the total time
-    sectionStats->minTime = std::min(sectionStats->minTime, elapsedTime);  // Update minimum time
-    sectionStats->maxTime = std::max(sectionStats->maxTime, elapsedTime);  // Update maximum time
-    sectionStats->avgTime = sectionStats->totalTime / sectionStats->count;  // Calculate average time
+    sectionStats.count++;  // Increment the count of calls
+    if (isOutermost) {
+        sectionStats.outermostCount++;
+        sectionStats.totalTicks += timing.elapsedTicks;  // Add to the total time
+        sectionStats.compensatedTotalTicks += timing.compensatedTicks;
+    }
+    sectionStats.selfTicks += timing.selfTicks;  // Add to the time spent outside profiled children
+    sectionStats.compensatedSelfTicks += timing.compensatedSelfTicks;
+    sectionStats.minTicks = std::min(sectionStats.minTicks, timing.elapsedTicks);  // Update minimum time
+    sectionStats.maxTicks = std::max(sectionStats.maxTicks, timing.elapsedTicks);  // Update maximum time
+    sectionStats.histogram.Record(timing.elapsedTicks);  // Update the latency distribution
+    if (isOutermost && timing.counterDeltas.mask != 0) {
+        sectionStats.counterCalls++;
+        sectionStats.counterMask |= timing.counterDeltas.mask;
+        for (int counter = 0; counter < COUNTER_EVENT_COUNT; counter++) {
+            if (timing.counterDeltas.mask & (1u << counter)) {
+                sectionStats.counterTotals[counter] += timing.counterDeltas.values[counter];
+            }
+        }
+    }
 
     // Update additional metadata for debugging purposes
-    sectionStats->fileName = fileName;
-    sectionStats->functionName = functionName;
-    sectionStats->lineNumber = lineNumber;
+    sectionStats.fileName = fileName;
+    sectionStats.functionName = functionName;
+    sectionStats.lineNumber = lineNumber;
+}
+
+// CollectAllocations: Copies the thread's running allocation totals into its stats. The counters only ever
+// grow, so this overwrites rather than adds.
+void Profiler::CollectAllocations(ProfilerThreadBuffer* buffer) {
+    ProfilerAllocationCounters* table = buffer->allocationCounters.load(std::memory_order_acquire);
+    if (table == nullptr) {
+        return;
+    }
+    ProfilerAllocationPause pause;
+    int sectionCount = ProfilerSectionRegistry::GetInstance()->GetSectionCount();
+    try {
+        for (int sectionId = 0; sectionId < sectionCount; sectionId++) {
+            const ProfilerAllocationCounters& counters = table[sectionId];
+            long long allocations = counters.allocations.load(std::memory_order_relaxed);
+            long long freedBytes = counters.freedBytes.load(std::memory_order_relaxed);
+            if (allocations == 0 && freedBytes == 0) {
+                continue;
+            }
+            ProfilerStats& sectionStats = statsFor(buffer->stats, sectionId);
+            sectionStats.allocationCount = allocations;
+            sectionStats.allocatedBytes = counters.allocatedBytes.load(std::memory_order_relaxed);
+            sectionStats.freedBytes = freedBytes;
+            sectionStats.peakLiveBytes = counters.peakLiveBytes.load(std::memory_order_relaxed);
+        }
+    } catch (const std::bad_alloc&) {
+        warnMemoryBudgetExhausted();  // Sections the stats array can't grow to cover go without
+    }
+}
+
+// CollectMetrics: Copies the thread's running custom counter totals into its stats, overwriting like CollectAllocations
+void Profiler::CollectMetrics(ProfilerThreadBuffer* buffer) {
+    ProfilerMetricTotals* table = buffer->metricTotals.load(std::memory_order_acquire);
+    if (table == nullptr) {
+        return;
+    }
+    ProfilerAllocationPause pause;
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    int sectionCount = registry->GetSectionCount();
+    int metricCount = registry->GetMetricCount();
+    try {
+        for (int sectionId = 0; sectionId < sectionCount; sectionId++) {
+            for (int metric = 0; metric < metricCount; metric++) {
+                long long total = table[sectionId].values[metric].load(std::memory_order_relaxed);
+                if (total == 0) {
+                    continue;
+                }
+                ProfilerStats& sectionStats = statsFor(buffer->stats, sectionId);
+                sectionStats.metricMask |= 1u << metric;
+                sectionStats.metricTotals[metric] = total;
+            }
+        }
+    } catch (const std::bad_alloc&) {
+        warnMemoryBudgetExhausted();
+    }
+}
+
+// registeredMetricNames: Every custom counter name in metric ID order, for the report columns
+static std::vector<std::string> registeredMetricNames() {
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    std::vector<std::string> names;
+    for (int metric = 0; metric < registry->GetMetricCount(); metric++) {
+        names.push_back(registry->GetMetricName(metric));
+    }
+    return names;
 }
 
+// MergeSectionStats: Folds one thread's stats for a section into an aggregate array
+void Profiler::MergeSectionStats(ProfilerVector<ProfilerStats>& target, int sectionId, const ProfilerStats& source) {
+    if (!source.HasData()) {
+        return;
+    }
+    statsFor(target, sectionId).Merge(source);
+}
 
-// printStatsToCSV: Writes the profiling statistics to a CSV file
+// printStatsToCSV: Writes the profiling statistics to a CSV file, totals first ("all") then one block per thread
 void Profiler::printStatsToCSV(const char* fileName) {
     std::ofstream file(fileName);  // Open the file
 
@@ -121,27 +1102,32 @@ void Profiler::printStatsToCSV(const char* fileName) {
     }
 
     // Write the CSV headers
-    file << "Section Name, Call Count, Total Time, Min Time, Max Time, Avg Time, File Name, Function Name, Line Number\n";
+    std::vector<std::string> metricNames = registeredMetricNames();
+    writeStatsCSVHeader(file, metricNames);
 
     // Write each section's statistics to the CSV
-    for (const auto& entry : stats) {
-        ProfilerStats* stat = entry.second;
-        file << stat->sectionName << ", " 
-             << stat->count << ", " 
-             << stat->totalTime << ", " 
-             << stat->minTime << ", " 
-             << stat->maxTime << ", " 
-             << stat->avgTime << ", " 
-             << stat->fileName << ", " 
-             << stat->functionName << ", " 
-             << stat->lineNumber << "\n";
+    for (const ProfilerStats& stat : stats) {
+        if (stat.HasData()) {
+            writeStatsCSVRow(file, "all", &stat, metricNames);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        buffer->LockDrain();
+        for (const ProfilerStats& stat : buffer->stats) {
+            if (stat.HasData()) {
+                writeStatsCSVRow(file, std::to_string(buffer->threadId), &stat, metricNames);
+            }
+        }
+        buffer->UnlockDrain();
     }
 
     file.close();
     std::cout << "Profiler stats written to " << fileName << " in CSV format.\n";
 }
 
-// printStatsToJSON: Writes the profiling statistics to a JSON file
+// printStatsToJSON: Writes the profiling statistics to a JSON file, totals first ("all") then one block per thread
 void Profiler::printStatsToJSON(const char* fileName) {
     std::ofstream file(fileName);  // Open the file
 
@@ -154,27 +1140,35 @@ void Profiler::printStatsToJSON(const char* fileName) {
     // Start the JSON array
     file << "[\n";
 
+    std::vector<std::string> metricNames = registeredMetricNames();
     bool first = true;
-    for (const auto& entry : stats) {
-        ProfilerStats* stat = entry.second;
-        
+    for (const ProfilerStats& stat : stats) {
+        if (!stat.HasData()) {
+            continue;
+        }
         if (!first) {
             file << ",\n";  // Add a comma between objects
         }
         first = false;
 
         // Write the JSON object for each section
-        file << "  {\n";
-        file << "    \"Section Name\": \"" << stat->sectionName << "\",\n";
-        file << "    \"Call Count\": " << stat->count << ",\n";
-        file << "    \"Total Time\": " << stat->totalTime << ",\n";
-        file << "    \"Min Time\": " << stat->minTime << ",\n";
-        file << "    \"Max Time\": " << stat->maxTime << ",\n";
-        file << "    \"Avg Time\": " << stat->avgTime << ",\n";
-        file << "    \"File Name\": \"" << stat->fileName << "\",\n";
-        file << "    \"Function Name\": \"" << stat->functionName << "\",\n";
-        file << "    \"Line Number\": " << stat->lineNumber << "\n";
-        file << "  }";
+        writeStatsJSONObject(file, "all", &stat, TicksToSeconds(1), metricNames);
+    }
+
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        buffer->LockDrain();
+        for (const ProfilerStats& stat : buffer->stats) {
+            if (!stat.HasData()) {
+                continue;
+            }
+            if (!first) {
+                file << ",\n";
+            }
+            first = false;
+            writeStatsJSONObject(file, std::to_string(buffer->threadId), &stat, TicksToSeconds(1), metricNames);
+        }
+        buffer->UnlockDrain();
     }
 
     file << "\n]\n";  // End the JSON array
@@ -183,48 +1177,965 @@ void Profiler::printStatsToJSON(const char* fileName) {
     std::cout << "Profiler stats written to " << fileName << " in JSON format.\n";
 }
 
-// calculateStats: Updates the statistics based on recorded elapsed times
+// printLiveStatsToJSON: Same layout as printStatsToJSON, built from a fresh drain of every thread instead of the
+// last calculateStats. It works on copies and never touches the merged stats, so it is safe while sections are running.
+void Profiler::printLiveStatsToJSON(std::ostream& file) {
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    ProfilerVector<std::pair<int, ProfilerVector<ProfilerStats>>> threadStats;
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (ProfilerThreadBuffer* buffer : threadBuffers) {
+            buffer->LockDrain();
+            DrainBuffer(buffer);
+            CollectAllocations(buffer);
+            CollectMetrics(buffer);
+            try {
+                threadStats.emplace_back(buffer->threadId, buffer->stats);
+            } catch (const std::bad_alloc&) {
+                warnMemoryBudgetExhausted();  // The thread is left out of this snapshot
+            }
+            buffer->UnlockDrain();
+        }
+    }
+
+    ProfilerVector<ProfilerStats> merged;
+    for (auto& thread : threadStats) {
+        for (size_t sectionId = 0; sectionId < thread.second.size(); sectionId++) {
+            ProfilerStats& stat = thread.second[sectionId];
+            stat.sampleEvery = registry->GetSampleEvery(static_cast<int>(sectionId));
+            stat.ConvertTicksToSeconds();
+            try {
+                MergeSectionStats(merged, static_cast<int>(sectionId), stat);
+            } catch (const std::bad_alloc&) {
+                warnMemoryBudgetExhausted();
+            }
+        }
+    }
+    for (size_t sectionId = 0; sectionId < merged.size(); sectionId++) {
+        merged[sectionId].sampleEvery = registry->GetSampleEvery(static_cast<int>(sectionId));
+        merged[sectionId].ConvertTicksToSeconds();
+    }
+
+    std::vector<std::string> metricNames = registeredMetricNames();
+    file << "[\n";
+    bool first = true;
+    for (const ProfilerStats& stat : merged) {
+        if (!stat.HasData()) {
+            continue;
+        }
+        if (!first) {
+            file << ",\n";
+        }
+        first = false;
+        writeStatsJSONObject(file, "all", &stat, TicksToSeconds(1), metricNames);
+    }
+    for (const auto& thread : threadStats) {
+        for (const ProfilerStats& stat : thread.second) {
+            if (!stat.HasData()) {
+                continue;
+            }
+            if (!first) {
+                file << ",\n";
+            }
+            first = false;
+            writeStatsJSONObject(file, std::to_string(thread.first), &stat, TicksToSeconds(1), metricNames);
+        }
+    }
+    file << "\n]\n";
+}
+
+// calculateStats: Drains every thread's buffer, rebuilds the merged statistics from the per-thread stats and converts them to seconds
 void Profiler::calculateStats() {
-    // Iterate through all the recorded elapsed times
-    for (const auto& elapsed : elapsedTimes) {
-        const char* sectionName = elapsed.sectionName;
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    std::lock_guard<std::mutex> lock(threadsMutex);
 
-        // If section is not already in the stats map, create an entry for it
-        if (stats.find(sectionName) == stats.end()) {
-            stats[sectionName] = new ProfilerStats(sectionName);
+    // Start from a clean aggregate so calling this more than once doesn't double count
+    stats.clear();
+    callTree.clear();
+    callTree.emplace_back(-1, -1, 0);
+
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        buffer->LockDrain();
+        DrainBuffer(buffer);
+        CollectAllocations(buffer);
+        CollectMetrics(buffer);
+        try {
+            for (size_t sectionId = 0; sectionId < buffer->stats.size(); sectionId++) {
+                buffer->stats[sectionId].sampleEvery = registry->GetSampleEvery(static_cast<int>(sectionId));
+                buffer->stats[sectionId].ConvertTicksToSeconds();
+                MergeSectionStats(stats, static_cast<int>(sectionId), buffer->stats[sectionId]);
+            }
+            mergeCallTree(callTree, 0, buffer->callTree, 0);
+        } catch (const std::bad_alloc&) {
+            warnMemoryBudgetExhausted();  // The totals miss whatever of this thread didn't fit
+        }
+        buffer->UnlockDrain();
+    }
+
+    // Everything above was accumulated in raw ticks, only now turn it into seconds
+    for (size_t sectionId = 0; sectionId < stats.size(); sectionId++) {
+        stats[sectionId].sampleEvery = registry->GetSampleEvery(static_cast<int>(sectionId));
+        stats[sectionId].ConvertTicksToSeconds();
+    }
+}
+
+// EnableTrace: Starts keeping every event, giving each thread (current and future) its own preallocated trace buffer.
+// Calling it again starts a fresh trace with the new settings.
+void Profiler::EnableTrace(size_t eventsPerThread, ProfilerTracePolicy policy) {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    traceEnabled = true;
+    traceEventsPerThread = eventsPerThread;
+    tracePolicy = policy;
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        ProfilerTraceBuffer* trace = nullptr;
+        try {
+            trace = new ProfilerTraceBuffer(eventsPerThread, policy);
+        } catch (const std::bad_alloc&) {
+            warnMemoryBudgetExhausted();  // This thread goes untraced
+        }
+        buffer->LockDrain();
+        DrainBuffer(buffer);  // Events from before the trace started don't belong in it
+        delete buffer->trace;
+        buffer->trace = trace;
+        buffer->UnlockDrain();
+    }
+}
+
+// EnableCounters: Checks which of the events this thread can open, then has every thread open them on its
+// next section. Nothing changes if none of them can be counted.
+bool Profiler::EnableCounters(const std::vector<ProfilerCounterEvent>& events) {
+    ProfilerCounterGroup* probe;
+    try {
+        probe = ProfilerCounterGroup::Open(events, 0);
+    } catch (const std::bad_alloc&) {
+        warnMemoryBudgetExhausted();
+        return false;
+    }
+    if (probe == nullptr) {
+        std::cerr << "Hardware counters unavailable: " << GetCounterUnavailableReason() << ". Sections will record time only." << std::endl;
+        return false;
+    }
+    unsigned mask = probe->GetOpenMask();
+    bool rdpmc = probe->UsesRdpmc();
+    delete probe;
+
+    std::cout << "Profiler counting";
+    for (ProfilerCounterEvent event : events) {
+        if (mask & (1u << event)) {
+            std::cout << " " << GetCounterEventName(event) << ",";
+        }
+    }
+    std::cout << (rdpmc ? " read with rdpmc" : " read with read()");
+    for (ProfilerCounterEvent event : events) {
+        if ((mask & (1u << event)) == 0) {
+            std::cout << "; " << GetCounterEventName(event) << " unavailable";
+        }
+    }
+    std::cout << "\n";
+
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        counterEvents = events;
+        counterMask = mask;
+        counterConfiguration.fetch_add(1, std::memory_order_release);
+    }
+    calibrateOverhead();
+    return true;
+}
+
+// DisableCounters: Every thread closes its counters on its next section
+void Profiler::DisableCounters() {
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        if (counterEvents.empty()) {
+            return;
+        }
+        counterEvents.clear();
+        counterMask = 0;
+        counterConfiguration.fetch_add(1, std::memory_order_release);
+    }
+    calibrateOverhead();
+}
+
+unsigned Profiler::GetCounterMask() {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    return counterMask;
+}
+
+// EnableAllocationTracking: Starts charging operator new/delete to sections from the next allocation on
+bool Profiler::EnableAllocationTracking() {
+    if (!AreAllocationHooksInstalled()) {
+        std::cerr << "Allocation tracking unavailable: build with -DPROFILER_ALLOCATION_HOOKS to install the hooks." << std::endl;
+        return false;
+    }
+    SetAllocationTracking(true);
+    return true;
+}
+
+// DisableAllocationTracking: Stops counting; frees of blocks counted earlier are still credited back
+void Profiler::DisableAllocationTracking() {
+    SetAllocationTracking(false);
+}
+
+// DisableTrace: Stops adding events; what was already recorded can still be written out
+void Profiler::DisableTrace() {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    traceEnabled = false;
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        buffer->LockDrain();
+        DrainBuffer(buffer);
+        if (buffer->trace != nullptr) {
+            buffer->trace->recording = false;
+        }
+        buffer->UnlockDrain();
+    }
+}
+
+// printTraceToJSON: Writes every thread's trace in the Chrome Trace Event format (chrome://tracing, ui.perfetto.dev)
+void Profiler::printTraceToJSON(const char* fileName) {
+    std::ofstream file(fileName);  // Open the file
+
+    // Check if the file is open
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for trace output." << std::endl;
+        return;
+    }
+
+    unsigned long long dropped = 0;
+    unsigned long long overwritten = 0;
+
+    file << std::fixed << std::setprecision(3);  // Microsecond timestamps down to the nanosecond
+    file << "{\n  \"displayTimeUnit\": \"ns\",\n  \"traceEvents\": [\n";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        buffer->LockDrain();
+        DrainBuffer(buffer);
+        if (buffer->trace != nullptr) {
+            writeChromeTraceEvents(file, buffer->threadId, *buffer->trace, startTicks, first);
+            dropped += buffer->trace->GetDroppedCount();
+            overwritten += buffer->trace->GetOverwrittenCount();
+        }
+        buffer->UnlockDrain();
+    }
+    file << "\n  ],\n";
+    file << "  \"otherData\": {\"droppedEvents\": " << dropped << ", \"overwrittenEvents\": " << overwritten << "}\n}\n";
+
+    file.close();
+    std::cout << "Profiler trace written to " << fileName << " in Chrome Trace Event format.\n";
+    if (dropped > 0 || overwritten > 0) {
+        std::cout << "  (" << dropped << " events dropped and " << overwritten << " overwritten because the trace buffers were full)\n";
+    }
+}
+
+// OpenBinaryOutput: Starts a binary profile file, closing any previous one first
+void Profiler::OpenBinaryOutput(const char* fileName, int flushIntervalMilliseconds) {
+    CloseBinaryOutput();
+
+    std::lock_guard<std::mutex> lock(binaryMutex);
+    ProfilerBinaryWriter* writer = new ProfilerBinaryWriter();
+    if (!writer->Open(fileName)) {
+        std::cerr << "Failed to open file for binary output." << std::endl;
+        delete writer;
+        return;
+    }
+    writer->WriteMetadata(collectRunMetadata());
+    binaryWriter = writer;
+    binaryFlushIntervalMilliseconds = flushIntervalMilliseconds;
+    binaryFlushStop = false;
+    if (flushIntervalMilliseconds > 0) {
+        binaryFlushThread = std::thread(&Profiler::BinaryFlushLoop, this);
+    }
+}
+
+// WriteBinarySnapshot: Appends the current state of every thread to the binary file, if one is open
+void Profiler::WriteBinarySnapshot() {
+    std::lock_guard<std::mutex> lock(binaryMutex);
+    WriteBinarySnapshotLocked(binaryWriter);
+}
+
+// WriteBinarySnapshotLocked: Drains every thread's ring like calculateStats does, but writes the per-thread
+// raw stats instead of merging them, so the merged stats other threads may be reading are never touched
+void Profiler::WriteBinarySnapshotLocked(ProfilerBinaryWriter* writer) {
+    if (writer == nullptr) {
+        return;
+    }
+    writer->BeginSnapshot(TicksToSeconds(1), innerOverheadTicks, pairOverheadTicks, TicksToSeconds(GetCurrentTicks() - startTicks));
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        buffer->LockDrain();
+        DrainBuffer(buffer);
+        CollectAllocations(buffer);
+        CollectMetrics(buffer);
+        writer->WriteThread(buffer->threadId, buffer->stats, buffer->callTree);
+        buffer->UnlockDrain();
+    }
+    writer->EndSnapshot();
+}
+
+// BinaryFlushLoop: Background thread writing a snapshot every flush interval until CloseBinaryOutput
+void Profiler::BinaryFlushLoop() {
+    std::unique_lock<std::mutex> lock(binaryMutex);
+    while (!binaryFlushCondition.wait_for(lock, std::chrono::milliseconds(binaryFlushIntervalMilliseconds), [this] { return binaryFlushStop; })) {
+        WriteBinarySnapshotLocked(binaryWriter);
+    }
+}
+
+// CloseBinaryOutput: Stops the flush thread and writes the final snapshot
+void Profiler::CloseBinaryOutput() {
+    {
+        std::lock_guard<std::mutex> lock(binaryMutex);
+        if (binaryWriter == nullptr) {
+            return;
+        }
+        binaryFlushStop = true;
+    }
+    binaryFlushCondition.notify_all();
+    if (binaryFlushThread.joinable()) {
+        binaryFlushThread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(binaryMutex);
+    WriteBinarySnapshotLocked(binaryWriter);
+    binaryWriter->Close();
+    delete binaryWriter;
+    binaryWriter = nullptr;
+}
+
+// OpenSharedStats: Creates the shared memory object and starts the publishing thread
+bool Profiler::OpenSharedStats(const char* name, int intervalMilliseconds) {
+    CloseSharedStats();
+    ProfilerSharedWriter* writer = new ProfilerSharedWriter();
+    if (!writer->Open(name)) {
+        delete writer;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    sharedWriter = writer;
+    sharedIntervalMilliseconds = intervalMilliseconds > 0 ? intervalMilliseconds : 1;
+    sharedStop = false;
+    sharedThread = std::thread(&Profiler::SharedPublishLoop, this);
+    return true;
+}
+
+// PublishSharedStats: Drains and merges every thread like calculateStats, into a local array so the merged
+// stats other threads may be reading are never touched, and hands the result to the writer
+void Profiler::PublishSharedStats() {
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    ProfilerVector<ProfilerStats> merged;
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (ProfilerThreadBuffer* buffer : threadBuffers) {
+            buffer->LockDrain();
+            DrainBuffer(buffer);
+            CollectAllocations(buffer);
+            try {
+                for (size_t sectionId = 0; sectionId < buffer->stats.size(); sectionId++) {
+                    MergeSectionStats(merged, static_cast<int>(sectionId), buffer->stats[sectionId]);
+                }
+            } catch (const std::bad_alloc&) {
+                warnMemoryBudgetExhausted();
+            }
+            buffer->UnlockDrain();
+        }
+    }
+    for (size_t sectionId = 0; sectionId < merged.size(); sectionId++) {
+        merged[sectionId].sampleEvery = registry->GetSampleEvery(static_cast<int>(sectionId));
+        merged[sectionId].ConvertTicksToSeconds();
+    }
+    sharedWriter->Publish(merged, TicksToSeconds(GetCurrentTicks() - startTicks));
+}
+
+// SharedPublishLoop: Background thread publishing once per interval in which a reader asked for it
+void Profiler::SharedPublishLoop() {
+    std::unique_lock<std::mutex> lock(sharedMutex);
+    while (!sharedCondition.wait_for(lock, std::chrono::milliseconds(sharedIntervalMilliseconds), [this] { return sharedStop; })) {
+        if (sharedWriter->HasPendingRequest()) {
+            PublishSharedStats();
+        }
+    }
+}
+
+std::string Profiler::GetSharedStatsName() {
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    return sharedWriter != nullptr ? sharedWriter->GetName() : std::string();
+}
+
+// CloseSharedStats: Stops the publishing thread and removes the shared memory object
+void Profiler::CloseSharedStats() {
+    {
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        if (sharedWriter == nullptr) {
+            return;
+        }
+        sharedStop = true;
+    }
+    sharedCondition.notify_all();
+    if (sharedThread.joinable()) {
+        sharedThread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    sharedWriter->Close();
+    delete sharedWriter;
+    sharedWriter = nullptr;
+}
+
+// EnableWindows: Starts a fresh window history, closing windows every intervalMilliseconds if that is above 0
+bool Profiler::EnableWindows(int intervalMilliseconds, size_t historyLength) {
+    DisableWindows();
+    if (historyLength == 0) {
+        std::cerr << "Windows need a history of at least one window." << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> closeLock(windowCloseMutex);
+    try {
+        ProfilerVector<ProfilerWindow> history(historyLength);
+        std::lock_guard<std::mutex> lock(windowsMutex);
+        windowHistory.swap(history);
+        publishedWindows = 0;
+        windowIntervalMilliseconds = intervalMilliseconds;
+    } catch (const std::bad_alloc&) {
+        warnMemoryBudgetExhausted();
+        return false;
+    }
+
+    // Events drained from here on count towards the first window; anything already in a thread's window
+    // stats is from an earlier history
+    windowsEnabled.store(true, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (ProfilerThreadBuffer* buffer : threadBuffers) {
+            buffer->LockDrain();
+            DrainBuffer(buffer);
+            buffer->windowStats.Clear();
+            buffer->UnlockDrain();
+        }
+    }
+    buildingWindow.index = 0;
+    windowStartTicks = GetCurrentTicks();
+    windowStop = false;
+    if (intervalMilliseconds > 0) {
+        windowThread = std::thread(&Profiler::WindowLoop, this);
+    }
+    return true;
+}
+
+// DisableWindows: Stops the window thread and stops filling windows
+void Profiler::DisableWindows() {
+    {
+        std::lock_guard<std::mutex> lock(windowCloseMutex);
+        windowStop = true;
+    }
+    windowCondition.notify_all();
+    if (windowThread.joinable()) {
+        windowThread.join();
+    }
+    windowsEnabled.store(false, std::memory_order_relaxed);
+}
+
+// MarkFrame: Ends the current window and starts the next one
+void Profiler::MarkFrame() {
+    if (!windowsEnabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(windowCloseMutex);
+    if (windowsEnabled.load(std::memory_order_relaxed)) {
+        CloseWindow();
+    }
+}
+
+// WindowLoop: Background thread closing a window every interval until DisableWindows
+void Profiler::WindowLoop() {
+    std::unique_lock<std::mutex> lock(windowCloseMutex);
+    while (!windowCondition.wait_for(lock, std::chrono::milliseconds(windowIntervalMilliseconds), [this] { return windowStop; })) {
+        CloseWindow();
+    }
+}
+
+// CloseWindow: Drains every thread and takes its window stats, swapping in the spare set so the thread goes
+// straight on into the next window, then merges them and publishes the result as the newest window
+void Profiler::CloseWindow() {
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    ProfilerTicks windowStopTicks = GetCurrentTicks();
+    buildingWindow.startSeconds = TicksToSeconds(windowStartTicks - startTicks);
+    buildingWindow.endSeconds = TicksToSeconds(windowStopTicks - startTicks);
+    buildingWindow.incomplete = false;
+    buildingWindowStats.Clear();
+    windowStartTicks = windowStopTicks;
+
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (ProfilerThreadBuffer* buffer : threadBuffers) {
+            buffer->LockDrain();
+            DrainBuffer(buffer);
+            std::swap(buffer->windowStats, spareWindowStats);
+            buffer->UnlockDrain();
+
+            // Merged outside the drain flag, and cleared in place so the entries keep their storage
+            if (spareWindowStats.dropped) {
+                buildingWindow.incomplete = true;
+            }
+            try {
+                for (size_t i = 0; i < spareWindowStats.stats.size(); i++) {
+                    if (spareWindowStats.stats[i].HasData()) {
+                        buildingWindowStats.StatsFor(spareWindowStats.sectionIds[i]).Merge(spareWindowStats.stats[i]);
+                    }
+                }
+            } catch (const std::bad_alloc&) {
+                warnMemoryBudgetExhausted();  // The window misses whatever of this thread didn't fit
+                buildingWindow.incomplete = true;
+            }
+            spareWindowStats.Clear();
+        }
+    }
+    buildingWindow.sections.clear();
+    try {
+        buildingWindow.sections.reserve(buildingWindowStats.stats.size());
+        for (size_t i = 0; i < buildingWindowStats.stats.size(); i++) {
+            ProfilerStats& stat = buildingWindowStats.stats[i];
+            stat.sampleEvery = registry->GetSampleEvery(buildingWindowStats.sectionIds[i]);
+            stat.ConvertTicksToSeconds();
+            buildingWindow.sections.push_back(ProfilerWindowSection{ stat.sectionName, stat.count, stat.totalTime, stat.avgTime,
+                                                                     stat.minTime, stat.maxTime, stat.p50Time, stat.p90Time, stat.p99Time });
+        }
+    } catch (const std::bad_alloc&) {
+        warnMemoryBudgetExhausted();  // Published with no sections rather than not at all, so the indices stay in step
+        buildingWindow.sections.clear();
+        buildingWindow.incomplete = true;
+    }
+    if (buildingWindow.incomplete) {
+        // The budget is short, so hand the window storage back for the whole-run stats rather than keep it
+        buildingWindowStats.Drop();
+        spareWindowStats.Drop();
+    }
+    buildingWindowStats.Clear();
+
+    std::lock_guard<std::mutex> lock(windowsMutex);
+    unsigned long long index = buildingWindow.index;
+    std::swap(buildingWindow, windowHistory[index % windowHistory.size()]);
+    buildingWindow.index = index + 1;
+    publishedWindows = index + 1;
+}
+
+// GetLatestWindow: Copies the newest published window
+bool Profiler::GetLatestWindow(ProfilerWindow& window) {
+    std::lock_guard<std::mutex> lock(windowsMutex);
+    if (publishedWindows == 0) {
+        return false;
+    }
+    try {
+        window = windowHistory[(publishedWindows - 1) % windowHistory.size()];
+    } catch (const std::bad_alloc&) {
+        warnMemoryBudgetExhausted();
+        return false;
+    }
+    return true;
+}
+
+// printWindowsToJSON: Writes the window history, oldest first, with the interval it was closed at (0 for MarkFrame only)
+void Profiler::printWindowsToJSON(std::ostream& file) {
+    std::lock_guard<std::mutex> lock(windowsMutex);
+    unsigned long long kept = std::min<unsigned long long>(publishedWindows, windowHistory.size());
+    file << "{\n\"Interval Milliseconds\": " << windowIntervalMilliseconds << ",\n\"Windows\": [\n";
+    for (unsigned long long index = publishedWindows - kept; index < publishedWindows; index++) {
+        if (index != publishedWindows - kept) {
+            file << ",\n";
+        }
+        writeWindowJSONObject(file, windowHistory[index % windowHistory.size()]);
+    }
+    file << "\n]\n}\n";
+}
+void Profiler::printWindowsToJSON(const char* fileName) {
+    std::ofstream file(fileName);  // Open the file
+
+    // Check if the file is open
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for window output." << std::endl;
+        return;
+    }
+    printWindowsToJSON(file);
+    file.close();
+    std::cout << "Profiler windows written to " << fileName << " in JSON format.\n";
+}
+
+// CollectLocks: Reads every thread's lock totals under threadsMutex (they keep changing, each number is as of its
+// own read) and merges them per lock, most wait time first
+void Profiler::CollectLocks(std::vector<std::pair<int, ProfilerLockStats>>& threadLocks, std::vector<ProfilerLockStats>& merged) {
+    int lockCount = ProfilerSectionRegistry::GetInstance()->GetLockCount();
+    for (int lockId = 0; lockId < lockCount; lockId++) {
+        merged.emplace_back(lockId);
+    }
+
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        ProfilerLockTotals* table = buffer->lockTotals.load(std::memory_order_acquire);
+        if (table == nullptr) {
+            continue;
+        }
+        for (int lockId = 0; lockId < lockCount; lockId++) {
+            const ProfilerLockTotals& totals = table[lockId];
+            if (totals.acquisitions.load(std::memory_order_relaxed) == 0 && totals.contentions.load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+            ProfilerLockStats stat(lockId);
+            stat.acquisitions = totals.acquisitions.load(std::memory_order_relaxed);
+            stat.sharedAcquisitions = totals.sharedAcquisitions.load(std::memory_order_relaxed);
+            stat.contentions = totals.contentions.load(std::memory_order_relaxed);
+            stat.waitTicks = totals.waitTicks.load(std::memory_order_relaxed);
+            stat.maxWaitTicks = totals.maxWaitTicks.load(std::memory_order_relaxed);
+            stat.holdTicks = totals.holdTicks.load(std::memory_order_relaxed);
+            stat.maxHoldTicks = totals.maxHoldTicks.load(std::memory_order_relaxed);
+
+            for (int slot = 0; slot < kLockBlockerSlots; slot++) {
+                int sectionId = totals.blockerSections[slot].load(std::memory_order_relaxed);
+                if (sectionId != kFreeBlockerSlot) {
+                    stat.blockers[stat.blockerCount++] = ProfilerLockBlocker{ sectionId, totals.blockerWaitTicks[slot].load(std::memory_order_relaxed), 0.0 };
+                }
+            }
+            std::sort(stat.blockers, stat.blockers + stat.blockerCount, [](const ProfilerLockBlocker& x, const ProfilerLockBlocker& y) {
+                return x.waitTicks > y.waitTicks;
+            });
+
+            merged[lockId].Merge(stat);
+            stat.ConvertTicksToSeconds();
+            threadLocks.emplace_back(buffer->threadId, stat);
+        }
+    }
+
+    for (ProfilerLockStats& stat : merged) {
+        stat.ConvertTicksToSeconds();
+    }
+    merged.erase(std::remove_if(merged.begin(), merged.end(), [](const ProfilerLockStats& stat) {
+        return stat.acquisitions == 0 && stat.contentions == 0;
+    }), merged.end());
+    std::stable_sort(merged.begin(), merged.end(), [](const ProfilerLockStats& a, const ProfilerLockStats& b) {
+        return a.waitTicks > b.waitTicks;
+    });
+}
+
+// printLocksToCSV: One row per lock merged across threads, ranked by wait time, then the per-thread rows
+void Profiler::printLocksToCSV(const char* fileName) {
+    std::ofstream file(fileName);  // Open the file
+
+    // Check if the file is open
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for lock CSV output." << std::endl;
+        return;
+    }
+
+    std::vector<std::pair<int, ProfilerLockStats>> threadLocks;
+    std::vector<ProfilerLockStats> merged;
+    CollectLocks(threadLocks, merged);
+    writeLocksCSVHeader(file);
+    for (const ProfilerLockStats& stat : merged) {
+        writeLockCSVRow(file, "all", stat);
+    }
+    for (const std::pair<int, ProfilerLockStats>& threadLock : threadLocks) {
+        writeLockCSVRow(file, std::to_string(threadLock.first), threadLock.second);
+    }
+
+    file.close();
+    std::cout << "Profiler lock stats written to " << fileName << " in CSV format.\n";
+}
+
+// printLocksToJSON: The same rows as printLocksToCSV, as an array of objects like printStatsToJSON
+void Profiler::printLocksToJSON(std::ostream& file) {
+    std::vector<std::pair<int, ProfilerLockStats>> threadLocks;
+    std::vector<ProfilerLockStats> merged;
+    CollectLocks(threadLocks, merged);
+    file << "[\n";
+    bool first = true;
+    for (const ProfilerLockStats& stat : merged) {
+        if (!first) {
+            file << ",\n";
+        }
+        first = false;
+        writeLockJSONObject(file, "all", stat);
+    }
+    for (const std::pair<int, ProfilerLockStats>& threadLock : threadLocks) {
+        if (!first) {
+            file << ",\n";
+        }
+        first = false;
+        writeLockJSONObject(file, std::to_string(threadLock.first), threadLock.second);
+    }
+    file << "\n]\n";
+}
+void Profiler::printLocksToJSON(const char* fileName) {
+    std::ofstream file(fileName);  // Open the file
+
+    // Check if the file is open
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for lock JSON output." << std::endl;
+        return;
+    }
+    printLocksToJSON(file);
+    file.close();
+    std::cout << "Profiler lock stats written to " << fileName << " in JSON format.\n";
+}
+
+// SaveBaseline: Writes the run so far to a new binary profile in the directory (created if missing), named
+// after the run ID and git commit so the newest baseline sorts last. Returns the file name, or "" on failure.
+std::string Profiler::SaveBaseline(const char* directory) {
+    std::vector<std::pair<std::string, std::string>> metadata = collectRunMetadata();
+    std::string commit = getRunMetadataValue(metadata, "Git Commit");
+    for (char& c : commit) {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '.') {
+            c = '_';
         }
+    }
+    std::string fileName = std::string(directory) + "/baseline-" + getRunMetadataValue(metadata, "Run ID") + "-" + commit + ".prof";
+
+#if defined(_WIN32)
+    _mkdir(directory);
+#else
+    mkdir(directory, 0755);  // Fails harmlessly if it already exists
+#endif
+    std::lock_guard<std::mutex> lock(binaryMutex);
+    ProfilerBinaryWriter writer;
+    if (!writer.Open(fileName.c_str())) {
+        std::cerr << "Failed to open file for baseline output." << std::endl;
+        return "";
+    }
+    writer.WriteMetadata(metadata);
+    WriteBinarySnapshotLocked(&writer);
+    writer.Close();
+    std::cout << "Profiler baseline saved to " << fileName << ".\n";
+    return fileName;
+}
+
+// calibrateOverhead: Times batches of empty enter/exit pairs through the real recording path on this thread.
+// The events are popped straight back out of the buffer, so the calibration never shows up in the stats.
+void Profiler::calibrateOverhead() {
+    int sectionId = ProfilerSectionRegistry::GetInstance()->Intern("Profiler: Overhead Calibration");
+    ProfilerThreadBuffer* buffer = GetThreadBuffer();
+
+    // The calibration pairs are moved to a scratch buffer so the cost of draining them can be measured
+    // too. It has to exist before any pair is recorded; without it (or a buffer for this thread) the
+    // overhead stays as it was.
+    std::unique_ptr<ProfilerThreadBuffer> scratch;
+    try {
+        scratch.reset(new ProfilerThreadBuffer(-1, kThreadBufferCapacity));
+        scratch->AllocateCounterSamples();
+    } catch (const std::bad_alloc&) {
+        warnMemoryBudgetExhausted();
+        return;
+    }
+    if (buffer == nullptr) {
+        return;
+    }
+
+    // When recalibrating, the ring must hold nothing but the calibration pairs. The drain flag stays held
+    // until they are popped back out, so the collector (a /stats poll, the window, flush or shared stats
+    // threads) can't drain them in between; every pair fits in the ring, so recording never needs to drain.
+    static_assert(2 * kCalibrationBatches * kCalibrationPairsPerBatch <= kThreadBufferCapacity, "Calibration pairs must fit in one thread buffer");
+    buffer->LockDrain();
+    DrainBuffer(buffer);
 
-        // Retrieve the stats for the section
-        ProfilerStats* sectionStats = stats[sectionName];
+    // Use the fastest batch, anything slower was interrupted by something other than the profiler
+    double bestPairTicks = std::numeric_limits<double>::max();
+    for (int batch = 0; batch < kCalibrationBatches; batch++) {
+        ProfilerTicks batchStart = GetCurrentTicks();
+        for (int i = 0; i < kCalibrationPairsPerBatch; i++) {
+            EnterSection(sectionId);
+            ExitSection(sectionId, 0, "null", "null");
+        }
+        ProfilerTicks batchStop = GetCurrentTicks();
+        bestPairTicks = std::min(bestPairTicks, static_cast<double>(batchStop - batchStart) / kCalibrationPairsPerBatch);
+    }
 
-        // Update stats for the section
-        sectionStats->count++;
-        sectionStats->totalTime += elapsed.elapsedTime;
-        sectionStats->minTime = std::min(sectionStats->minTime, elapsed.elapsedTime);
-        sectionStats->maxTime = std::max(sectionStats->maxTime, elapsed.elapsedTime);
-        sectionStats->avgTime = sectionStats->totalTime / sectionStats->count;
+    // The part of each pair inside the section is the gap between its enter and exit timestamps
+    double bestInnerTicks = std::numeric_limits<double>::max();
+    ProfilerEvent enter;
+    ProfilerEvent exit;
+    ProfilerCounterSample enterCounters;
+    ProfilerCounterSample exitCounters;
+    for (int batch = 0; batch < kCalibrationBatches; batch++) {
+        ProfilerTicks batchInner = 0;
+        for (int i = 0; i < kCalibrationPairsPerBatch; i++) {
+            if (!buffer->Pop(enter, enterCounters) || !buffer->Pop(exit, exitCounters)) {
+                // Something else took events out of the ring; keep the overhead as it was
+                buffer->UnlockDrain();
+                return;
+            }
+            batchInner += exit.ticks - enter.ticks;
+            scratch->Push(enter, enterCounters);
+            scratch->Push(exit, exitCounters);
+        }
+        bestInnerTicks = std::min(bestInnerTicks, static_cast<double>(batchInner) / kCalibrationPairsPerBatch);
+    }
+    buffer->UnlockDrain();
 
-        // Update file name, function name, and line number (optional)
-        sectionStats->fileName = elapsed.fileName;
-        sectionStats->functionName = elapsed.functionName;
-        sectionStats->lineNumber = elapsed.lineNumber;
+    // Draining happens inline on the recording thread whenever its ring fills, so it is part of the
+    // per-pair cost seen by the enclosing sections, spread over every pair
+    ProfilerTicks drainStart = GetCurrentTicks();
+    DrainBuffer(scratch.get());
+    ProfilerTicks drainStop = GetCurrentTicks();
+    double drainTicks = static_cast<double>(drainStop - drainStart) / (kCalibrationBatches * kCalibrationPairsPerBatch);
+
+    innerOverheadTicks = bestInnerTicks;
+    pairOverheadTicks = std::max(bestPairTicks, bestInnerTicks) + drainTicks;
+}
+
+// GetDroppedEventCount: Events thrown away because the arena had no room to replay them
+unsigned long long Profiler::GetDroppedEventCount() {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    unsigned long long dropped = 0;
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        buffer->LockDrain();
+        dropped += buffer->droppedEvents;
+        buffer->UnlockDrain();
+    }
+    return dropped;
+}
+
+double Profiler::GetInnerOverheadSeconds() {
+    return TicksToSeconds(1) * innerOverheadTicks;
+}
+
+double Profiler::GetPairOverheadSeconds() {
+    return TicksToSeconds(1) * pairOverheadTicks;
+}
+
+// GetSectionCount: Looks a section up by its name's contents in the registry, then in the merged stats
+long long Profiler::GetSectionCount(const char* sectionName) {
+    int sectionId = ProfilerSectionRegistry::GetInstance()->Find(sectionName);
+    if (sectionId < 0 || sectionId >= static_cast<int>(stats.size())) {
+        return 0;
+    }
+    return stats[sectionId].count;
+}
+
+// printStatOutput: Outputs one section's statistics to the console
+static void printStatOutput(const ProfilerStats* stat, const char* indent) {
+    std::cout << indent << "Section Name: " << stat->sectionName << "\n";
+    std::cout << indent << "  Call Count: " << stat->count << "\n";
+    std::cout << indent << "  Total Time: " << stat->totalTime << " seconds\n";
+    std::cout << indent << "  Min Time: " << stat->minTime << " seconds\n";
+    std::cout << indent << "  Max Time: " << stat->maxTime << " seconds\n";
+    std::cout << indent << "  Avg Time: " << stat->avgTime << " seconds\n";
+    std::cout << indent << "  Self Time: " << stat->selfTime << " seconds\n";
+    std::cout << indent << "  Compensated Total Time: " << stat->compensatedTotalTime << " seconds\n";
+    std::cout << indent << "  Compensated Avg Time: " << stat->compensatedAvgTime << " seconds\n";
+    std::cout << indent << "  Compensated Self Time: " << stat->compensatedSelfTime << " seconds\n";
+    std::cout << indent << "  P50 Time: " << stat->p50Time << " seconds\n";
+    std::cout << indent << "  P90 Time: " << stat->p90Time << " seconds\n";
+    std::cout << indent << "  P99 Time: " << stat->p99Time << " seconds\n";
+    std::cout << indent << "  P99.9 Time: " << stat->p999Time << " seconds\n";
+    if (stat->sampleEvery > 1) {
+        std::cout << indent << "  Sampled: 1 in " << stat->sampleEvery << " calls recorded\n";
+    }
+    if (stat->counterCalls > 0) {
+        for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+            if (stat->counterMask & (1u << event)) {
+                std::cout << indent << "  " << GetCounterEventName(static_cast<ProfilerCounterEvent>(event)) << ": " << stat->counterTotals[event] << "\n";
+            }
+        }
+        std::cout << indent << "  IPC: " << stat->instructionsPerCycle << ", Cache Miss Rate: " << stat->cacheMissRate
+                  << ", Branch Miss Rate: " << stat->branchMissRate << " (over " << stat->counterCalls << " calls)\n";
     }
+    if (stat->allocationCount > 0 || stat->freedBytes > 0) {
+        std::cout << indent << "  Allocations: " << stat->allocationCount << " (" << stat->allocatedBytes << " bytes, "
+                  << stat->freedBytes << " bytes freed, peak live " << stat->peakLiveBytes << " bytes)\n";
+    }
+    if (stat->asyncCount > 0) {
+        std::cout << indent << "  Async Spans: " << stat->asyncCount << " (" << stat->handOffCount << " hand-offs, "
+                  << stat->queueTime << " seconds queued, " << stat->avgQueueTime << " seconds avg, " << stat->maxQueueTime << " seconds max)\n";
+    }
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    for (int metric = 0; metric < registry->GetMetricCount(); metric++) {
+        if (stat->metricMask & (1u << metric)) {
+            std::cout << indent << "  " << registry->GetMetricName(metric) << ": " << stat->metricTotals[metric] << " ("
+                      << stat->metricRates[metric] << " per second, " << stat->metricSecondsPerUnit[metric] << " seconds each)\n";
+        }
+    }
+    std::cout << indent << "  File Name: " << stat->fileName << "\n";
+    std::cout << indent << "  Function Name: " << stat->functionName << "\n";
+    std::cout << indent << "  Line Number: " << stat->lineNumber << "\n";
+    std::cout << "\n";
 }
 
-// printStats: Outputs the profiling statistics to the console
+// printStats: Outputs the profiling statistics to the console, followed by a breakdown per thread
 void Profiler::printStats() {
-    // Iterate through the map of stats and output the details
-    for (const auto& entry : stats) {
-        ProfilerStats* stat = entry.second;
-        std::cout << "Section Name: " << stat->sectionName << "\n";
-        std::cout << "  Call Count: " << stat->count << "\n";
-        std::cout << "  Total Time: " << stat->totalTime << " seconds\n";
-        std::cout << "  Min Time: " << stat->minTime << " seconds\n";
-        std::cout << "  Max Time: " << stat->maxTime << " seconds\n";
-        std::cout << "  Avg Time: " << stat->avgTime << " seconds\n";
-        std::cout << "  File Name: " << stat->fileName << "\n";
-        std::cout << "  Function Name: " << stat->functionName << "\n";
-        std::cout << "  Line Number: " << stat->lineNumber << "\n";
-        std::cout << "\n";
+    std::cout << "Profiler overhead: " << GetPairOverheadSeconds() << " seconds per section, "
+              << GetInnerOverheadSeconds() << " seconds of it inside the section\n\n";
+    unsigned long long droppedEvents = GetDroppedEventCount();
+    if (droppedEvents > 0) {
+        std::cout << "Profiler memory budget exhausted: " << droppedEvents << " events dropped, the stats below are incomplete\n\n";
+    }
+
+    // Iterate through the stats and output the details of every section that was recorded
+    for (const ProfilerStats& stat : stats) {
+        if (stat.HasData()) {
+            printStatOutput(&stat, "");
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        buffer->LockDrain();
+        std::cout << "Thread " << buffer->threadId << ":\n";
+        for (const ProfilerStats& stat : buffer->stats) {
+            if (stat.HasData()) {
+                printStatOutput(&stat, "  ");
+            }
+        }
+        buffer->UnlockDrain();
+    }
+}
+
+// printCallTreeNode: Outputs one call-tree node and, indented beneath it, all of its children
+static void printCallTreeNode(const ProfilerVector<ProfilerCallNode>& tree, int nodeIndex) {
+    const ProfilerCallNode& node = tree[nodeIndex];
+    if (nodeIndex != 0) {
+        std::cout << std::string(2 * (node.depth - 1), ' ') << ProfilerSectionRegistry::GetInstance()->GetName(node.sectionId)
+                  << "  calls: " << node.count
+                  << "  inclusive: " << TicksToSeconds(node.inclusiveTicks) << " seconds"
+                  << "  self: " << TicksToSeconds(node.selfTicks) << " seconds"
+                  << "  compensated inclusive: " << TicksToSeconds(node.compensatedInclusiveTicks) << " seconds"
+                  << "  compensated self: " << TicksToSeconds(node.compensatedSelfTicks) << " seconds\n";
+    }
+    for (int childIndex : node.children) {
+        printCallTreeNode(tree, childIndex);
     }
 }
+
+// printCallTree: Outputs the merged call tree to the console, followed by each thread's own tree
+void Profiler::printCallTree() {
+    printCallTreeNode(callTree, 0);
+
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        buffer->LockDrain();
+        std::cout << "Thread " << buffer->threadId << ":\n";
+        printCallTreeNode(buffer->callTree, 0);
+        buffer->UnlockDrain();
+    }
+}
+
+// printCallTreeToCSV: Writes the call tree to a CSV file (Parent ID 0 means a top-level section)
+void Profiler::printCallTreeToCSV(const char* fileName) {
+    std::ofstream file(fileName);  // Open the file
+
+    // Check if the file is open
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for call tree CSV output." << std::endl;
+        return;
+    }
+
+    writeCallTreeCSVHeader(file);
+    writeCallTreeCSVRows(file, "all", callTree, TicksToSeconds(1));
+
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (ProfilerThreadBuffer* buffer : threadBuffers) {
+        buffer->LockDrain();
+        writeCallTreeCSVRows(file, std::to_string(buffer->threadId), buffer->callTree, TicksToSeconds(1));
+        buffer->UnlockDrain();
+    }
+
+    file.close();
+    std::cout << "Profiler call tree written to " << fileName << " in CSV format.\n";
+}
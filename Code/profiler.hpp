@@ -5,21 +5,186 @@
 #include <iostream>
 #include <iomanip> // For formatting the output
 #include <fstream>
+#include <string>
 #include <limits>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "registry.hpp"
+#include "time.hpp"
+#include "trace.hpp"
+#include "histogram.hpp"
+#include "counters.hpp"
+#include "allocations.hpp"
+#include "locks.hpp"
+#include "arena.hpp"
 
 
-// Macros for entering and exiting profiling sections
-#define PROFILER_ENTER(sectionName) Profiler::GetInstance()->EnterSection(sectionName);
-#define PROFILER_EXIT(sectionName) Profiler::GetInstance()->ExitSection(sectionName, __LINE__, __FILE__, __FUNCTION__);
+// Compile-time profiling level. Sections are tagged 1 (coarse, whole algorithms), 2 (loops and phases)
+// or 3 (fine-grained, per iteration); anything tagged above PROFILER_LEVEL compiles to nothing, and
+// PROFILER_LEVEL 0 removes all instrumentation. Build with e.g. -DPROFILER_LEVEL=1 (see the makefile).
+#ifndef PROFILER_LEVEL
+#define PROFILER_LEVEL 3
+#endif
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+// Macros that always record, used by the level-tagged macros below. Each call site interns its section
+// name once into a function-local static, so later calls go straight to the section's ID.
+#define PROFILER_ENTER_ALWAYS(sectionName) { static const int profilerSectionId = ProfilerSectionRegistry::GetInstance()->Intern(sectionName); Profiler::GetInstance()->EnterSection(profilerSectionId); }
+#define PROFILER_EXIT_ALWAYS(sectionName) { static const int profilerSectionId = ProfilerSectionRegistry::GetInstance()->Intern(sectionName); Profiler::GetInstance()->ExitSection(profilerSectionId, __LINE__, __FILE__, __FUNCTION__); }
+
+// Profiles the rest of the enclosing scope. The call site, including its interned section ID, is
+// resolved once into a function-local static and every later call just passes a pointer to it.
+#define PROFILE_SCOPE_ALWAYS(sectionName) \
+    static const ProfilerSectionSite PROFILER_CONCAT(profilerSite_, __LINE__) = { ProfilerSectionRegistry::GetInstance()->Intern(sectionName), sectionName, __FILE__, __func__, __LINE__ }; \
+    ProfilerScopeObject PROFILER_CONCAT(profilerScope_, __LINE__)(&PROFILER_CONCAT(profilerSite_, __LINE__));
+
+// Records only every sampleEvery-th call of the section on each thread, for very hot inner sections
+#define PROFILER_ENTER_SAMPLED_ALWAYS(sectionName, sampleEvery) { static const int profilerSectionId = ProfilerSectionRegistry::GetInstance()->InternSampled(sectionName, sampleEvery); Profiler::GetInstance()->EnterSectionSampled(profilerSectionId); }
+#define PROFILER_EXIT_SAMPLED_ALWAYS(sectionName) { static const int profilerSectionId = ProfilerSectionRegistry::GetInstance()->Intern(sectionName); Profiler::GetInstance()->ExitSectionSampled(profilerSectionId, __LINE__, __FILE__, __FUNCTION__); }
+
+// Adds amount to a custom counter of a section on the calling thread, e.g. PROFILER_COUNT("Element Shifting", "moves", n).
+// Counts are reported next to the section's times, with the rate per second and time per unit derived from them.
+#define PROFILER_COUNT_ALWAYS(sectionName, metricName, amount) { static const int profilerSectionId = ProfilerSectionRegistry::GetInstance()->Intern(sectionName); static const int profilerMetricId = ProfilerSectionRegistry::GetInstance()->InternMetric(metricName); Profiler::GetInstance()->AddToMetric(profilerSectionId, profilerMetricId, amount); }
+
+// Begins an async span of the section into a ProfilerAsyncSpan, e.g. PROFILER_ASYNC_BEGIN(request.span, "Request"),
+// which any thread holding the span later hands off, resumes and ends (see the macros after the levels)
+#define PROFILER_ASYNC_BEGIN_ALWAYS(span, sectionName) { static const int profilerSectionId = ProfilerSectionRegistry::GetInstance()->Intern(sectionName); (span) = Profiler::GetInstance()->BeginAsyncSpan(profilerSectionId); }
+
+#if PROFILER_LEVEL >= 1
+#define PROFILER_ENTER_L1(sectionName) PROFILER_ENTER_ALWAYS(sectionName)
+#define PROFILER_EXIT_L1(sectionName) PROFILER_EXIT_ALWAYS(sectionName)
+#define PROFILE_SCOPE_L1(sectionName) PROFILE_SCOPE_ALWAYS(sectionName)
+#define PROFILER_COUNT_L1(sectionName, metricName, amount) PROFILER_COUNT_ALWAYS(sectionName, metricName, amount)
+#define PROFILER_ASYNC_BEGIN_L1(span, sectionName) PROFILER_ASYNC_BEGIN_ALWAYS(span, sectionName)
+#else
+#define PROFILER_ENTER_L1(sectionName) { }
+#define PROFILER_EXIT_L1(sectionName) { }
+#define PROFILE_SCOPE_L1(sectionName)
+#define PROFILER_COUNT_L1(sectionName, metricName, amount) { }
+#define PROFILER_ASYNC_BEGIN_L1(span, sectionName) { }
+#endif
+
+#if PROFILER_LEVEL >= 2
+#define PROFILER_ENTER_L2(sectionName) PROFILER_ENTER_ALWAYS(sectionName)
+#define PROFILER_EXIT_L2(sectionName) PROFILER_EXIT_ALWAYS(sectionName)
+#define PROFILE_SCOPE_L2(sectionName) PROFILE_SCOPE_ALWAYS(sectionName)
+#define PROFILER_COUNT_L2(sectionName, metricName, amount) PROFILER_COUNT_ALWAYS(sectionName, metricName, amount)
+#define PROFILER_ASYNC_BEGIN_L2(span, sectionName) PROFILER_ASYNC_BEGIN_ALWAYS(span, sectionName)
+#else
+#define PROFILER_ENTER_L2(sectionName) { }
+#define PROFILER_EXIT_L2(sectionName) { }
+#define PROFILE_SCOPE_L2(sectionName)
+#define PROFILER_COUNT_L2(sectionName, metricName, amount) { }
+#define PROFILER_ASYNC_BEGIN_L2(span, sectionName) { }
+#endif
+
+#if PROFILER_LEVEL >= 3
+#define PROFILER_ENTER_L3(sectionName) PROFILER_ENTER_ALWAYS(sectionName)
+#define PROFILER_EXIT_L3(sectionName) PROFILER_EXIT_ALWAYS(sectionName)
+#define PROFILE_SCOPE_L3(sectionName) PROFILE_SCOPE_ALWAYS(sectionName)
+#define PROFILER_ENTER_SAMPLED(sectionName, sampleEvery) PROFILER_ENTER_SAMPLED_ALWAYS(sectionName, sampleEvery)
+#define PROFILER_EXIT_SAMPLED(sectionName) PROFILER_EXIT_SAMPLED_ALWAYS(sectionName)
+#define PROFILER_COUNT_L3(sectionName, metricName, amount) PROFILER_COUNT_ALWAYS(sectionName, metricName, amount)
+#define PROFILER_ASYNC_BEGIN_L3(span, sectionName) PROFILER_ASYNC_BEGIN_ALWAYS(span, sectionName)
+#else
+#define PROFILER_ENTER_L3(sectionName) { }
+#define PROFILER_EXIT_L3(sectionName) { }
+#define PROFILE_SCOPE_L3(sectionName)
+#define PROFILER_ENTER_SAMPLED(sectionName, sampleEvery) { }
+#define PROFILER_EXIT_SAMPLED(sectionName) { }
+#define PROFILER_COUNT_L3(sectionName, metricName, amount) { }
+#define PROFILER_ASYNC_BEGIN_L3(span, sectionName) { }
+#endif
+
+// Level-tagged macros, the level must be a literal 1, 2 or 3
+#define PROFILER_ENTER_LEVEL(level, sectionName) PROFILER_CONCAT(PROFILER_ENTER_L, level)(sectionName)
+#define PROFILER_EXIT_LEVEL(level, sectionName) PROFILER_CONCAT(PROFILER_EXIT_L, level)(sectionName)
+#define PROFILE_SCOPE_LEVEL(level, sectionName) PROFILER_CONCAT(PROFILE_SCOPE_L, level)(sectionName)
+#define PROFILER_COUNT_LEVEL(level, sectionName, metricName, amount) PROFILER_CONCAT(PROFILER_COUNT_L, level)(sectionName, metricName, amount)
+#define PROFILER_ASYNC_BEGIN_LEVEL(level, span, sectionName) PROFILER_CONCAT(PROFILER_ASYNC_BEGIN_L, level)(span, sectionName)
+
+// Macros for entering and exiting profiling sections, untagged sections are level 1
+#define PROFILER_ENTER(sectionName) PROFILER_ENTER_L1(sectionName)
+#define PROFILER_EXIT(sectionName) PROFILER_EXIT_L1(sectionName)
+#define PROFILE_SCOPE(sectionName) PROFILE_SCOPE_L1(sectionName)
+#define PROFILER_COUNT(sectionName, metricName, amount) PROFILER_COUNT_L1(sectionName, metricName, amount)
+#define PROFILER_ASYNC_BEGIN(span, sectionName) PROFILER_ASYNC_BEGIN_L1(span, sectionName)
+
+// The rest of an async span's life. They aren't tagged with a level: a span whose begin was compiled out is
+// never open, and every step on a span that isn't open does nothing.
+#if PROFILER_LEVEL >= 1
+#define PROFILER_ASYNC_HAND_OFF(span) { (span).HandOff(); }
+#define PROFILER_ASYNC_RESUME(span) { (span).Resume(); }
+#define PROFILER_ASYNC_END(span) { (span).End(__LINE__, __FILE__, __FUNCTION__); }
+#else
+#define PROFILER_ASYNC_HAND_OFF(span) { }
+#define PROFILER_ASYNC_RESUME(span) { }
+#define PROFILER_ASYNC_END(span) { }
+#endif
 
 using namespace std;
 
+class Profiler;
+class ProfilerBinaryWriter;
+class ProfilerSharedWriter;
+
+// ProfilerSectionSite struct: Where a scoped section lives in the source, captured once per call site
+struct ProfilerSectionSite {
+    int sectionId;
+    char const* sectionName;
+    const char* fileName;
+    const char* functionName;
+    int lineNumber;
+};
+
 // ProfilerScopeObject class: Used for automatically starting and stopping profiling when an object goes in and out of scope
 class ProfilerScopeObject {
     public:
         ProfilerScopeObject(char const* sectionName);
+        ProfilerScopeObject(const ProfilerSectionSite* site);
         ~ProfilerScopeObject();
-        char const* sectionName;
+
+        // Copying would exit the section twice
+        ProfilerScopeObject(const ProfilerScopeObject&) = delete;
+        ProfilerScopeObject& operator=(const ProfilerScopeObject&) = delete;
+
+        int sectionId;
+        const ProfilerSectionSite* site;  // nullptr when constructed from a bare name
+        Profiler* profiler;  // Looked up once on entry and reused on exit
+};
+
+// ProfilerAsyncSpan class: One run of a section that may begin on one thread and end on another. The handle
+// is moved (never copied) between threads, pools or coroutine frames, and whichever thread holds it last ends
+// it. The time between each HandOff and the Resume after it is the span's queueing delay.
+class ProfilerAsyncSpan {
+    public:
+        ProfilerAsyncSpan();   // Not open, every step on it does nothing
+        ~ProfilerAsyncSpan();  // Ends the span if it is still open
+
+        ProfilerAsyncSpan(ProfilerAsyncSpan&& other) noexcept;
+        ProfilerAsyncSpan& operator=(ProfilerAsyncSpan&& other) noexcept;  // Ends this span first if it is open
+
+        // Copying would end the span twice
+        ProfilerAsyncSpan(const ProfilerAsyncSpan&) = delete;
+        ProfilerAsyncSpan& operator=(const ProfilerAsyncSpan&) = delete;
+
+        bool IsOpen() const;
+        void HandOff();  // About to be queued for another thread; ignored if a hand-off is already pending
+        void Resume();   // Picked up after a HandOff; ignored if none is pending
+        void End();
+        void End(int lineNumber, const char* fileName, const char* functionName);
+
+        int sectionId;               // -1 unless open
+        unsigned long long spanId;   // Unique within the Profiler, ties the span's steps together in the trace
+        ProfilerTicks startTicks;
+        ProfilerTicks handOffTicks;  // When the pending hand-off started, 0 if there is none
+        ProfilerTicks queueTicks;    // Every finished hand-off's wait so far
+        ProfilerTicks maxQueueTicks;
+        int handOffCount;
 };
 
 // TimeRecordStart class: Holds the start time of a section
@@ -50,18 +215,254 @@ class ProfilerStats {
         ProfilerStats(char const* sectionName);
         ~ProfilerStats();
 
+        // Converts the raw tick totals into the seconds fields below (done at report time), with the
+        // active clock or with the tick length of the clock the stats were recorded with
+        void ConvertTicksToSeconds();
+        void ConvertTicksToSeconds(double secondsPerTick);
+
+        void Merge(const ProfilerStats& source);
+
+        // Whether there is anything to merge or report: calls, or allocation totals alone (a thread that frees
+        // blocks another thread allocated is credited for them under the allocating section, which it may never enter)
+        bool HasData() const;
+
         char const* sectionName;
         int count;
+        int outermostCount;  // Calls not nested in a call of the same section, the ones the totals add up
+        ProfilerTicks totalTicks;
+        ProfilerTicks minTicks;
+        ProfilerTicks maxTicks;
+        ProfilerTicks selfTicks;
+        ProfilerTicks compensatedTotalTicks;  // Same as totalTicks/selfTicks with the profiler's own overhead removed
+        ProfilerTicks compensatedSelfTicks;
+        ProfilerHistogram histogram;  // Every call's inclusive time, for percentiles
+
         double totalTime;
         double minTime;
         double maxTime;
         double avgTime;
+        double selfTime;  // Total time minus time spent in profiled child sections
+        double compensatedTotalTime;
+        double compensatedAvgTime;
+        double compensatedSelfTime;
+        double p50Time;
+        double p90Time;
+        double p99Time;
+        double p999Time;
+        int sampleEvery;  // 1 unless the section is sampled, then only one call in this many is in the stats
+
+        // Hardware counters (Profiler::EnableCounters), summed like totalTicks over the calls that had them
+        int counterCalls;
+        unsigned counterMask;  // Bit per ProfilerCounterEvent with a total below
+        unsigned long long counterTotals[COUNTER_EVENT_COUNT];
+        double instructionsPerCycle;  // Derived by ConvertTicksToSeconds, 0 when the events weren't counted
+        double cacheMissRate;         // Cache misses per cache reference
+        double branchMissRate;        // Branch misses per branch
+
+        // Heap use charged to this section itself, not its profiled children (Profiler::EnableAllocationTracking)
+        long long allocationCount;
+        long long allocatedBytes;
+        long long freedBytes;
+        long long peakLiveBytes;  // Highest allocated-minus-freed seen on any one thread
+
+        // Async spans (ProfilerAsyncSpan) among the calls, and the queueing delay of their hand-offs between threads
+        long long asyncCount;
+        long long handOffCount;
+        ProfilerTicks queueTicks;
+        ProfilerTicks maxQueueTicks;  // Longest single hand-off
+        double queueTime;
+        double avgQueueTime;          // Per hand-off
+        double maxQueueTime;
+
+        // Custom counters (PROFILER_COUNT), indexed by the registry's metric IDs. The rate and time per unit are
+        // derived by ConvertTicksToSeconds from the section's total time, scaled up for sampled sections.
+        unsigned metricMask;  // Bit per metric counted in this section
+        long long metricTotals[ProfilerSectionRegistry::kMaxMetrics];
+        double metricRates[ProfilerSectionRegistry::kMaxMetrics];         // Units per second
+        double metricSecondsPerUnit[ProfilerSectionRegistry::kMaxMetrics];
 
         const char* fileName;
         const char* functionName;
         int lineNumber;
 };
 
+// ProfilerEvent struct: A single enter or exit record written by a thread into its own ring buffer
+struct ProfilerEvent {
+    int sectionId;
+    ProfilerTicks ticks;
+    int lineNumber;
+    const char* fileName;
+    const char* functionName;
+    bool isEnter;
+    bool hasCounters;  // A counter sample sits in the ring's parallel sample slot
+};
+
+// ProfilerFrame struct: One active (entered but not yet exited) section on a thread's call stack
+struct ProfilerFrame {
+    int sectionId;
+    ProfilerTicks ticksAtStart;
+    ProfilerTicks childTicks;  // Inclusive time of children that already exited, subtracted to get self time
+    ProfilerTicks childCompensatedTicks;  // The same with profiler overhead removed
+    int descendantCount;  // Profiled sections entered and exited inside this one, at any depth
+    int nodeIndex;     // Call-tree node this activation is counted against
+    ProfilerCounterSample countersAtStart;  // mask is 0 if the enter had no counters
+};
+
+// ProfilerSectionTiming struct: Everything measured for one exited section, raw and overhead compensated
+struct ProfilerSectionTiming {
+    ProfilerTicks elapsedTicks;
+    ProfilerTicks selfTicks;
+    ProfilerTicks compensatedTicks;
+    ProfilerTicks compensatedSelfTicks;
+    ProfilerCounterSample counterDeltas;  // Counts between enter and exit, mask 0 if either had no counters
+};
+
+// ProfilerCallNode class: A section reached through one particular chain of parent sections
+class ProfilerCallNode {
+    public:
+        ProfilerCallNode(int sectionId, int parentIndex, int depth);
+        ~ProfilerCallNode();
+
+        int sectionId;
+        int parentIndex;  // -1 for the root node
+        int depth;
+        int count;
+        ProfilerTicks inclusiveTicks;
+        ProfilerTicks selfTicks;
+        ProfilerTicks compensatedInclusiveTicks;
+        ProfilerTicks compensatedSelfTicks;
+        ProfilerVector<int> children;  // Indices into the owning call tree
+};
+
+// mergeCallTree: Adds the subtree rooted at sourceIndex onto the node at targetIndex, matching children by section
+void mergeCallTree(ProfilerVector<ProfilerCallNode>& target, int targetIndex, const ProfilerVector<ProfilerCallNode>& source, int sourceIndex);
+
+// ProfilerWindowStats class: Stats for one window, kept only for the sections called in it (a ProfilerStats
+// is several KB with its histogram, and most sections don't run in every window), in order of first call
+class ProfilerWindowStats {
+    public:
+        ProfilerWindowStats();
+
+        // The section's entry, added on its first call in the window; throws std::bad_alloc over the budget
+        ProfilerStats& StatsFor(int sectionId);
+        void Clear();  // Empties the window, keeping the storage for the next one
+        void Drop();   // Empties the window and releases its storage, after the budget ran out
+
+        ProfilerVector<ProfilerStats> stats;
+        ProfilerVector<int> sectionIds;  // The section of each entry in stats
+        bool dropped;  // Drop was called since the last Clear; nothing more is recorded into this window
+
+    private:
+        ProfilerVector<int> positions;  // Indexed by section ID, where its entry is in stats (-1 if it has none)
+};
+
+// ProfilerWindowSection struct: One section's timing summary in a published window, without the histogram
+// it was computed from, so a long history stays small
+struct ProfilerWindowSection {
+    char const* sectionName;
+    int count;
+    double totalTime;
+    double avgTime;
+    double minTime;
+    double maxTime;
+    double p50Time;
+    double p90Time;
+    double p99Time;
+};
+
+// ProfilerWindow struct: Every thread's stats for one interval of the run (see Profiler::EnableWindows),
+// merged per section and converted to seconds
+struct ProfilerWindow {
+    unsigned long long index = 0;  // Counts up from 0 each time windows are enabled
+    double startSeconds = 0.0;     // Since the Profiler was created
+    double endSeconds = 0.0;
+    bool incomplete = false;       // Some thread's stats for it didn't fit in the memory budget and were dropped
+    ProfilerVector<ProfilerWindowSection> sections;  // Only the sections called in the window, in order of first call
+};
+
+// ProfilerMetricTotals struct: One section's custom counters on one thread, written only by that thread
+struct ProfilerMetricTotals {
+    std::atomic<long long> values[ProfilerSectionRegistry::kMaxMetrics];
+};
+
+// ProfilerSamplingState struct: Per-thread, per-section state of a sampled section (owned by the recording thread)
+struct ProfilerSamplingState {
+    unsigned countdown;             // Calls left until the next one is recorded
+    unsigned long long sampledBits; // One bit per open activation, innermost lowest (recursion deeper than 64 loses track)
+};
+
+// ProfilerThreadBuffer class: Lock-free single-producer/single-consumer ring of events owned by one thread.
+// The owning thread is the only producer; whoever holds the drain flag (the owner when the ring is full,
+// or the collector in calculateStats) is the only consumer and the only one touching frameStack/callTree/stats.
+// The buffer and everything it holds live in the ProfilerArena; constructing one throws std::bad_alloc when
+// the arena's budget can't fit its ring.
+class ProfilerThreadBuffer {
+    public:
+        ProfilerThreadBuffer(int threadId, size_t capacity);
+        ~ProfilerThreadBuffer();
+
+        ProfilerThreadBuffer(const ProfilerThreadBuffer&) = delete;
+        ProfilerThreadBuffer& operator=(const ProfilerThreadBuffer&) = delete;
+
+        static void* operator new(size_t size);
+        static void operator delete(void* block, size_t size);
+
+        bool Push(const ProfilerEvent& event);  // Producer side, returns false when the ring is full
+        bool Pop(ProfilerEvent& event);         // Consumer side, returns false when the ring is empty
+
+        // The same with the event's counter sample, kept in a parallel ring allocated by AllocateCounterSamples
+        bool Push(const ProfilerEvent& event, const ProfilerCounterSample& counters);
+        bool Pop(ProfilerEvent& event, ProfilerCounterSample& counters);
+        void AllocateCounterSamples();  // Producer side, before the first event with counters (may throw std::bad_alloc)
+        size_t GetPushedCount() const;  // Producer side, every event pushed so far (draining doesn't lower it)
+
+        bool TryLockDrain();
+        void LockDrain();
+        void UnlockDrain();
+
+        int threadId;
+
+        // Producer-side state, only touched by the owning thread
+        ProfilerVector<ProfilerSamplingState> sampling;  // Indexed by section ID, grown the first time a sampled section is seen
+        ProfilerCounterGroup* counters;  // nullptr unless counters are enabled and could be opened on this thread
+        unsigned counterConfiguration;   // Profiler::counterConfiguration the counters were opened for
+
+        // Sections entered and not yet exited on this thread, innermost last, for the sampling profiler's
+        // signal handler (which runs on this thread, so only the depth needs to be atomic)
+        static const int kMaxActiveSections = 64;
+        int activeSections[kMaxActiveSections];
+        std::atomic<int> activeDepth;  // Keeps counting past kMaxActiveSections, the deepest ones just aren't stored
+
+        // Allocation counters indexed by section ID, taken from the arena by the allocation hooks on the thread's
+        // first tracked allocation (nullptr until then) and copied into stats by the collector
+        std::atomic<ProfilerAllocationCounters*> allocationCounters;
+
+        // Custom counter totals indexed by section ID, taken from the arena on the thread's first PROFILER_COUNT
+        // (nullptr until then) and copied into stats by the collector like the allocation counters
+        std::atomic<ProfilerMetricTotals*> metricTotals;
+
+        // Lock totals indexed by lock ID, taken from the arena on the thread's first profiled lock (nullptr until
+        // then) and read by the lock reports
+        std::atomic<ProfilerLockTotals*> lockTotals;
+
+        // Collector-side state, only valid while the drain flag is held
+        ProfilerTraceBuffer* trace;  // nullptr unless trace mode was enabled while this thread was recording
+        ProfilerVector<ProfilerFrame> frameStack;
+        ProfilerVector<ProfilerCallNode> callTree;  // Node 0 is the root, every top-level section hangs off it
+        ProfilerVector<ProfilerStats> stats;  // Indexed by section ID
+        ProfilerWindowStats windowStats;  // The same for the current window only, while windows are enabled
+        bool outOfMemory;  // The arena ran out while draining; from then on this thread's events are only counted
+        unsigned long long droppedEvents;
+
+    private:
+        ProfilerEvent* events;
+        ProfilerCounterSample* counterSamples;  // Same indices as events, nullptr until the thread first counts
+        size_t capacity;  // Always a power of two so indices can be masked
+        std::atomic<size_t> head;  // Next slot to write, only advanced by the producer
+        std::atomic<size_t> tail;  // Next slot to read, only advanced by the consumer
+        std::atomic_flag draining = ATOMIC_FLAG_INIT;
+};
+
 // Profiler class: Singleton pattern to manage profiling across the entire application
 class Profiler {
     public:
@@ -72,26 +473,218 @@ class Profiler {
         void ExitSection(char const* sectionName);
         void ExitSection(char const* sectionName, int lineNumber, const char* fileName, const char* functionName);
 
-        // Method to calculate statistics for all sections
+        // Same as above for a section already interned in the ProfilerSectionRegistry (what the macros use)
+        void EnterSection(int sectionId);
+        void ExitSection(int sectionId, int lineNumber, const char* fileName, const char* functionName);
+
+        // Sampled sections: only every Nth call per thread (N from ProfilerSectionRegistry::InternSampled) is recorded
+        void EnterSectionSampled(int sectionId);
+        void ExitSectionSampled(int sectionId, int lineNumber, const char* fileName, const char* functionName);
+
+        // Custom counters: adds amount to a section's counter on the calling thread (what PROFILER_COUNT uses).
+        // No event goes through the ring; the thread keeps running totals that calculateStats collects.
+        void AddToMetric(int sectionId, int metricId, long long amount);
+
+        // Async spans (what ProfilerAsyncSpan and the PROFILER_ASYNC macros use): a span is counted in its section's
+        // stats on the thread that ends it, for its whole time from begin to end including hand-offs, and in its
+        // histogram. It isn't on any thread's call stack, so it has no call-tree node and no profiled children.
+        // Ending takes the ending thread's drain flag; the other steps only do while tracing.
+        ProfilerAsyncSpan BeginAsyncSpan(int sectionId);
+        void HandOffAsyncSpan(ProfilerAsyncSpan& span);
+        void ResumeAsyncSpan(ProfilerAsyncSpan& span);
+        void EndAsyncSpan(ProfilerAsyncSpan& span, int lineNumber, const char* fileName, const char* functionName);
+
+        // Method to calculate statistics for all sections (drains every thread's buffer and merges the results)
         void calculateStats();
 
         // Method to print profiling statistics 
         void printStats();
         void printStatsToCSV(const char* fileName);
         void printStatsToJSON(const char* fileName);
+        void printLiveStatsToJSON(std::ostream& file);  // Current stats of the running program, for ProfilerHttpServer
+
+        // Methods to print the call tree (inclusive and self time per parent/child path)
+        void printCallTree();
+        void printCallTreeToCSV(const char* fileName);
+
+        // Measures the profiler's own cost per section on the calling thread (run by the constructor, and again
+        // whenever counters are switched on or off).
+        // Compensated times subtract innerOverheadTicks from every section and pairOverheadTicks for every
+        // profiled section nested inside it.
+        void calibrateOverhead();
+        double GetInnerOverheadSeconds();
+        double GetPairOverheadSeconds();
+
+        // Events dropped because the ProfilerArena's budget ran out (see arena.hpp); 0 unless stats are incomplete
+        unsigned long long GetDroppedEventCount();
+
+        // Trace mode: every enter/exit drained from a thread's ring is also kept in that thread's
+        // preallocated trace buffer, which printTraceToJSON writes out as a Chrome/Perfetto trace
+        void EnableTrace(size_t eventsPerThread, ProfilerTracePolicy policy);
+        void DisableTrace();
+        void printTraceToJSON(const char* fileName);
+
+        // Hardware counters: every section entered afterwards also reads the given perf_event_open counters
+        // (see counters.hpp) on enter and exit, for per-section IPC and miss rates. Each thread opens its own
+        // group on its next section. Returns false, leaving sections timing-only, if none of the events can
+        // be counted here. Re-measures the profiler overhead, which grows with every counter read.
+        bool EnableCounters(const std::vector<ProfilerCounterEvent>& events);
+        void DisableCounters();
+        unsigned GetCounterMask();  // Events that opened when counters were last enabled
+
+        // Binary output: appends a snapshot of every thread's raw stats and call tree to a versioned binary file
+        // (see binary.hpp) on demand, and every flushIntervalMilliseconds from a background thread if that is
+        // above 0. Tools/profile_convert turns one or more of these files into the CSV/JSON reports.
+        void OpenBinaryOutput(const char* fileName, int flushIntervalMilliseconds);
+        void WriteBinarySnapshot();
+        void CloseBinaryOutput();  // Writes a final snapshot; also done by the destructor
+
+        // Shared stats: publishes the merged stats of every section into a POSIX shared memory object (see
+        // shared.hpp) that Tools/profiler_top reads from another process, each section under its own seqlock.
+        // A background thread checks every intervalMilliseconds whether a reader asked for fresh numbers and
+        // only then drains and merges the threads' stats, so recording threads never do any of it and an
+        // unwatched process pays one wakeup per interval. name is e.g. "/myservice", or nullptr for
+        // "/profiler-<pid>". Returns false (after printing why) if the object can't be created.
+        bool OpenSharedStats(const char* name, int intervalMilliseconds);
+        void CloseSharedStats();  // Also done by the destructor
+        std::string GetSharedStatsName();  // The open object's name, "" if shared stats aren't open
+
+        // Baselines: saves the run as its own binary profile with the run's metadata (see baseline.hpp), for
+        // Tools/profile_diff to compare later runs against. Returns the file written, or "" if it failed.
+        std::string SaveBaseline(const char* directory);
+
+        // Allocation tracking: charges the heap use of every operator new/delete to the innermost section
+        // on the allocating thread (see allocations.hpp), reported next to the time stats. Returns false if
+        // this build doesn't have the allocation hooks.
+        bool EnableAllocationTracking();
+        void DisableAllocationTracking();
+
+        // Windows: besides the whole-run totals, stats are kept per interval so spikes, warm-up and drift aren't
+        // averaged away. A window closes every intervalMilliseconds (from a background thread, if above 0) and
+        // on every MarkFrame, and the last historyLength windows are kept. Each thread's window stats are
+        // double-buffered: closing a window swaps an empty set in under the thread's drain flag, so threads
+        // keep recording, and the merged window is published to readers with a single swap. A thread's window
+        // boundary is the moment its ring is drained by the close. Windows only hold the sections called in
+        // them. A thread whose window outgrows the memory budget drops its part of that window (published as
+        // incomplete) and keeps its whole-run stats. Returns false if the history doesn't fit in the budget.
+        bool EnableWindows(int intervalMilliseconds, size_t historyLength);
+        void DisableWindows();  // Stops closing windows; the history can still be read
+        void MarkFrame();       // Closes the current window, e.g. once per frame or batch of requests
+        bool GetLatestWindow(ProfilerWindow& window);  // false until the first window has closed
+        void printWindowsToJSON(std::ostream& file);   // Oldest window first, for ProfilerHttpServer's /windows
+        void printWindowsToJSON(const char* fileName);
+
+        // Lock reports: every ProfiledMutex, ProfiledSharedMutex and ProfiledConditionVariable name (see locks.hpp),
+        // merged across threads ("all") and ranked by wait time, then per thread. They read the threads' running
+        // totals directly, so they don't need calculateStats.
+        void printLocksToCSV(const char* fileName);
+        void printLocksToJSON(const char* fileName);
+        void printLocksToJSON(std::ostream& file);  // For ProfilerHttpServer's /locks
+
+        // Returns the calling thread's innermost entered section, or -1. Safe to call from a signal handler
+        // (used by ProfilerSampler) as long as the Profiler isn't being deleted at the same time.
+        static int GetActiveSectionForSignal();
+
+        // The calling thread's buffer if it already has one in the current Profiler, otherwise nullptr. Never
+        // locks or allocates, so the allocation hooks and signal handlers can use it; the same goes for
+        // GetActiveSection, the buffer's innermost entered section or -1.
+        static ProfilerThreadBuffer* GetThreadBufferIfRegistered();
+        static int GetActiveSection(ProfilerThreadBuffer* buffer);
+
+        // Enter/exit events the calling thread has recorded in the current Profiler so far (0 without a buffer).
+        // The difference over a stretch of code, halved, is the number of profiled sections it ran on this
+        // thread, each costing about GetPairOverheadSeconds.
+        static unsigned long long GetRecordedEventCount();
+
+        // For the profiled locks: the calling thread's buffer, registering it if a Profiler exists (never creates
+        // one), and the thread's totals for a lock from that buffer (nullptr if they don't fit in the budget)
+        static ProfilerThreadBuffer* GetThreadBufferIfProfiling();
+        static ProfilerLockTotals* GetLockTotals(ProfilerThreadBuffer* buffer, int lockId);
+
+        // Returns the merged call count for a section (0 if it was never recorded), valid after calculateStats
+        long long GetSectionCount(const char* sectionName);
 
         // Singleton pattern to ensure only one instance of Profiler exists
-        static Profiler* gProfiler;  // Static instance of the Profiler
+        static std::atomic<Profiler*> gProfiler;  // Static instance of the Profiler
         static Profiler* GetInstance(); //singleton pattern
 
     private:
         // Private constructor to enforce the singleton pattern
         Profiler();
-        void ReportSectionTime(char const* sectionName, double elapsedTime);
-        void ReportSectionTime(char const* sectionName, double elapsedTime, int lineNumber, const char* fileName, const char* functionName);
+        void ReportSectionTime(ProfilerStats& sectionStats, const ProfilerSectionTiming& timing, bool isOutermost, int lineNumber, const char* fileName, const char* functionName);
+        void MergeSectionStats(ProfilerVector<ProfilerStats>& target, int sectionId, const ProfilerStats& source);
+
+        // Per-thread buffers: registration takes threadsMutex once per thread, recording never does
+        ProfilerThreadBuffer* GetThreadBuffer();
+        void RecordEvent(ProfilerThreadBuffer* buffer, const ProfilerEvent& event);
+        void RecordEvent(ProfilerThreadBuffer* buffer, const ProfilerEvent& event, const ProfilerCounterSample& counters);
+        ProfilerCounterGroup* GetThreadCounters(ProfilerThreadBuffer* buffer);  // Reopens the group after EnableCounters
+        void DrainBuffer(ProfilerThreadBuffer* buffer);
+        void RecordAsyncStep(ProfilerThreadBuffer* buffer, const ProfilerAsyncSpan& span, ProfilerAsyncPhase phase, ProfilerTicks ticks);  // Caller holds the drain flag
+        void CollectAllocations(ProfilerThreadBuffer* buffer);  // Caller holds the buffer's drain flag
+        void CollectMetrics(ProfilerThreadBuffer* buffer);      // Caller holds the buffer's drain flag
+        void CollectLocks(std::vector<std::pair<int, ProfilerLockStats>>& threadLocks, std::vector<ProfilerLockStats>& merged);
+        void WriteBinarySnapshotLocked(ProfilerBinaryWriter* writer);  // Caller holds binaryMutex
+        void BinaryFlushLoop();
+        void CloseWindow();  // Caller holds windowCloseMutex
+        void PublishSharedStats();  // Caller holds sharedMutex
+        void SharedPublishLoop();
+        void WindowLoop();
+
+        static const size_t kThreadBufferCapacity = 1 << 15;
+        static const int kCalibrationBatches = 10;
+        static const int kCalibrationPairsPerBatch = 1000;  // All batches together must fit in one thread buffer
+        double innerOverheadTicks;  // Part of one enter/exit pair that lands between the section's own clock reads
+        double pairOverheadTicks;   // Whole cost of one enter/exit pair, as seen by the enclosing section
+        static std::atomic<unsigned> nextGeneration;  // Distinguishes this instance from any previously deleted one
+        unsigned generation;
+        ProfilerTicks startTicks;  // Origin for trace timestamps
+        std::mutex threadsMutex;  // Also guards the trace settings below
+        std::atomic<bool> traceEnabled;  // Also read without the lock, by the async span steps that only trace
+        size_t traceEventsPerThread;
+        ProfilerTracePolicy tracePolicy;
+        ProfilerVector<ProfilerThreadBuffer*> threadBuffers;
+        std::atomic<unsigned long long> nextAsyncSpanId;
+
+        // Counter settings: counterEvents is guarded by threadsMutex, counterConfiguration changes with every
+        // EnableCounters/DisableCounters call so each thread notices on its next section
+        std::atomic<unsigned> counterConfiguration;
+        std::vector<ProfilerCounterEvent> counterEvents;
+        unsigned counterMask;
+
+        // Binary output, guarded by binaryMutex (always taken before threadsMutex)
+        std::mutex binaryMutex;
+        std::condition_variable binaryFlushCondition;
+        ProfilerBinaryWriter* binaryWriter;  // nullptr unless binary output is open
+        std::thread binaryFlushThread;
+        int binaryFlushIntervalMilliseconds;
+        bool binaryFlushStop;
+
+        // Shared stats, guarded by sharedMutex (always taken before threadsMutex)
+        std::mutex sharedMutex;
+        std::condition_variable sharedCondition;
+        ProfilerSharedWriter* sharedWriter;  // nullptr unless shared stats are open
+        std::thread sharedThread;
+        int sharedIntervalMilliseconds;
+        bool sharedStop;
+
+        // Windows: windowCloseMutex serializes closing (taken before threadsMutex), windowsMutex guards the
+        // published history. windowHistory is a ring holding window N at N % size.
+        std::atomic<bool> windowsEnabled;
+        std::mutex windowCloseMutex;
+        std::condition_variable windowCondition;
+        std::thread windowThread;
+        int windowIntervalMilliseconds;
+        bool windowStop;
+        ProfilerTicks windowStartTicks;
+        ProfilerWindow buildingWindow;                   // Merged into by CloseWindow, then swapped into the history
+        ProfilerWindowStats buildingWindowStats;         // Each thread's window merged per section, summed up into buildingWindow
+        ProfilerWindowStats spareWindowStats;            // Swapped into each thread in place of its finished window
+        std::mutex windowsMutex;
+        ProfilerVector<ProfilerWindow> windowHistory;
+        unsigned long long publishedWindows;
 
-        // Map to store profiling statistics by section name
-        std::map<char const*, ProfilerStats*> stats;
-        std::vector<TimeRecordStop> elapsedTimes;
-        std::map<const char*, TimeRecordStart> sectionMap;
+        // Profiling statistics merged across all threads, indexed by section ID
+        ProfilerVector<ProfilerStats> stats;
+        ProfilerVector<ProfilerCallNode> callTree;  // Merged across all threads by matching call paths
 };
@@ -0,0 +1,199 @@
+#include "registry.hpp"
+#include "allocations.hpp"
+#include <cstring>
+#include <iostream>
+
+// Out-of-class definitions, so the constants can be bound by reference (std::vector's fill value, std::min)
+const int ProfilerSectionRegistry::kMaxSections;
+const int ProfilerSectionRegistry::kOverflowSection;
+const int ProfilerSectionRegistry::kMaxMetrics;
+const int ProfilerSectionRegistry::kMaxLocks;
+
+// Registry constructor: Slot 0 catches any names registered after the table is full
+ProfilerSectionRegistry::ProfilerSectionRegistry() : sectionCount(0), metricCount(0), lockCount(0) {
+    names[kOverflowSection] = "(section limit reached)";
+    InternSlow(names[kOverflowSection]);
+    if (sectionCount.load(std::memory_order_relaxed) == 0) {
+        // Not even room for its key in the arena; the slot still has to exist
+        sampleEvery[kOverflowSection].store(1, std::memory_order_relaxed);
+        sectionCount.store(1, std::memory_order_release);
+    }
+}
+
+// Registry singleton: Function-local static, so construction is thread-safe and happens on first use
+ProfilerSectionRegistry* ProfilerSectionRegistry::GetInstance() {
+    static ProfilerSectionRegistry registry;
+    return &registry;
+}
+
+// Intern: Per-thread pointer cache in front of the shared, locked content lookup. A hit is only trusted if the
+// pointer still holds the name it was resolved for, since callers may reuse a buffer for another name.
+int ProfilerSectionRegistry::Intern(char const* sectionName) {
+    thread_local std::unordered_map<char const*, int, std::hash<char const*>, std::equal_to<char const*>, ProfilerArenaAllocator<std::pair<char const* const, int>>> resolved;
+    auto it = resolved.find(sectionName);
+    if (it != resolved.end()) {
+        if (std::strcmp(names[it->second], sectionName) == 0) {
+            return it->second;
+        }
+        if (it->second == kOverflowSection) {
+            int sectionId = Find(sectionName);  // Registered before the table filled up, or still no room
+            return sectionId >= 0 ? sectionId : kOverflowSection;
+        }
+    }
+    ProfilerAllocationPause pause;  // A section's first use is often inside another section
+    int sectionId = InternSlow(sectionName);
+    try {
+        resolved[sectionName] = sectionId;
+    } catch (const std::bad_alloc&) {
+        // Out of budget: the name still resolves, just through the lock every time
+    }
+    return sectionId;
+}
+
+// InternSlow: Looks the name up by contents, adding it to the table if this is the first time it's seen
+int ProfilerSectionRegistry::InternSlow(char const* sectionName) {
+    std::lock_guard<std::mutex> lock(mutex);
+    try {
+        ProfilerString key(sectionName);
+        auto it = ids.find(key);
+        if (it != ids.end()) {
+            return it->second;
+        }
+
+        int sectionId = sectionCount.load(std::memory_order_relaxed);
+        if (sectionId == kMaxSections) {
+            std::cerr << "Error: Too many profiler sections, recording " << sectionName << " as " << names[kOverflowSection] << std::endl;
+            return kOverflowSection;
+        }
+
+        it = ids.emplace(std::move(key), sectionId).first;
+        names[sectionId] = it->first.c_str();
+        sampleEvery[sectionId].store(1, std::memory_order_relaxed);
+        sectionCount.store(sectionId + 1, std::memory_order_release);
+        return sectionId;
+    } catch (const std::bad_alloc&) {
+        std::cerr << "Error: Profiler memory budget exhausted, recording " << sectionName << " as " << names[kOverflowSection] << std::endl;
+        return kOverflowSection;
+    }
+}
+
+// InternSampled: Registers the section and its sampling rate (the most recent call site wins if they disagree)
+int ProfilerSectionRegistry::InternSampled(char const* sectionName, int sampleEvery) {
+    int sectionId = Intern(sectionName);
+    this->sampleEvery[sectionId].store(sampleEvery < 1 ? 1 : sampleEvery, std::memory_order_relaxed);
+    return sectionId;
+}
+
+int ProfilerSectionRegistry::GetSampleEvery(int sectionId) const {
+    return sampleEvery[sectionId].load(std::memory_order_relaxed);
+}
+
+// Find: Content lookup that never adds a section
+int ProfilerSectionRegistry::Find(char const* sectionName) {
+    std::lock_guard<std::mutex> lock(mutex);
+    try {
+        auto it = ids.find(ProfilerString(sectionName));
+        return it != ids.end() ? it->second : -1;
+    } catch (const std::bad_alloc&) {
+        return -1;  // Too long to copy into the arena, so never interned either
+    }
+}
+
+char const* ProfilerSectionRegistry::GetName(int sectionId) const {
+    return names[sectionId];
+}
+
+int ProfilerSectionRegistry::GetSectionCount() const {
+    return sectionCount.load(std::memory_order_acquire);
+}
+
+// InternMetric: Content lookup under the same lock as the sections; call sites cache the ID, so this runs once per site
+int ProfilerSectionRegistry::InternMetric(char const* metricName) {
+    ProfilerAllocationPause pause;
+    std::lock_guard<std::mutex> lock(mutex);
+    try {
+        ProfilerString key(metricName);
+        auto it = metricIds.find(key);
+        if (it != metricIds.end()) {
+            return it->second;
+        }
+
+        int metricId = metricCount.load(std::memory_order_relaxed);
+        if (metricId == kMaxMetrics) {
+            std::cerr << "Error: Too many profiler counter names, ignoring counts of " << metricName << std::endl;
+            return -1;
+        }
+
+        it = metricIds.emplace(std::move(key), metricId).first;
+        metricNames[metricId] = it->first.c_str();
+        metricCount.store(metricId + 1, std::memory_order_release);
+        return metricId;
+    } catch (const std::bad_alloc&) {
+        std::cerr << "Error: Profiler memory budget exhausted, ignoring counts of " << metricName << std::endl;
+        return -1;
+    }
+}
+
+char const* ProfilerSectionRegistry::GetMetricName(int metricId) const {
+    return metricNames[metricId];
+}
+
+int ProfilerSectionRegistry::GetMetricCount() const {
+    return metricCount.load(std::memory_order_acquire);
+}
+
+const char* GetLockKindName(ProfilerLockKind kind) {
+    switch (kind) {
+        case LOCK_KIND_MUTEX: return "Mutex";
+        case LOCK_KIND_SHARED_MUTEX: return "Shared Mutex";
+        case LOCK_KIND_CONDITION_VARIABLE: return "Condition Variable";
+        default: return "Unknown";
+    }
+}
+
+// InternLock: Like InternMetric; runs once per lock object, when it is constructed. The wait section is
+// interned first since InternSlow takes the same lock.
+int ProfilerSectionRegistry::InternLock(char const* lockName, ProfilerLockKind kind) {
+    ProfilerAllocationPause pause;
+    int waitSection = InternSlow(("Lock Wait: " + std::string(lockName)).c_str());
+    std::lock_guard<std::mutex> lock(mutex);
+    try {
+        ProfilerString key(lockName);
+        auto it = lockIds.find(key);
+        if (it != lockIds.end()) {
+            return it->second;
+        }
+
+        int lockId = lockCount.load(std::memory_order_relaxed);
+        if (lockId == kMaxLocks) {
+            std::cerr << "Error: Too many profiled locks, " << lockName << " works but isn't profiled" << std::endl;
+            return -1;
+        }
+
+        it = lockIds.emplace(std::move(key), lockId).first;
+        lockNames[lockId] = it->first.c_str();
+        lockKinds[lockId] = kind;
+        lockWaitSections[lockId] = waitSection;
+        lockCount.store(lockId + 1, std::memory_order_release);
+        return lockId;
+    } catch (const std::bad_alloc&) {
+        std::cerr << "Error: Profiler memory budget exhausted, " << lockName << " works but isn't profiled" << std::endl;
+        return -1;
+    }
+}
+
+char const* ProfilerSectionRegistry::GetLockName(int lockId) const {
+    return lockNames[lockId];
+}
+
+ProfilerLockKind ProfilerSectionRegistry::GetLockKind(int lockId) const {
+    return lockKinds[lockId];
+}
+
+int ProfilerSectionRegistry::GetLockWaitSection(int lockId) const {
+    return lockWaitSections[lockId];
+}
+
+int ProfilerSectionRegistry::GetLockCount() const {
+    return lockCount.load(std::memory_order_acquire);
+}
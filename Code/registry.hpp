@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "arena.hpp"
+
+using namespace std;
+
+// What a lock registered with InternLock is (see locks.hpp)
+enum ProfilerLockKind {
+    LOCK_KIND_MUTEX,
+    LOCK_KIND_SHARED_MUTEX,
+    LOCK_KIND_CONDITION_VARIABLE,
+    LOCK_KIND_COUNT
+};
+
+const char* GetLockKindName(ProfilerLockKind kind);
+
+// ProfilerSectionRegistry class: Interns section names by their contents into dense integer IDs,
+// so the same name used from two translation units (two different pointers) is one section. The names of
+// custom counters (PROFILER_COUNT, called metrics in the code to tell them from the hardware counters)
+// and of profiled locks are interned the same way, each into a much smaller table.
+class ProfilerSectionRegistry {
+    public:
+        static const int kMaxSections = 4096;
+        static const int kOverflowSection = 0;  // Shared by every name interned after the registry is full
+        static const int kMaxMetrics = 16;
+        static const int kMaxLocks = 64;
+
+        // Singleton pattern, the registry outlives any Profiler instance so cached IDs stay valid
+        static ProfilerSectionRegistry* GetInstance();
+
+        // Returns the ID for a section name, registering it on first use. Each thread remembers the
+        // pointers it has already resolved, so repeated lookups of the same literal never take the lock;
+        // a remembered pointer is checked against the name's contents (a strcmp), so a buffer reused for
+        // another name is looked up again rather than given the old name's ID.
+        // Once the ProfilerArena's budget is used up, new names are recorded as kOverflowSection.
+        int Intern(char const* sectionName);
+
+        // Same as Intern, and also marks the section as recorded only once every sampleEvery calls
+        int InternSampled(char const* sectionName, int sampleEvery);
+        int GetSampleEvery(int sectionId) const;
+
+        // Returns the ID for a section name without registering it (-1 if it was never interned)
+        int Find(char const* sectionName);
+
+        char const* GetName(int sectionId) const;
+        int GetSectionCount() const;
+
+        // Returns the ID for a custom counter name, registering it on first use, or -1 once kMaxMetrics
+        // names are taken or the arena's budget is used up (counts under that name are then ignored)
+        int InternMetric(char const* metricName);
+        char const* GetMetricName(int metricId) const;
+        int GetMetricCount() const;
+
+        // Returns the ID for a lock name, registering it on first use (the first kind given wins), or -1 once
+        // kMaxLocks names are taken or the arena's budget is used up. Every lock also gets a section,
+        // "Lock Wait: <name>", that its contended waits are recorded as.
+        int InternLock(char const* lockName, ProfilerLockKind kind);
+        char const* GetLockName(int lockId) const;
+        ProfilerLockKind GetLockKind(int lockId) const;
+        int GetLockWaitSection(int lockId) const;
+        int GetLockCount() const;
+
+    private:
+        ProfilerSectionRegistry();
+        int InternSlow(char const* sectionName);
+
+        std::mutex mutex;
+        // Node-based, so the key strings never move; lives in the ProfilerArena like the rest of the profiler
+        std::unordered_map<ProfilerString, int, ProfilerStringHash, std::equal_to<ProfilerString>, ProfilerArenaAllocator<std::pair<const ProfilerString, int>>> ids;
+        char const* names[kMaxSections];  // Points at the keys in ids, written before sectionCount is published
+        std::atomic<int> sampleEvery[kMaxSections];
+        std::atomic<int> sectionCount;
+
+        std::unordered_map<ProfilerString, int, ProfilerStringHash, std::equal_to<ProfilerString>, ProfilerArenaAllocator<std::pair<const ProfilerString, int>>> metricIds;
+        char const* metricNames[kMaxMetrics];
+        std::atomic<int> metricCount;
+
+        std::unordered_map<ProfilerString, int, ProfilerStringHash, std::equal_to<ProfilerString>, ProfilerArenaAllocator<std::pair<const ProfilerString, int>>> lockIds;
+        char const* lockNames[kMaxLocks];
+        ProfilerLockKind lockKinds[kMaxLocks];
+        int lockWaitSections[kMaxLocks];
+        std::atomic<int> lockCount;
+};
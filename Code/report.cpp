@@ -0,0 +1,322 @@
+#include "report.hpp"
+#include <cstring>
+
+void writeCSVField(std::ostream& file, const char* text) {
+    if (text == nullptr) {
+        text = "";
+    }
+    size_t length = std::strlen(text);
+    bool needsQuotes = std::strpbrk(text, ",\"\r\n") != nullptr
+                       || (length > 0 && (text[0] == ' ' || text[length - 1] == ' '));
+    if (!needsQuotes) {
+        file << text;
+        return;
+    }
+    file << '"';
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"') {
+            file << '"';
+        }
+        file << *c;
+    }
+    file << '"';
+}
+
+void writeJSONString(std::ostream& file, const char* text) {
+    if (text == nullptr) {
+        text = "";
+    }
+    file << '"';
+    for (const char* c = text; *c != '\0'; c++) {
+        switch (*c) {
+            case '"': file << "\\\""; break;
+            case '\\': file << "\\\\"; break;
+            case '\n': file << "\\n"; break;
+            case '\t': file << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(*c) < 0x20) {
+                    file << ' ';
+                } else {
+                    file << *c;
+                }
+        }
+    }
+    file << '"';
+}
+
+void writeStatsCSVHeader(std::ostream& file, const std::vector<std::string>& metricNames) {
+    file << "Section Name, Thread ID, Call Count, Total Time, Min Time, Max Time, Avg Time, Self Time, Compensated Total Time, Compensated Avg Time, Compensated Self Time, P50 Time, P90 Time, P99 Time, P99.9 Time, Sample Every, File Name, Function Name, Line Number, Counted Calls";
+    for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+        file << ", " << GetCounterEventName(static_cast<ProfilerCounterEvent>(event));
+    }
+    file << ", IPC, Cache Miss Rate, Branch Miss Rate, Allocations, Allocated Bytes, Freed Bytes, Peak Live Bytes, Async Spans, Hand-offs, Queue Time, Avg Queue Time, Max Queue Time";
+    for (const std::string& name : metricNames) {
+        file << ", ";
+        writeCSVField(file, name.c_str());
+        file << ", ";
+        writeCSVField(file, (name + " per Second").c_str());
+        file << ", ";
+        writeCSVField(file, ("Seconds per " + name).c_str());
+    }
+    file << "\n";
+}
+
+// writeStatsCSVRow: Writes one section's statistics as a CSV row tagged with the thread it belongs to
+void writeStatsCSVRow(std::ostream& file, const std::string& threadLabel, const ProfilerStats* stat, const std::vector<std::string>& metricNames) {
+    writeCSVField(file, stat->sectionName);
+    file << ", " 
+         << threadLabel << ", " 
+         << stat->count << ", " 
+         << stat->totalTime << ", " 
+         << stat->minTime << ", " 
+         << stat->maxTime << ", " 
+         << stat->avgTime << ", " 
+         << stat->selfTime << ", " 
+         << stat->compensatedTotalTime << ", " 
+         << stat->compensatedAvgTime << ", " 
+         << stat->compensatedSelfTime << ", " 
+         << stat->p50Time << ", " 
+         << stat->p90Time << ", " 
+         << stat->p99Time << ", " 
+         << stat->p999Time << ", " 
+         << stat->sampleEvery << ", ";
+    writeCSVField(file, stat->fileName);
+    file << ", ";
+    writeCSVField(file, stat->functionName);
+    file << ", " << stat->lineNumber << ", " << stat->counterCalls;
+    for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+        file << ", " << stat->counterTotals[event];
+    }
+    file << ", " 
+         << stat->instructionsPerCycle << ", " 
+         << stat->cacheMissRate << ", " 
+         << stat->branchMissRate << ", "
+         << stat->allocationCount << ", "
+         << stat->allocatedBytes << ", "
+         << stat->freedBytes << ", "
+         << stat->peakLiveBytes << ", "
+         << stat->asyncCount << ", "
+         << stat->handOffCount << ", "
+         << stat->queueTime << ", "
+         << stat->avgQueueTime << ", "
+         << stat->maxQueueTime;
+    for (size_t metric = 0; metric < metricNames.size() && metric < ProfilerSectionRegistry::kMaxMetrics; metric++) {
+        file << ", " 
+             << stat->metricTotals[metric] << ", " 
+             << stat->metricRates[metric] << ", " 
+             << stat->metricSecondsPerUnit[metric];
+    }
+    file << "\n";
+}
+
+// writeHistogramJSON: Writes the non-empty histogram buckets (bounds in seconds) so runs can be merged and charted later
+static void writeHistogramJSON(std::ostream& file, const ProfilerHistogram& histogram, double secondsPerTick) {
+    file << "    \"Histogram\": [";
+    bool first = true;
+    for (int bucket = 0; bucket < ProfilerHistogram::kBucketCount; bucket++) {
+        unsigned int bucketCount = histogram.GetBucketCount(bucket);
+        if (bucketCount == 0) {
+            continue;
+        }
+        if (!first) {
+            file << ", ";
+        }
+        first = false;
+        file << "{\"Lower\": " << secondsPerTick * ProfilerHistogram::GetBucketLowerBound(bucket)
+             << ", \"Upper\": " << secondsPerTick * (ProfilerHistogram::GetBucketUpperBound(bucket) + 1)
+             << ", \"Count\": " << bucketCount << "}";
+    }
+    file << "],\n";
+}
+
+// writeCountersJSON: Writes the counter totals of the events that were counted, and the rates derived from them
+static void writeCountersJSON(std::ostream& file, const ProfilerStats* stat) {
+    file << "    \"Counted Calls\": " << stat->counterCalls << ",\n";
+    file << "    \"Counters\": {";
+    bool first = true;
+    for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+        if ((stat->counterMask & (1u << event)) == 0) {
+            continue;
+        }
+        if (!first) {
+            file << ", ";
+        }
+        first = false;
+        file << "\"" << GetCounterEventName(static_cast<ProfilerCounterEvent>(event)) << "\": " << stat->counterTotals[event];
+    }
+    file << "},\n";
+    file << "    \"IPC\": " << stat->instructionsPerCycle << ",\n";
+    file << "    \"Cache Miss Rate\": " << stat->cacheMissRate << ",\n";
+    file << "    \"Branch Miss Rate\": " << stat->branchMissRate << ",\n";
+}
+
+// writeMetricsJSON: Writes the custom counters counted in the section, each with its total and derived rates
+static void writeMetricsJSON(std::ostream& file, const ProfilerStats* stat, const std::vector<std::string>& metricNames) {
+    file << "    \"Custom Counters\": {";
+    bool first = true;
+    for (size_t metric = 0; metric < metricNames.size() && metric < ProfilerSectionRegistry::kMaxMetrics; metric++) {
+        if ((stat->metricMask & (1u << metric)) == 0) {
+            continue;
+        }
+        if (!first) {
+            file << ", ";
+        }
+        first = false;
+        writeJSONString(file, metricNames[metric].c_str());
+        file << ": {\"Total\": " << stat->metricTotals[metric]
+             << ", \"Per Second\": " << stat->metricRates[metric]
+             << ", \"Seconds Each\": " << stat->metricSecondsPerUnit[metric] << "}";
+    }
+    file << "},\n";
+}
+
+// writeStatsJSONObject: Writes one section's statistics as a JSON object tagged with the thread it belongs to
+void writeStatsJSONObject(std::ostream& file, const std::string& threadLabel, const ProfilerStats* stat, double secondsPerTick, const std::vector<std::string>& metricNames) {
+    file << "  {\n";
+    file << "    \"Section Name\": ";
+    writeJSONString(file, stat->sectionName);
+    file << ",\n";
+    file << "    \"Thread ID\": \"" << threadLabel << "\",\n";
+    file << "    \"Call Count\": " << stat->count << ",\n";
+    file << "    \"Total Time\": " << stat->totalTime << ",\n";
+    file << "    \"Min Time\": " << stat->minTime << ",\n";
+    file << "    \"Max Time\": " << stat->maxTime << ",\n";
+    file << "    \"Avg Time\": " << stat->avgTime << ",\n";
+    file << "    \"Self Time\": " << stat->selfTime << ",\n";
+    file << "    \"Compensated Total Time\": " << stat->compensatedTotalTime << ",\n";
+    file << "    \"Compensated Avg Time\": " << stat->compensatedAvgTime << ",\n";
+    file << "    \"Compensated Self Time\": " << stat->compensatedSelfTime << ",\n";
+    file << "    \"P50 Time\": " << stat->p50Time << ",\n";
+    file << "    \"P90 Time\": " << stat->p90Time << ",\n";
+    file << "    \"P99 Time\": " << stat->p99Time << ",\n";
+    file << "    \"P99.9 Time\": " << stat->p999Time << ",\n";
+    file << "    \"Sample Every\": " << stat->sampleEvery << ",\n";
+    writeHistogramJSON(file, stat->histogram, secondsPerTick);
+    writeCountersJSON(file, stat);
+    file << "    \"Allocations\": " << stat->allocationCount << ",\n";
+    file << "    \"Allocated Bytes\": " << stat->allocatedBytes << ",\n";
+    file << "    \"Freed Bytes\": " << stat->freedBytes << ",\n";
+    file << "    \"Peak Live Bytes\": " << stat->peakLiveBytes << ",\n";
+    file << "    \"Async Spans\": " << stat->asyncCount << ",\n";
+    file << "    \"Hand-offs\": " << stat->handOffCount << ",\n";
+    file << "    \"Queue Time\": " << stat->queueTime << ",\n";
+    file << "    \"Avg Queue Time\": " << stat->avgQueueTime << ",\n";
+    file << "    \"Max Queue Time\": " << stat->maxQueueTime << ",\n";
+    writeMetricsJSON(file, stat, metricNames);
+    file << "    \"File Name\": ";
+    writeJSONString(file, stat->fileName);
+    file << ",\n";
+    file << "    \"Function Name\": ";
+    writeJSONString(file, stat->functionName);
+    file << ",\n";
+    file << "    \"Line Number\": " << stat->lineNumber << "\n";
+    file << "  }";
+}
+
+void writeWindowJSONObject(std::ostream& file, const ProfilerWindow& window) {
+    file << "  {\n";
+    file << "    \"Window\": " << window.index << ",\n";
+    file << "    \"Start Time\": " << window.startSeconds << ",\n";
+    file << "    \"End Time\": " << window.endSeconds << ",\n";
+    file << "    \"Incomplete\": " << (window.incomplete ? "true" : "false") << ",\n";
+    file << "    \"Sections\": [";
+    bool first = true;
+    for (const ProfilerWindowSection& stat : window.sections) {
+        if (stat.count == 0) {
+            continue;
+        }
+        file << (first ? "\n" : ",\n");
+        first = false;
+        file << "      {\"Section Name\": ";
+        writeJSONString(file, stat.sectionName);
+        file << ", \"Call Count\": " << stat.count
+             << ", \"Total Time\": " << stat.totalTime
+             << ", \"Avg Time\": " << stat.avgTime
+             << ", \"Min Time\": " << stat.minTime
+             << ", \"Max Time\": " << stat.maxTime
+             << ", \"P50 Time\": " << stat.p50Time
+             << ", \"P90 Time\": " << stat.p90Time
+             << ", \"P99 Time\": " << stat.p99Time << "}";
+    }
+    file << (first ? "]\n" : "\n    ]\n");
+    file << "  }";
+}
+
+void writeCallTreeCSVHeader(std::ostream& file) {
+    file << "Thread ID, Node ID, Parent ID, Depth, Section Name, Call Count, Inclusive Time, Self Time, Compensated Inclusive Time, Compensated Self Time\n";
+}
+
+// writeCallTreeCSVRows: Writes every node except the root as a CSV row, parents before their children
+void writeCallTreeCSVRows(std::ostream& file, const std::string& threadLabel, const ProfilerVector<ProfilerCallNode>& tree, double secondsPerTick) {
+    for (size_t i = 1; i < tree.size(); i++) {
+        const ProfilerCallNode& node = tree[i];
+        file << threadLabel << ", " 
+             << i << ", " 
+             << node.parentIndex << ", " 
+             << node.depth << ", ";
+        writeCSVField(file, ProfilerSectionRegistry::GetInstance()->GetName(node.sectionId));
+        file << ", " 
+             << node.count << ", " 
+             << secondsPerTick * node.inclusiveTicks << ", " 
+             << secondsPerTick * node.selfTicks << ", " 
+             << secondsPerTick * node.compensatedInclusiveTicks << ", " 
+             << secondsPerTick * node.compensatedSelfTicks << "\n";
+    }
+}
+
+// blockingSectionName: The name of a lock's blocking section, -1 meaning the holder wasn't in one
+static const char* blockingSectionName(int sectionId) {
+    return sectionId >= 0 ? ProfilerSectionRegistry::GetInstance()->GetName(sectionId) : "(none)";
+}
+
+void writeLocksCSVHeader(std::ostream& file) {
+    file << "Lock Name, Kind, Thread ID, Acquisitions, Shared Acquisitions, Contentions, Contention Rate, Wait Time, Avg Wait Time, Max Wait Time, Hold Time, Avg Hold Time, Max Hold Time, Top Blocking Section, Top Blocking Wait Time\n";
+}
+
+// writeLockCSVRow: Writes one lock's totals as a CSV row, with only the heaviest blocking section
+void writeLockCSVRow(std::ostream& file, const std::string& threadLabel, const ProfilerLockStats& stat) {
+    writeCSVField(file, stat.lockName);
+    file << ", " 
+         << GetLockKindName(stat.kind) << ", " 
+         << threadLabel << ", " 
+         << stat.acquisitions << ", " 
+         << stat.sharedAcquisitions << ", " 
+         << stat.contentions << ", " 
+         << stat.contentionRate << ", " 
+         << stat.waitTime << ", " 
+         << stat.avgWaitTime << ", " 
+         << stat.maxWaitTime << ", " 
+         << stat.holdTime << ", " 
+         << stat.avgHoldTime << ", " 
+         << stat.maxHoldTime << ", ";
+    writeCSVField(file, stat.blockerCount > 0 ? blockingSectionName(stat.blockers[0].sectionId) : "");
+    file << ", " << (stat.blockerCount > 0 ? stat.blockers[0].waitTime : 0.0) << "\n";
+}
+
+// writeLockJSONObject: Writes one lock's totals as a JSON object, with every blocking section kept
+void writeLockJSONObject(std::ostream& file, const std::string& threadLabel, const ProfilerLockStats& stat) {
+    file << "  {\n";
+    file << "    \"Lock Name\": ";
+    writeJSONString(file, stat.lockName);
+    file << ",\n";
+    file << "    \"Kind\": \"" << GetLockKindName(stat.kind) << "\",\n";
+    file << "    \"Thread ID\": \"" << threadLabel << "\",\n";
+    file << "    \"Acquisitions\": " << stat.acquisitions << ",\n";
+    file << "    \"Shared Acquisitions\": " << stat.sharedAcquisitions << ",\n";
+    file << "    \"Contentions\": " << stat.contentions << ",\n";
+    file << "    \"Contention Rate\": " << stat.contentionRate << ",\n";
+    file << "    \"Wait Time\": " << stat.waitTime << ",\n";
+    file << "    \"Avg Wait Time\": " << stat.avgWaitTime << ",\n";
+    file << "    \"Max Wait Time\": " << stat.maxWaitTime << ",\n";
+    file << "    \"Hold Time\": " << stat.holdTime << ",\n";
+    file << "    \"Avg Hold Time\": " << stat.avgHoldTime << ",\n";
+    file << "    \"Max Hold Time\": " << stat.maxHoldTime << ",\n";
+    file << "    \"Blocking Sections\": [";
+    for (int i = 0; i < stat.blockerCount; i++) {
+        file << (i == 0 ? "" : ", ") << "{\"Section Name\": ";
+        writeJSONString(file, blockingSectionName(stat.blockers[i].sectionId));
+        file << ", \"Wait Time\": " << stat.blockers[i].waitTime << "}";
+    }
+    file << "]\n";
+    file << "  }";
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+#include "profiler.hpp"
+
+using namespace std;
+
+// Text report writers shared by the Profiler and Tools/profile_convert.cpp, so both produce exactly the
+// same CSV/JSON schema. Tick fields are converted with the given seconds per tick rather than the running
+// process's clock, since a converted file may come from another machine.
+
+// writeCSVField: Writes text as one CSV field, quoted (with quotes doubled) if it holds a comma, quote,
+// line break or leading/trailing space
+void writeCSVField(std::ostream& file, const char* text);
+
+// writeJSONString: Writes a quoted JSON string, escaping anything a section name could break the file with
+void writeJSONString(std::ostream& file, const char* text);
+
+// The stats writers take the names of the custom counters (PROFILER_COUNT) in metric ID order; the CSV has three
+// columns per name (the total, "<name> per Second" and "Seconds per <name>") after the fixed ones
+void writeStatsCSVHeader(std::ostream& file, const std::vector<std::string>& metricNames);
+void writeStatsCSVRow(std::ostream& file, const std::string& threadLabel, const ProfilerStats* stat, const std::vector<std::string>& metricNames);
+void writeStatsJSONObject(std::ostream& file, const std::string& threadLabel, const ProfilerStats* stat, double secondsPerTick, const std::vector<std::string>& metricNames);
+
+// writeWindowJSONObject: One ProfilerWindow with the timing summary of every section called in it
+void writeWindowJSONObject(std::ostream& file, const ProfilerWindow& window);
+
+void writeCallTreeCSVHeader(std::ostream& file);
+void writeCallTreeCSVRows(std::ostream& file, const std::string& threadLabel, const ProfilerVector<ProfilerCallNode>& tree, double secondsPerTick);
+
+// Lock reports (see locks.hpp); the blocking sections are the ones that held the lock while the thread waited,
+// heaviest first, and "(none)" stands for a holder that wasn't in any section
+void writeLocksCSVHeader(std::ostream& file);
+void writeLockCSVRow(std::ostream& file, const std::string& threadLabel, const ProfilerLockStats& stat);
+void writeLockJSONObject(std::ostream& file, const std::string& threadLabel, const ProfilerLockStats& stat);
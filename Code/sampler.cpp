@@ -0,0 +1,425 @@
+#include "sampler.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#define PROFILER_HAS_SAMPLER 1
+#else
+#define PROFILER_HAS_SAMPLER 0
+#endif
+
+std::atomic<ProfilerSampler*> ProfilerSampler::activeSampler(nullptr);
+
+// Constructor for ProfilerSampler and Destructor
+ProfilerSampler::ProfilerSampler() : samples(nullptr), capacity(0), nextSample(0), droppedSamples(0), running(false) {}
+ProfilerSampler::~ProfilerSampler() {
+    Stop();
+    deleteProfilerArenaArray(samples, capacity);
+}
+
+size_t ProfilerSampler::GetSampleCount() const {
+    return std::min(nextSample.load(), capacity);
+}
+
+size_t ProfilerSampler::GetDroppedCount() const {
+    return droppedSamples.load();
+}
+
+#if PROFILER_HAS_SAMPLER
+
+static struct sigaction gPreviousAction;  // What SIGPROF did before Start, put back by Stop
+
+// The handler's own frame and the kernel's signal trampoline sit above the interrupted code in a backtrace
+static const int kHandlerFrames = 2;
+
+// programCounter: The instruction the signal interrupted, from the saved register state
+static void* programCounter(void* context) {
+    ucontext_t* userContext = static_cast<ucontext_t*>(context);
+#if defined(__x86_64__)
+    return reinterpret_cast<void*>(userContext->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__i386__)
+    return reinterpret_cast<void*>(userContext->uc_mcontext.gregs[REG_EIP]);
+#elif defined(__aarch64__)
+    return reinterpret_cast<void*>(userContext->uc_mcontext.pc);
+#else
+    (void)userContext;
+    return nullptr;
+#endif
+}
+
+// ProfilerSamplerSignal struct: The SIGPROF handler. Claims the next slot with one atomic add and fills it
+// in place; everything it calls is async-signal-safe apart from backtrace, which is primed by Start so it
+// doesn't load libgcc from inside the handler.
+struct ProfilerSamplerSignal {
+    static void Handle(int, siginfo_t*, void* context) {
+        int savedErrno = errno;
+        ProfilerSampler* sampler = ProfilerSampler::activeSampler.load(std::memory_order_acquire);
+        if (sampler != nullptr) {
+            size_t index = sampler->nextSample.fetch_add(1, std::memory_order_relaxed);
+            if (index >= sampler->capacity) {
+                sampler->droppedSamples.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                ProfilerStackSample& sample = sampler->samples[index];
+                sample.sectionId = Profiler::GetActiveSectionForSignal();
+
+                void* trace[ProfilerStackSample::kMaxFrames + kHandlerFrames];
+                int depth = backtrace(trace, ProfilerStackSample::kMaxFrames + kHandlerFrames);
+
+                // Start at the interrupted instruction if the unwinder found it, otherwise skip the handler frames
+                void* pc = programCounter(context);
+                int first = std::min(depth, kHandlerFrames);
+                for (int i = 0; i < depth; i++) {
+                    if (trace[i] == pc) {
+                        first = i;
+                        break;
+                    }
+                }
+                int frameCount = 0;
+                if (pc != nullptr && (first >= depth || trace[first] != pc)) {
+                    sample.frames[frameCount++] = pc;
+                }
+                for (int i = first; i < depth && frameCount < ProfilerStackSample::kMaxFrames; i++) {
+                    sample.frames[frameCount++] = trace[i];
+                }
+                sample.frameCount = frameCount;
+                sample.complete.store(true, std::memory_order_release);
+            }
+        }
+        errno = savedErrno;
+    }
+};
+
+bool ProfilerSampler::Start(int frequencyHz, size_t maxSamples) {
+    if (running) {
+        return true;
+    }
+    if (frequencyHz <= 0 || maxSamples == 0) {
+        std::cerr << "Sampling needs a positive frequency and sample count." << std::endl;
+        return false;
+    }
+    ProfilerSampler* expected = nullptr;
+    if (!activeSampler.compare_exchange_strong(expected, this)) {
+        std::cerr << "Another ProfilerSampler is already running." << std::endl;
+        return false;
+    }
+
+    deleteProfilerArenaArray(samples, capacity);
+    samples = nullptr;
+    capacity = 0;
+    try {
+        samples = newProfilerArenaArray<ProfilerStackSample>(maxSamples);
+    } catch (const std::bad_alloc&) {
+        std::cerr << "Not enough of the profiler's memory budget left for " << maxSamples << " samples." << std::endl;
+        activeSampler.store(nullptr);
+        return false;
+    }
+    for (size_t i = 0; i < maxSamples; i++) {
+        samples[i].complete.store(false, std::memory_order_relaxed);
+    }
+    capacity = maxSamples;
+    nextSample.store(0);
+    droppedSamples.store(0);
+
+    // The first backtrace loads the unwinder, which must not happen inside the signal handler
+    void* prime[1];
+    backtrace(prime, 1);
+
+    Profiler::GetInstance();  // Built before sampling, so the handler never sees a half-built Profiler
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = &ProfilerSamplerSignal::Handle;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &gPreviousAction) != 0) {
+        std::cerr << "Failed to install the SIGPROF handler: " << std::strerror(errno) << std::endl;
+        activeSampler.store(nullptr);
+        return false;
+    }
+
+    long intervalMicroseconds = std::max(1L, 1000000L / frequencyHz);
+    itimerval timer;
+    timer.it_interval.tv_sec = intervalMicroseconds / 1000000;
+    timer.it_interval.tv_usec = intervalMicroseconds % 1000000;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        std::cerr << "Failed to start the profiling timer: " << std::strerror(errno) << std::endl;
+        sigaction(SIGPROF, &gPreviousAction, nullptr);
+        activeSampler.store(nullptr);
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+void ProfilerSampler::Stop() {
+    if (!running) {
+        return;
+    }
+    itimerval timer;
+    std::memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, nullptr);
+
+    // A SIGPROF still pending would kill the process under the default action, so that one becomes "ignore"
+    if (gPreviousAction.sa_handler == SIG_DFL && !(gPreviousAction.sa_flags & SA_SIGINFO)) {
+        struct sigaction ignore;
+        std::memset(&ignore, 0, sizeof(ignore));
+        ignore.sa_handler = SIG_IGN;
+        sigemptyset(&ignore.sa_mask);
+        sigaction(SIGPROF, &ignore, nullptr);
+    } else {
+        sigaction(SIGPROF, &gPreviousAction, nullptr);
+    }
+    activeSampler.store(nullptr, std::memory_order_release);
+    running = false;
+}
+
+// ProfilerSymbolTable class: Function symbols of one ELF file (its .symtab, which also covers static
+// functions, or .dynsym if it was stripped), sorted by address
+class ProfilerSymbolTable {
+    public:
+        struct Symbol {
+            uintptr_t start;
+            uintptr_t size;
+            std::string name;
+        };
+
+        bool Load(const char* fileName) {
+            std::ifstream file(fileName, std::ios::binary);
+            if (!file.is_open()) {
+                return false;
+            }
+            std::string image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            if (image.size() < sizeof(Elf64_Ehdr) || std::memcmp(image.data(), ELFMAG, SELFMAG) != 0 || image[EI_CLASS] != ELFCLASS64) {
+                return false;
+            }
+            Elf64_Ehdr header;
+            std::memcpy(&header, image.data(), sizeof(header));
+            relocatable = header.e_type == ET_DYN;  // PIE executables and shared objects are loaded at a base address
+            if (header.e_shoff == 0 || header.e_shoff + static_cast<size_t>(header.e_shnum) * sizeof(Elf64_Shdr) > image.size()) {
+                return false;
+            }
+            std::vector<Elf64_Shdr> sections(header.e_shnum);
+            std::memcpy(sections.data(), image.data() + header.e_shoff, sections.size() * sizeof(Elf64_Shdr));
+
+            for (Elf64_Word wanted : { static_cast<Elf64_Word>(SHT_SYMTAB), static_cast<Elf64_Word>(SHT_DYNSYM) }) {
+                for (const Elf64_Shdr& section : sections) {
+                    if (section.sh_type != wanted || section.sh_link >= sections.size()) {
+                        continue;
+                    }
+                    const Elf64_Shdr& strings = sections[section.sh_link];
+                    if (section.sh_offset + section.sh_size > image.size() || strings.sh_offset + strings.sh_size > image.size()) {
+                        continue;
+                    }
+                    size_t symbolCount = section.sh_size / sizeof(Elf64_Sym);
+                    for (size_t i = 0; i < symbolCount; i++) {
+                        Elf64_Sym symbol;
+                        std::memcpy(&symbol, image.data() + section.sh_offset + i * sizeof(Elf64_Sym), sizeof(symbol));
+                        if (ELF64_ST_TYPE(symbol.st_info) != STT_FUNC || symbol.st_value == 0 || symbol.st_name >= strings.sh_size) {
+                            continue;
+                        }
+                        symbols.push_back(Symbol{ symbol.st_value, symbol.st_size, std::string(image.data() + strings.sh_offset + symbol.st_name) });
+                    }
+                }
+                if (!symbols.empty()) {
+                    break;
+                }
+            }
+            std::sort(symbols.begin(), symbols.end(), [](const Symbol& a, const Symbol& b) { return a.start < b.start; });
+            return !symbols.empty();
+        }
+
+        // Find: The function holding the address (relative to the file for relocatable files), or nullptr
+        const Symbol* Find(uintptr_t address) const {
+            auto it = std::upper_bound(symbols.begin(), symbols.end(), address, [](uintptr_t value, const Symbol& symbol) { return value < symbol.start; });
+            if (it == symbols.begin()) {
+                return nullptr;
+            }
+            --it;
+            if (it->size != 0 && address >= it->start + it->size) {
+                return nullptr;
+            }
+            return &*it;
+        }
+
+        bool relocatable = false;
+
+    private:
+        std::vector<Symbol> symbols;
+};
+
+// demangle: Readable name of a C++ symbol, or the symbol itself if it isn't mangled
+static std::string demangle(const char* symbol) {
+    int status = 0;
+    char* readable = abi::__cxa_demangle(symbol, nullptr, nullptr, &status);
+    if (status != 0 || readable == nullptr) {
+        return symbol;
+    }
+    std::string name = readable;
+    std::free(readable);
+    return name;
+}
+
+// ProfilerSymbolizer class: Resolves addresses to function names, loading each module's symbols once
+class ProfilerSymbolizer {
+    public:
+        std::string Resolve(void* address) {
+            auto cached = names.find(address);
+            if (cached != names.end()) {
+                return cached->second;
+            }
+            std::string name = Lookup(reinterpret_cast<uintptr_t>(address));
+            names.emplace(address, name);
+            return name;
+        }
+
+    private:
+        std::string Lookup(uintptr_t address) {
+            Dl_info info;
+            if (dladdr(reinterpret_cast<void*>(address), &info) == 0 || info.dli_fname == nullptr) {
+                std::ostringstream text;
+                text << "0x" << std::hex << address;
+                return text.str();
+            }
+            uintptr_t base = reinterpret_cast<uintptr_t>(info.dli_fbase);
+            ProfilerSymbolTable* table = GetTable(info.dli_fname);
+            if (table != nullptr) {
+                const ProfilerSymbolTable::Symbol* symbol = table->Find(table->relocatable ? address - base : address);
+                if (symbol != nullptr) {
+                    return demangle(symbol->name.c_str());
+                }
+            }
+            if (info.dli_sname != nullptr) {
+                return demangle(info.dli_sname);
+            }
+            std::string module = info.dli_fname;
+            std::ostringstream text;
+            text << module.substr(module.find_last_of('/') + 1) << "+0x" << std::hex << (address - base);
+            return text.str();
+        }
+
+        ProfilerSymbolTable* GetTable(const char* moduleName) {
+            auto it = tables.find(moduleName);
+            if (it != tables.end()) {
+                return it->second.get();
+            }
+            std::unique_ptr<ProfilerSymbolTable> table(new ProfilerSymbolTable());
+            // The main program may be listed by the (relative) name it was started with, or not at all
+            if (!table->Load(moduleName) && !table->Load("/proc/self/exe")) {
+                table.reset();
+            }
+            ProfilerSymbolTable* result = table.get();
+            tables.emplace(moduleName, std::move(table));
+            return result;
+        }
+
+        std::unordered_map<void*, std::string> names;
+        std::unordered_map<std::string, std::unique_ptr<ProfilerSymbolTable>> tables;
+};
+
+// foldedFrameName: Folded stacks separate frames with ';' and end in " count", so neither may appear in a frame
+static std::string foldedFrameName(std::string name) {
+    std::replace(name.begin(), name.end(), ';', ':');
+    std::replace(name.begin(), name.end(), '\n', ' ');
+    return name;
+}
+
+void ProfilerSampler::printSamplesToFolded(const char* fileName) {
+    std::ofstream file(fileName);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for folded stack output." << std::endl;
+        return;
+    }
+
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    ProfilerSymbolizer symbolizer;
+    std::map<std::string, size_t> stacks;
+    size_t sampleCount = GetSampleCount();
+    for (size_t i = 0; i < sampleCount; i++) {
+        const ProfilerStackSample& sample = samples[i];
+        if (!sample.complete.load(std::memory_order_acquire)) {
+            continue;
+        }
+        // Root first: the active section, then the frames from the outermost caller in to the sampled instruction
+        std::string stack = sample.sectionId >= 0 ? "[" + foldedFrameName(registry->GetName(sample.sectionId)) + "]" : "[no section]";
+        for (int frame = sample.frameCount - 1; frame >= 0; frame--) {
+            // Return addresses point after the call, so look up the byte before to land inside the caller's line
+            char* address = static_cast<char*>(sample.frames[frame]) - (frame > 0 ? 1 : 0);
+            stack += ";" + foldedFrameName(symbolizer.Resolve(address));
+        }
+        stacks[stack]++;
+    }
+
+    for (const auto& entry : stacks) {
+        file << entry.first << " " << entry.second << "\n";
+    }
+    file.close();
+    std::cout << "Profiler samples written to " << fileName << " in folded stack format (" << sampleCount << " samples";
+    if (GetDroppedCount() > 0) {
+        std::cout << ", " << GetDroppedCount() << " dropped because the buffer was full";
+    }
+    std::cout << ").\n";
+}
+
+void ProfilerSampler::printSectionSummary() {
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    std::map<int, size_t> perSection;
+    size_t total = 0;
+    size_t sampleCount = GetSampleCount();
+    for (size_t i = 0; i < sampleCount; i++) {
+        if (samples[i].complete.load(std::memory_order_acquire)) {
+            perSection[samples[i].sectionId]++;
+            total++;
+        }
+    }
+    std::vector<std::pair<size_t, int>> ranked;
+    for (const auto& entry : perSection) {
+        ranked.emplace_back(entry.second, entry.first);
+    }
+    std::sort(ranked.rbegin(), ranked.rend());
+
+    std::cout << "Sampled CPU time by section (" << total << " samples):\n";
+    for (const auto& entry : ranked) {
+        std::cout << "  " << std::setw(6) << std::fixed << std::setprecision(2) << 100.0 * entry.first / total << "%  "
+                  << (entry.second >= 0 ? registry->GetName(entry.second) : "(outside any section)") << "\n";
+    }
+    std::cout << std::defaultfloat;
+}
+
+#else
+
+bool ProfilerSampler::Start(int, size_t) {
+    std::cerr << "The sampling profiler needs Linux (SIGPROF and setitimer)." << std::endl;
+    return false;
+}
+
+void ProfilerSampler::Stop() {}
+
+void ProfilerSampler::printSamplesToFolded(const char*) {
+    std::cerr << "The sampling profiler needs Linux (SIGPROF and setitimer)." << std::endl;
+}
+
+void ProfilerSampler::printSectionSummary() {}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+// ProfilerStackSample struct: One SIGPROF sample, written by the signal handler into a preallocated slot
+struct ProfilerStackSample {
+    static const int kMaxFrames = 48;
+
+    int sectionId;  // Innermost instrumented section active on the sampled thread, -1 if none
+    int frameCount;
+    void* frames[kMaxFrames];  // Interrupted instruction first, then return addresses outwards
+    std::atomic<bool> complete;  // Set last, so a reader never sees a half-written slot
+};
+
+// ProfilerSampler class: Statistical profiling without instrumentation. A process CPU-time timer
+// (setitimer ITIMER_PROF) raises SIGPROF on whichever thread is running; the handler records the
+// interrupted program counter, a short backtrace and the thread's innermost active profiler section into a
+// fixed array claimed slot by slot with an atomic counter, so it never allocates or locks. Symbols are only
+// resolved when the samples are written out, as folded stacks ("frame;frame;frame count") that flame graph
+// tools read directly, with the section as the root frame.
+//
+// CPU-time timers are checked on the kernel's scheduler tick, so rates above CONFIG_HZ (often 250 or 1000)
+// deliver fewer samples than asked for. Only one sampler can run at a time since SIGPROF is process-wide,
+// and it must be stopped before the Profiler is deleted. Linux only; elsewhere Start returns false.
+class ProfilerSampler {
+    public:
+        ProfilerSampler();
+        ~ProfilerSampler();
+
+        ProfilerSampler(const ProfilerSampler&) = delete;
+        ProfilerSampler& operator=(const ProfilerSampler&) = delete;
+
+        // Starts sampling at frequencyHz of CPU time, keeping at most maxSamples (later ones are counted as
+        // dropped). Returns false, after printing why, if the timer or handler can't be installed.
+        bool Start(int frequencyHz, size_t maxSamples);
+        void Stop();
+
+        size_t GetSampleCount() const;
+        size_t GetDroppedCount() const;
+
+        // Writes the samples as folded stacks, one line per distinct stack with its sample count
+        void printSamplesToFolded(const char* fileName);
+
+        // Prints how the samples split between profiler sections (and code outside any section)
+        void printSectionSummary();
+
+    private:
+        friend struct ProfilerSamplerSignal;  // The SIGPROF handler, in sampler.cpp
+
+        ProfilerStackSample* samples;
+        size_t capacity;
+        std::atomic<size_t> nextSample;
+        std::atomic<size_t> droppedSamples;
+        bool running;
+        static std::atomic<ProfilerSampler*> activeSampler;
+};
@@ -0,0 +1,217 @@
+#include "server.hpp"
+#include "profiler.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#define PROFILER_HAS_HTTP_SERVER 1
+#else
+#define PROFILER_HAS_HTTP_SERVER 0
+#endif
+
+static const int kMaxRequestBytes = 8192;
+static const int kAcceptPollMilliseconds = 200;  // How quickly Stop is noticed
+static const int kClientTimeoutSeconds = 2;      // A client that stalls mid-request is dropped after this long
+
+// Constructor for ProfilerHttpServer and Destructor
+ProfilerHttpServer::ProfilerHttpServer() : listenSocket(-1), port(0), stopping(false) {}
+ProfilerHttpServer::~ProfilerHttpServer() {
+    Stop();
+}
+
+int ProfilerHttpServer::GetPort() const {
+    return port;
+}
+
+#if PROFILER_HAS_HTTP_SERVER
+
+// sendAll: Writes the whole buffer, giving up if the client went away
+static bool sendAll(int clientSocket, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(clientSocket, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;  // Socket calls with a timeout aren't restarted after a signal (e.g. ProfilerSampler's SIGPROF)
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+// sendResponse: Sends a complete response; the connection is always closed afterwards
+static void sendResponse(int clientSocket, const char* status, const char* contentType, const std::string& body, bool headOnly, const char* extraHeaders = "") {
+    std::ostringstream header;
+    header << "HTTP/1.0 " << status << "\r\n"
+           << "Content-Type: " << contentType << "\r\n"
+           << "Content-Length: " << body.size() << "\r\n"
+           << "Cache-Control: no-store\r\n"
+           << "Connection: close\r\n"
+           << extraHeaders
+           << "\r\n";
+    std::string headerText = header.str();
+    if (sendAll(clientSocket, headerText.data(), headerText.size()) && !headOnly) {
+        sendAll(clientSocket, body.data(), body.size());
+    }
+}
+
+// contentTypeFor: MIME type from the file extension, for the handful of file types the dashboard uses
+static const char* contentTypeFor(const std::string& path) {
+    size_t dot = path.rfind('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot);
+    if (extension == ".html") return "text/html; charset=utf-8";
+    if (extension == ".js") return "text/javascript";
+    if (extension == ".css") return "text/css";
+    if (extension == ".json") return "application/json";
+    if (extension == ".csv") return "text/csv";
+    return "application/octet-stream";
+}
+
+// Start: Binds 127.0.0.1:port and starts the server thread
+bool ProfilerHttpServer::Start(int port, const char* documentRoot) {
+    Stop();
+
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0) {
+        std::cerr << "Failed to create the HTTP server socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);  // Never reachable from other machines
+    address.sin_port = htons(static_cast<unsigned short>(port));
+    if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(server, 16) < 0) {
+        std::cerr << "Failed to start the HTTP server on port " << port << ": " << std::strerror(errno) << std::endl;
+        close(server);
+        return false;
+    }
+
+    socklen_t addressLength = sizeof(address);
+    getsockname(server, reinterpret_cast<sockaddr*>(&address), &addressLength);
+    this->port = ntohs(address.sin_port);
+    this->documentRoot = documentRoot;
+    listenSocket = server;
+    stopping.store(false);
+    serverThread = std::thread(&ProfilerHttpServer::ServeLoop, this);
+    return true;
+}
+
+// Stop: Stops accepting, waits for the request in progress and closes the socket
+void ProfilerHttpServer::Stop() {
+    if (!serverThread.joinable()) {
+        return;
+    }
+    stopping.store(true);
+    serverThread.join();
+    close(listenSocket);
+    listenSocket = -1;
+}
+
+// ServeLoop: Waits for connections, waking up regularly to check whether Stop was called
+void ProfilerHttpServer::ServeLoop() {
+    while (!stopping.load()) {
+        pollfd listening = { listenSocket, POLLIN, 0 };
+        if (poll(&listening, 1, kAcceptPollMilliseconds) <= 0) {
+            continue;
+        }
+        int clientSocket = accept(listenSocket, nullptr, nullptr);
+        if (clientSocket < 0) {
+            continue;
+        }
+        timeval timeout = { kClientTimeoutSeconds, 0 };
+        setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(clientSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        HandleConnection(clientSocket);
+        close(clientSocket);
+    }
+}
+
+// HandleConnection: Reads the request line and headers, then answers GET and HEAD requests
+void ProfilerHttpServer::HandleConnection(int clientSocket) {
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < kMaxRequestBytes) {
+        ssize_t received = recv(clientSocket, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(received));
+    }
+
+    std::istringstream requestLine(request.substr(0, request.find("\r\n")));
+    std::string method;
+    std::string target;
+    requestLine >> method >> target;
+    bool headOnly = method == "HEAD";
+    if (method != "GET" && !headOnly) {
+        sendResponse(clientSocket, "405 Method Not Allowed", "text/plain", "Only GET and HEAD are supported\n", false, "Allow: GET, HEAD\r\n");
+        return;
+    }
+    std::string path = target.substr(0, target.find_first_of("?#"));
+
+    if (path == "/stats") {
+        std::ostringstream body;
+        Profiler::GetInstance()->printLiveStatsToJSON(body);
+        sendResponse(clientSocket, "200 OK", "application/json", body.str(), headOnly);
+    } else if (path == "/windows") {
+        std::ostringstream body;
+        Profiler::GetInstance()->printWindowsToJSON(body);
+        sendResponse(clientSocket, "200 OK", "application/json", body.str(), headOnly);
+    } else if (path == "/locks") {
+        std::ostringstream body;
+        Profiler::GetInstance()->printLocksToJSON(body);
+        sendResponse(clientSocket, "200 OK", "application/json", body.str(), headOnly);
+    } else if (path == "/") {
+        sendResponse(clientSocket, "302 Found", "text/plain", "", headOnly, "Location: /Code/index.html\r\n");
+    } else {
+        ServeFile(clientSocket, path, headOnly);
+    }
+}
+
+// ServeFile: Sends a file from under the document root; paths that try to climb out of it are refused
+void ProfilerHttpServer::ServeFile(int clientSocket, const std::string& path, bool headOnly) {
+    if (path.empty() || path[0] != '/' || path.find("..") != std::string::npos || path.find('\\') != std::string::npos) {
+        sendResponse(clientSocket, "403 Forbidden", "text/plain", "Forbidden\n", headOnly);
+        return;
+    }
+    std::ifstream file(documentRoot + path, std::ios::binary);
+    if (!file.is_open()) {
+        sendResponse(clientSocket, "404 Not Found", "text/plain", "Not found\n", headOnly);
+        return;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    sendResponse(clientSocket, "200 OK", contentTypeFor(path), contents.str(), headOnly);
+}
+
+#else
+
+bool ProfilerHttpServer::Start(int port, const char* documentRoot) {
+    std::cerr << "The built-in HTTP server needs POSIX sockets and isn't available on this platform." << std::endl;
+    return false;
+}
+
+void ProfilerHttpServer::Stop() {}
+void ProfilerHttpServer::ServeLoop() {}
+void ProfilerHttpServer::HandleConnection(int clientSocket) {}
+void ProfilerHttpServer::ServeFile(int clientSocket, const std::string& path, bool headOnly) {}
+
+#endif
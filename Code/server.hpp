@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// ProfilerHttpServer class: Minimal HTTP/1.0 server on a background thread, bound to 127.0.0.1 only.
+// GET /stats returns the live stats of Profiler::GetInstance() in the same JSON layout as printStatsToJSON,
+// GET /windows its window history (Profiler::printWindowsToJSON), GET /locks its lock contention (Profiler::printLocksToJSON);
+// any other path is served as a file under the document root ("/" redirects to the dashboard). Requests
+// are handled one at a time on the server thread, which is plenty for a dashboard polling once a second.
+class ProfilerHttpServer {
+    public:
+        ProfilerHttpServer();
+        ~ProfilerHttpServer();
+
+        ProfilerHttpServer(const ProfilerHttpServer&) = delete;
+        ProfilerHttpServer& operator=(const ProfilerHttpServer&) = delete;
+
+        // Starts listening, returning false (after printing why) if the port can't be bound. Port 0 picks a free one.
+        bool Start(int port, const char* documentRoot);
+        void Stop();
+
+        int GetPort() const;
+
+    private:
+        void ServeLoop();
+        void HandleConnection(int clientSocket);
+        void ServeFile(int clientSocket, const std::string& path, bool headOnly);
+
+        int listenSocket;
+        int port;
+        std::string documentRoot;
+        std::thread serverThread;
+        std::atomic<bool> stopping;
+};
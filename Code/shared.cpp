@@ -0,0 +1,285 @@
+#include "shared.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PROFILER_HAS_SHARED_STATS 1
+#else
+#define PROFILER_HAS_SHARED_STATS 0
+#endif
+
+static const unsigned kMaxSharedSections = ProfilerSectionRegistry::kMaxSections;
+
+// sectionsOf: The slots follow the header directly
+static ProfilerSharedSection* sectionsOf(ProfilerSharedHeader* header) {
+    return reinterpret_cast<ProfilerSharedSection*>(header + 1);
+}
+
+std::string getDefaultSharedStatsName(int processId) {
+    return "/profiler-" + std::to_string(processId);
+}
+
+// Constructor for ProfilerSharedWriter and Destructor
+ProfilerSharedWriter::ProfilerSharedWriter() : header(nullptr), regionBytes(0), seenRequests(0) {}
+ProfilerSharedWriter::~ProfilerSharedWriter() {
+    Close();
+}
+
+const std::string& ProfilerSharedWriter::GetName() const {
+    return name;
+}
+
+#if PROFILER_HAS_SHARED_STATS
+
+// Open: A fresh object sized for every possible section; pages of slots never written are never touched
+bool ProfilerSharedWriter::Open(const char* name) {
+    Close();
+    std::string objectName = name != nullptr ? name : getDefaultSharedStatsName(static_cast<int>(getpid()));
+    name = objectName.c_str();
+    std::atomic<double> probe(0.0);
+    if (!probe.is_lock_free() || !std::atomic<long long>().is_lock_free()) {
+        std::cerr << "Shared stats unavailable: this platform's atomics can't be shared between processes." << std::endl;
+        return false;
+    }
+
+    shm_unlink(name);  // Left behind by an earlier process with the same pid that didn't exit cleanly
+    int descriptor = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (descriptor < 0) {
+        std::cerr << "Failed to create shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    size_t bytes = sizeof(ProfilerSharedHeader) + kMaxSharedSections * sizeof(ProfilerSharedSection);
+    if (ftruncate(descriptor, static_cast<off_t>(bytes)) != 0) {
+        std::cerr << "Failed to size shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        close(descriptor);
+        shm_unlink(name);
+        return false;
+    }
+    void* region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (region == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        shm_unlink(name);
+        return false;
+    }
+
+    // A new object reads as zeros, which is already a valid empty slot (even sequence, no calls)
+    header = new (region) ProfilerSharedHeader();
+    std::memcpy(header->magic, kProfilerSharedMagic, sizeof(kProfilerSharedMagic));
+    header->headerBytes = sizeof(ProfilerSharedHeader);
+    header->sectionBytes = sizeof(ProfilerSharedSection);
+    header->maxSections = kMaxSharedSections;
+    header->processId = static_cast<int>(getpid());
+    header->version.store(kProfilerSharedVersion, std::memory_order_release);
+    this->name = name;
+    regionBytes = bytes;
+    seenRequests = 0;
+    return true;
+}
+
+void ProfilerSharedWriter::Close() {
+    if (header == nullptr) {
+        return;
+    }
+    header->closed.store(true, std::memory_order_release);
+    munmap(header, regionBytes);
+    shm_unlink(name.c_str());
+    header = nullptr;
+}
+
+#else
+
+bool ProfilerSharedWriter::Open(const char* name) {
+    std::cerr << "Shared stats unavailable: POSIX shared memory isn't supported on this platform." << std::endl;
+    return false;
+}
+
+void ProfilerSharedWriter::Close() {}
+
+#endif
+
+bool ProfilerSharedWriter::HasPendingRequest() {
+    if (header == nullptr) {
+        return false;
+    }
+    unsigned long long requests = header->readerRequests.load(std::memory_order_acquire);
+    if (requests == seenRequests) {
+        return false;
+    }
+    seenRequests = requests;
+    return true;
+}
+
+// Publish: Only this thread writes the slots, so it can compare against what it wrote last time without the seqlock
+void ProfilerSharedWriter::Publish(const ProfilerVector<ProfilerStats>& stats, double secondsSinceStart) {
+    if (header == nullptr) {
+        return;
+    }
+    ProfilerSharedSection* sections = sectionsOf(header);
+    int named = header->sectionCount.load(std::memory_order_relaxed);
+    int sectionCount = stats.size() < kMaxSharedSections ? static_cast<int>(stats.size()) : static_cast<int>(kMaxSharedSections);
+    for (int sectionId = named; sectionId < sectionCount; sectionId++) {
+        const char* sectionName = stats[sectionId].sectionName != nullptr ? stats[sectionId].sectionName : "";
+        std::strncpy(sections[sectionId].name, sectionName, ProfilerSharedSection::kNameBytes - 1);
+    }
+    if (sectionCount > named) {
+        header->sectionCount.store(sectionCount, std::memory_order_release);
+    }
+
+    for (int sectionId = 0; sectionId < sectionCount; sectionId++) {
+        const ProfilerStats& stat = stats[sectionId];
+        ProfilerSharedSection& slot = sections[sectionId];
+        if (stat.count == 0 || slot.count.load(std::memory_order_relaxed) == stat.count) {
+            continue;
+        }
+        unsigned sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.count.store(stat.count, std::memory_order_relaxed);
+        slot.outermostCount.store(stat.outermostCount, std::memory_order_relaxed);
+        slot.totalTime.store(stat.totalTime, std::memory_order_relaxed);
+        slot.selfTime.store(stat.selfTime, std::memory_order_relaxed);
+        slot.minTime.store(stat.minTime, std::memory_order_relaxed);
+        slot.maxTime.store(stat.maxTime, std::memory_order_relaxed);
+        slot.p50Time.store(stat.p50Time, std::memory_order_relaxed);
+        slot.p90Time.store(stat.p90Time, std::memory_order_relaxed);
+        slot.p99Time.store(stat.p99Time, std::memory_order_relaxed);
+        slot.allocatedBytes.store(stat.allocatedBytes, std::memory_order_relaxed);
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    header->publishSeconds.store(secondsSinceStart, std::memory_order_relaxed);
+    header->publishCount.fetch_add(1, std::memory_order_release);
+}
+
+// Constructor for ProfilerSharedReader and Destructor
+ProfilerSharedReader::ProfilerSharedReader() : header(nullptr), regionBytes(0) {}
+ProfilerSharedReader::~ProfilerSharedReader() {
+    Close();
+}
+
+#if PROFILER_HAS_SHARED_STATS
+
+// Open: Maps read-write, since asking for a publish means writing readerRequests
+bool ProfilerSharedReader::Open(const char* name) {
+    Close();
+    int descriptor = shm_open(name, O_RDWR, 0);
+    if (descriptor < 0) {
+        std::cerr << "Failed to open shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat info;
+    size_t bytes = fstat(descriptor, &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+    if (bytes < sizeof(ProfilerSharedHeader)) {
+        std::cerr << name << " is too small to be profiler shared stats." << std::endl;
+        close(descriptor);
+        return false;
+    }
+    void* region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (region == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    ProfilerSharedHeader* mapped = static_cast<ProfilerSharedHeader*>(region);
+    unsigned version = mapped->version.load(std::memory_order_acquire);
+    bool matches = std::memcmp(mapped->magic, kProfilerSharedMagic, sizeof(kProfilerSharedMagic)) == 0
+                   && version == kProfilerSharedVersion
+                   && mapped->headerBytes == sizeof(ProfilerSharedHeader)
+                   && mapped->sectionBytes == sizeof(ProfilerSharedSection)
+                   && sizeof(ProfilerSharedHeader) + static_cast<size_t>(mapped->maxSections) * sizeof(ProfilerSharedSection) <= bytes;
+    if (!matches) {
+        std::cerr << name << " is not profiler shared stats version " << kProfilerSharedVersion << " (found version " << version << ")." << std::endl;
+        munmap(region, bytes);
+        return false;
+    }
+    header = mapped;
+    regionBytes = bytes;
+    return true;
+}
+
+void ProfilerSharedReader::Close() {
+    if (header != nullptr) {
+        munmap(header, regionBytes);
+        header = nullptr;
+    }
+}
+
+#else
+
+bool ProfilerSharedReader::Open(const char* name) {
+    std::cerr << "Shared stats unavailable: POSIX shared memory isn't supported on this platform." << std::endl;
+    return false;
+}
+
+void ProfilerSharedReader::Close() {}
+
+#endif
+
+void ProfilerSharedReader::RequestPublish() {
+    header->readerRequests.fetch_add(1, std::memory_order_release);
+}
+
+unsigned long long ProfilerSharedReader::GetPublishCount() const {
+    return header->publishCount.load(std::memory_order_acquire);
+}
+
+double ProfilerSharedReader::GetPublishSeconds() const {
+    return header->publishSeconds.load(std::memory_order_relaxed);
+}
+
+int ProfilerSharedReader::GetProcessId() const {
+    return header->processId;
+}
+
+bool ProfilerSharedReader::IsClosed() const {
+    return header->closed.load(std::memory_order_acquire);
+}
+
+// ReadSections: The reader side of each slot's seqlock, retrying while the publisher is mid-write
+void ProfilerSharedReader::ReadSections(std::vector<ProfilerSharedSectionSnapshot>& sections) const {
+    sections.clear();
+    int sectionCount = header->sectionCount.load(std::memory_order_acquire);
+    if (sectionCount > static_cast<int>(header->maxSections)) {
+        sectionCount = static_cast<int>(header->maxSections);
+    }
+    const ProfilerSharedSection* slots = sectionsOf(header);
+    for (int sectionId = 0; sectionId < sectionCount; sectionId++) {
+        const ProfilerSharedSection& slot = slots[sectionId];
+        ProfilerSharedSectionSnapshot snapshot;
+        for (;;) {
+            unsigned before = slot.sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            snapshot.count = slot.count.load(std::memory_order_relaxed);
+            snapshot.outermostCount = slot.outermostCount.load(std::memory_order_relaxed);
+            snapshot.totalTime = slot.totalTime.load(std::memory_order_relaxed);
+            snapshot.selfTime = slot.selfTime.load(std::memory_order_relaxed);
+            snapshot.minTime = slot.minTime.load(std::memory_order_relaxed);
+            snapshot.maxTime = slot.maxTime.load(std::memory_order_relaxed);
+            snapshot.p50Time = slot.p50Time.load(std::memory_order_relaxed);
+            snapshot.p90Time = slot.p90Time.load(std::memory_order_relaxed);
+            snapshot.p99Time = slot.p99Time.load(std::memory_order_relaxed);
+            snapshot.allocatedBytes = slot.allocatedBytes.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+        if (snapshot.count == 0) {
+            continue;
+        }
+        snapshot.name.assign(slot.name, strnlen(slot.name, ProfilerSharedSection::kNameBytes));
+        sections.push_back(snapshot);
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+#include "profiler.hpp"
+
+using namespace std;
+
+// Shared-memory stats export, layout version 1. The Profiler maps a POSIX shared memory object (by default
+// /profiler-<pid>, see Profiler::OpenSharedStats) holding a ProfilerSharedHeader followed by maxSections
+// ProfilerSharedSection slots, and Tools/profiler_top maps the same object to watch a running process.
+//
+// Every slot is guarded by its own seqlock: the publisher makes the sequence odd, writes the fields and makes
+// it even again, and a reader copies the fields between two reads of the sequence, retrying if they differ or
+// were odd. Neither side ever blocks the other. All shared fields are lock-free atomics, which are address-free,
+// so the two processes may map the region at different addresses. A section's name is written once, before
+// sectionCount is raised to cover its slot, and never changes.
+//
+// Readers bump readerRequests every time they want fresh numbers; the publisher only drains and merges the
+// threads' stats when that counter moved, so a process nobody is watching pays for one wakeup per interval.
+static const char kProfilerSharedMagic[4] = { 'P', 'S', 'H', 'M' };
+static const unsigned kProfilerSharedVersion = 1;
+
+// ProfilerSharedHeader struct: Start of the region, describing the layout and the publisher's progress
+struct alignas(64) ProfilerSharedHeader {
+    char magic[4];
+    std::atomic<unsigned> version;   // Stored last (release) once the rest of the header is filled in
+    unsigned headerBytes;            // sizeof(ProfilerSharedHeader) and sizeof(ProfilerSharedSection) of the
+    unsigned sectionBytes;           // writer, so a reader built with another layout refuses the region
+    unsigned maxSections;
+    int processId;
+    std::atomic<int> sectionCount;   // Slots with a name, raised (release) after the names are written
+    std::atomic<unsigned long long> publishCount;
+    std::atomic<double> publishSeconds;  // Seconds since the Profiler was created, as of the last publish
+    std::atomic<unsigned long long> readerRequests;
+    std::atomic<bool> closed;        // The profiled process closed the region (or exited cleanly)
+};
+
+// ProfilerSharedSection struct: One section's merged stats, in seconds, under the slot's seqlock
+struct alignas(64) ProfilerSharedSection {
+    static const int kNameBytes = 64;  // Longer names are cut short
+
+    std::atomic<unsigned> sequence;  // Odd while the publisher is writing the fields below
+    char name[kNameBytes];
+    std::atomic<long long> count;
+    std::atomic<long long> outermostCount;  // Calls not nested in one of the same section, what totalTime covers
+    std::atomic<double> totalTime;
+    std::atomic<double> selfTime;
+    std::atomic<double> minTime;
+    std::atomic<double> maxTime;
+    std::atomic<double> p50Time;
+    std::atomic<double> p90Time;
+    std::atomic<double> p99Time;
+    std::atomic<long long> allocatedBytes;
+};
+
+// ProfilerSharedSectionSnapshot struct: A consistent copy of one slot, taken by ProfilerSharedReader
+struct ProfilerSharedSectionSnapshot {
+    std::string name;
+    long long count;
+    long long outermostCount;
+    double totalTime;
+    double selfTime;
+    double minTime;
+    double maxTime;
+    double p50Time;
+    double p90Time;
+    double p99Time;
+    long long allocatedBytes;
+};
+
+// ProfilerSharedWriter class: Creates the shared memory object and publishes merged stats into it
+class ProfilerSharedWriter {
+    public:
+        ProfilerSharedWriter();
+        ~ProfilerSharedWriter();
+
+        ProfilerSharedWriter(const ProfilerSharedWriter&) = delete;
+        ProfilerSharedWriter& operator=(const ProfilerSharedWriter&) = delete;
+
+        // Creates (or replaces) the object, named getDefaultSharedStatsName of this process if name is nullptr.
+        // Returns false after printing why if it can't be mapped. POSIX only; elsewhere this always fails.
+        bool Open(const char* name);
+        void Close();  // Marks the region closed and removes the object; readers that have it mapped keep the last numbers
+
+        // True if a reader asked for fresh numbers since the last call
+        bool HasPendingRequest();
+
+        // Writes every section whose call count changed since its last publish (stats indexed by section ID,
+        // already converted to seconds), then bumps publishCount
+        void Publish(const ProfilerVector<ProfilerStats>& stats, double secondsSinceStart);
+
+        const std::string& GetName() const;
+
+    private:
+        std::string name;
+        ProfilerSharedHeader* header;  // nullptr unless open
+        size_t regionBytes;
+        unsigned long long seenRequests;
+};
+
+// ProfilerSharedReader class: Maps another process's region and takes consistent copies of its slots
+class ProfilerSharedReader {
+    public:
+        ProfilerSharedReader();
+        ~ProfilerSharedReader();
+
+        ProfilerSharedReader(const ProfilerSharedReader&) = delete;
+        ProfilerSharedReader& operator=(const ProfilerSharedReader&) = delete;
+
+        // Maps an existing object, returning false after printing why if it is missing or has another layout
+        bool Open(const char* name);
+        void Close();
+
+        void RequestPublish();  // Asks the publisher for fresh numbers on its next interval
+        unsigned long long GetPublishCount() const;
+        double GetPublishSeconds() const;
+        int GetProcessId() const;
+        bool IsClosed() const;
+
+        // Copies every named slot that has been called at least once
+        void ReadSections(std::vector<ProfilerSharedSectionSnapshot>& sections) const;
+
+    private:
+        ProfilerSharedHeader* header;  // nullptr unless open
+        size_t regionBytes;
+};
+
+// getDefaultSharedStatsName: The object name Profiler::OpenSharedStats uses for a process, "/profiler-<pid>"
+std::string getDefaultSharedStatsName(int processId);
@@ -0,0 +1,348 @@
+#include "sorts.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const size_t kBlockElements = 16;          // What sortBlock16 sorts
+static const size_t kTileElements = 1 << 15;      // 128 KB of ints, merged while it stays in L2
+static const size_t kParallelMinimum = 1 << 14;   // Below this the threads cost more than they save
+
+// insertionSortRange: For the few elements after the last whole block
+static void insertionSortRange(int* data, size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        int key = data[i];
+        size_t j = i;
+        while (j > 0 && data[j - 1] > key) {
+            data[j] = data[j - 1];
+            j--;
+        }
+        data[j] = key;
+    }
+}
+
+#if defined(__SSE2__)
+// compareExchange: Lane by lane, leaves the smaller value in low and the larger in high
+static inline void compareExchange(__m128i& low, __m128i& high) {
+    __m128i swapMask = _mm_cmpgt_epi32(low, high);
+    __m128i difference = _mm_and_si128(_mm_xor_si128(low, high), swapMask);
+    low = _mm_xor_si128(low, difference);
+    high = _mm_xor_si128(high, difference);
+}
+#endif
+
+// sortBlock16: The 4-input network sorts the four columns of a 4x4 tile at once, a transpose turns the
+// columns into four sorted runs of four, and two rounds of merging finish the block
+void sortBlock16(int* data) {
+#if defined(__SSE2__)
+    __m128i row0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    __m128i row1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 4));
+    __m128i row2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 8));
+    __m128i row3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 12));
+    compareExchange(row0, row1);
+    compareExchange(row2, row3);
+    compareExchange(row0, row2);
+    compareExchange(row1, row3);
+    compareExchange(row1, row2);
+
+    __m128i low01 = _mm_unpacklo_epi32(row0, row1);
+    __m128i low23 = _mm_unpacklo_epi32(row2, row3);
+    __m128i high01 = _mm_unpackhi_epi32(row0, row1);
+    __m128i high23 = _mm_unpackhi_epi32(row2, row3);
+    int runs[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(runs), _mm_unpacklo_epi64(low01, low23));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(runs + 4), _mm_unpackhi_epi64(low01, low23));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(runs + 8), _mm_unpacklo_epi64(high01, high23));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(runs + 12), _mm_unpackhi_epi64(high01, high23));
+
+    int halves[16];
+    std::merge(runs, runs + 4, runs + 4, runs + 8, halves);
+    std::merge(runs + 8, runs + 12, runs + 12, runs + 16, halves + 8);
+    std::merge(halves, halves + 8, halves + 8, halves + 16, data);
+#else
+    insertionSortRange(data, kBlockElements);
+#endif
+}
+
+// mergePass: Merges each pair of neighbouring width-long runs in [begin, end) from source into target
+static void mergePass(const int* source, int* target, size_t begin, size_t end, size_t width) {
+    for (size_t left = begin; left < end; left += 2 * width) {
+        size_t middle = std::min(left + width, end);
+        size_t right = std::min(left + 2 * width, end);
+        std::merge(source + left, source + middle, source + middle, source + right, target + left);
+    }
+}
+
+// mergeSortRange: The cache-aware merge sort on raw memory, scratch holding at least count ints; the
+// sorted result always ends up back in data
+static void mergeSortRange(int* data, int* scratch, size_t count) {
+    PROFILER_ENTER_LEVEL(2, "Merge Sort: Block Sort");
+    size_t wholeBlocks = count / kBlockElements * kBlockElements;
+    for (size_t block = 0; block < wholeBlocks; block += kBlockElements) {
+        PROFILER_ENTER_SAMPLED("Merge Sort: Network Kernel", 256);
+        sortBlock16(data + block);
+        PROFILER_EXIT_SAMPLED("Merge Sort: Network Kernel");
+    }
+    insertionSortRange(data + wholeBlocks, count - wholeBlocks);
+    PROFILER_EXIT_LEVEL(2, "Merge Sort: Block Sort");
+
+    // Each tile is finished before the next is touched, so its merge passes run out of cache
+    PROFILER_ENTER_LEVEL(2, "Merge Sort: Tile Merge");
+    for (size_t tile = 0; tile < count; tile += kTileElements) {
+        size_t tileEnd = std::min(tile + kTileElements, count);
+        int* source = data;
+        int* target = scratch;
+        for (size_t width = kBlockElements; width < tileEnd - tile; width *= 2) {
+            mergePass(source, target, tile, tileEnd, width);
+            std::swap(source, target);
+        }
+        if (source != data) {
+            std::copy(source + tile, source + tileEnd, data + tile);
+        }
+    }
+    PROFILER_EXIT_LEVEL(2, "Merge Sort: Tile Merge");
+
+    PROFILER_ENTER_LEVEL(2, "Merge Sort: Global Merge");
+    int* source = data;
+    int* target = scratch;
+    for (size_t width = kTileElements; width < count; width *= 2) {
+        mergePass(source, target, 0, count, width);
+        std::swap(source, target);
+    }
+    if (source != data) {
+        std::copy(source, source + count, data);
+    }
+    PROFILER_EXIT_LEVEL(2, "Merge Sort: Global Merge");
+}
+
+void mergeSortCacheAware(std::vector<int>& arr) {
+    PROFILER_ENTER("Cache-Aware Merge Sort");
+    PROFILER_COUNT("Cache-Aware Merge Sort", "elements", arr.size());
+    std::vector<int> scratch(arr.size());
+    mergeSortRange(arr.data(), scratch.data(), arr.size());
+    PROFILER_EXIT("Cache-Aware Merge Sort");
+}
+
+// SortWorkerPool class: Worker threads kept for the life of the program, so a parallel sort neither pays to
+// start threads nor registers a new profiler buffer for every call. Tasks are handed out from a shared
+// counter, so a thread that finishes early just takes the next one.
+class SortWorkerPool {
+    public:
+        static SortWorkerPool* GetInstance();
+        ~SortWorkerPool();
+
+        // Runs task(0) to task(count - 1) on up to threadCount threads, the caller being one of them, and
+        // returns once all of them are done
+        void Run(int count, int threadCount, const std::function<void(int)>& task);
+
+    private:
+        SortWorkerPool();
+        void WorkerLoop(int workerIndex);
+        void RunTasks(const std::function<void(int)>& task, int count);
+
+        ProfiledMutex runMutex;  // One Run at a time
+        ProfiledMutex mutex;     // Guards everything below except the atomics
+        ProfiledConditionVariable wake;
+        ProfiledConditionVariable done;
+        std::vector<std::thread> workers;
+        const std::function<void(int)>* task;
+        int taskCount;
+        int wantedWorkers;
+        int busyWorkers;
+        unsigned long long runGeneration;
+        bool stopping;
+        std::atomic<int> nextTask;
+        std::atomic<int> finishedTasks;
+};
+
+// Worker pool singleton: Function-local static, the workers are joined when the program exits
+SortWorkerPool* SortWorkerPool::GetInstance() {
+    static SortWorkerPool pool;
+    return &pool;
+}
+
+// Constructor for SortWorkerPool and Destructor
+SortWorkerPool::SortWorkerPool()
+    : runMutex("Sort Pool: Run"), mutex("Sort Pool: State"), wake("Sort Pool: Wake"), done("Sort Pool: Done"),
+      task(nullptr), taskCount(0), wantedWorkers(0), busyWorkers(0), runGeneration(0), stopping(false), nextTask(0), finishedTasks(0) {}
+SortWorkerPool::~SortWorkerPool() {
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// RunTasks: Takes task indices until there are none left
+void SortWorkerPool::RunTasks(const std::function<void(int)>& task, int count) {
+    for (int index = nextTask.fetch_add(1); index < count; index = nextTask.fetch_add(1)) {
+        task(index);
+        finishedTasks.fetch_add(1);
+    }
+}
+
+void SortWorkerPool::Run(int count, int threadCount, const std::function<void(int)>& task) {
+    std::lock_guard<ProfiledMutex> runLock(runMutex);
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex);
+        int helpers = std::max(0, std::min(threadCount, count) - 1);
+        while (static_cast<int>(workers.size()) < helpers) {
+            workers.emplace_back(&SortWorkerPool::WorkerLoop, this, static_cast<int>(workers.size()));
+        }
+        this->task = &task;
+        taskCount = count;
+        wantedWorkers = helpers;
+        nextTask.store(0);
+        finishedTasks.store(0);
+        runGeneration++;
+    }
+    wake.notify_all();
+
+    RunTasks(task, count);
+
+    // Workers that woke up late must be out of the task before it goes out of scope
+    std::unique_lock<ProfiledMutex> lock(mutex);
+    done.wait(lock, [this, count] { return finishedTasks.load() == count && busyWorkers == 0; });
+    this->task = nullptr;
+}
+
+// WorkerLoop: Sleeps until a Run wants this worker, then helps with its tasks
+void SortWorkerPool::WorkerLoop(int workerIndex) {
+    unsigned long long seenGeneration = 0;
+    std::unique_lock<ProfiledMutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this, &seenGeneration] { return stopping || runGeneration != seenGeneration; });
+        if (stopping) {
+            return;
+        }
+        seenGeneration = runGeneration;
+        if (workerIndex >= wantedWorkers || task == nullptr) {
+            continue;
+        }
+        const std::function<void(int)>* runTask = task;
+        int count = taskCount;
+        busyWorkers++;
+        lock.unlock();
+        RunTasks(*runTask, count);
+        lock.lock();
+        busyWorkers--;
+        done.notify_all();
+    }
+}
+
+void parallelMergeSort(std::vector<int>& arr, int threadCount) {
+    PROFILER_ENTER("Parallel Merge Sort");
+    size_t count = arr.size();
+    PROFILER_COUNT("Parallel Merge Sort", "elements", count);
+    std::vector<int> scratch(count);
+    int* data = arr.data();
+    if (threadCount <= 1 || count < kParallelMinimum) {
+        mergeSortRange(data, scratch.data(), count);
+        PROFILER_EXIT("Parallel Merge Sort");
+        return;
+    }
+
+    std::vector<size_t> bounds(threadCount + 1);
+    for (int chunk = 0; chunk <= threadCount; chunk++) {
+        bounds[chunk] = count * chunk / threadCount;
+    }
+    SortWorkerPool* pool = SortWorkerPool::GetInstance();
+
+    // Each chunk is an async span from being queued here until its sort finishes on whichever thread took it,
+    // so the time the workers take to wake up and reach it shows as the span's queueing delay
+    PROFILER_ENTER_LEVEL(2, "Parallel Sort: Chunk Sorts");
+    std::vector<ProfilerAsyncSpan> chunkSpans(threadCount);
+    for (int chunk = 0; chunk < threadCount; chunk++) {
+        PROFILER_ASYNC_BEGIN_LEVEL(2, chunkSpans[chunk], "Parallel Sort: Chunk Task");
+        PROFILER_ASYNC_HAND_OFF(chunkSpans[chunk]);
+    }
+    pool->Run(threadCount, threadCount, [&](int chunk) {
+        PROFILER_ASYNC_RESUME(chunkSpans[chunk]);
+        {
+            PROFILE_SCOPE_LEVEL(2, "Parallel Sort: Chunk Sort");
+            mergeSortRange(data + bounds[chunk], scratch.data() + bounds[chunk], bounds[chunk + 1] - bounds[chunk]);
+        }
+        PROFILER_ASYNC_END(chunkSpans[chunk]);
+    });
+    PROFILER_EXIT_LEVEL(2, "Parallel Sort: Chunk Sorts");
+
+    // Every round merges neighbouring pairs of sorted runs, all pairs at once, until one run is left
+    PROFILER_ENTER_LEVEL(2, "Parallel Sort: Merge Rounds");
+    int* source = data;
+    int* target = scratch.data();
+    for (int width = 1; width < threadCount; width *= 2) {
+        int pairs = (threadCount + 2 * width - 1) / (2 * width);
+        pool->Run(pairs, threadCount, [&](int pair) {
+            PROFILE_SCOPE_LEVEL(2, "Parallel Sort: Merge Pair");
+            int left = pair * 2 * width;
+            int middle = std::min(left + width, threadCount);
+            int right = std::min(left + 2 * width, threadCount);
+            std::merge(source + bounds[left], source + bounds[middle], source + bounds[middle], source + bounds[right], target + bounds[left]);
+        });
+        std::swap(source, target);
+    }
+    if (source != data) {
+        arr.swap(scratch);
+    }
+    PROFILER_EXIT_LEVEL(2, "Parallel Sort: Merge Rounds");
+    PROFILER_EXIT("Parallel Merge Sort");
+}
+
+void radixSortLSD(std::vector<int>& arr) {
+    PROFILER_ENTER("LSD Radix Sort");
+    size_t count = arr.size();
+    PROFILER_COUNT("LSD Radix Sort", "elements", count);
+    if (count < 2) {
+        PROFILER_EXIT("LSD Radix Sort");
+        return;
+    }
+
+    // One pass counts all four digits
+    PROFILER_ENTER_LEVEL(2, "Radix Sort: Histogram");
+    std::vector<size_t> counts(4 * 256, 0);
+    for (int value : arr) {
+        unsigned key = static_cast<unsigned>(value) ^ 0x80000000u;
+        counts[key & 0xff]++;
+        counts[256 + ((key >> 8) & 0xff)]++;
+        counts[512 + ((key >> 16) & 0xff)]++;
+        counts[768 + (key >> 24)]++;
+    }
+    PROFILER_EXIT_LEVEL(2, "Radix Sort: Histogram");
+
+    PROFILER_ENTER_LEVEL(2, "Radix Sort: Scatter Passes");
+    std::vector<int> scratch(count);
+    int* source = arr.data();
+    int* target = scratch.data();
+    for (int digit = 0; digit < 4; digit++) {
+        size_t* digitCounts = &counts[256 * digit];
+        unsigned shift = 8 * digit;
+        unsigned firstDigit = ((static_cast<unsigned>(source[0]) ^ 0x80000000u) >> shift) & 0xff;
+        if (digitCounts[firstDigit] == count) {
+            continue;  // Every key has the same digit here, the pass would only copy
+        }
+        size_t offsets[256];
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++) {
+            offsets[bucket] = offset;
+            offset += digitCounts[bucket];
+        }
+        for (size_t i = 0; i < count; i++) {
+            unsigned key = static_cast<unsigned>(source[i]) ^ 0x80000000u;
+            target[offsets[(key >> shift) & 0xff]++] = source[i];
+        }
+        PROFILER_COUNT_LEVEL(2, "Radix Sort: Scatter Passes", "bytes", 2 * count * sizeof(int));  // Every key read and written once
+        std::swap(source, target);
+    }
+    if (source != arr.data()) {
+        arr.swap(scratch);
+    }
+    PROFILER_EXIT_LEVEL(2, "Radix Sort: Scatter Passes");
+    PROFILER_EXIT("LSD Radix Sort");
+}
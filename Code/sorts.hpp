@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+// Sort engines for inputs far beyond what the insertion sorts in main.cpp can handle, instrumented like
+// them (one level-1 section per sort, level-2 sections per phase) so the dashboard and the benchmark
+// harness compare them on the same terms. All of them sort ascending in place and are O(n log n) or better.
+
+// sortBlock16: Sorts 16 ints with a sorting network, four lanes at a time with SSE2 where available.
+// The merge sorts use it for their smallest partitions.
+void sortBlock16(int* data);
+
+// mergeSortCacheAware: Bottom-up merge sort that sorts 16-element blocks with sortBlock16, merges them into
+// tiles small enough to stay in L2 while they are merged, and only then merges tiles across the whole array
+void mergeSortCacheAware(std::vector<int>& arr);
+
+// parallelMergeSort: Splits the array into one chunk per thread, sorts the chunks like mergeSortCacheAware on
+// a persistent pool of worker threads (so each worker keeps one profiler buffer across sorts), then merges
+// pairs of chunks in parallel rounds. Falls back to mergeSortCacheAware for one thread or small inputs.
+void parallelMergeSort(std::vector<int>& arr, int threadCount);
+
+// radixSortLSD: Least-significant-digit radix sort over the int keys, 8 bits per pass with the sign bit
+// flipped so negative keys order correctly. Passes whose digit is the same for every key are skipped, so
+// the 0-9999 keys of generateBenchmarkInput take two passes instead of four.
+void radixSortLSD(std::vector<int>& arr);
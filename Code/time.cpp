@@ -1,9 +1,185 @@
 #include "time.hpp"
 #include <chrono>
+#include <ctime>
+#include <mutex>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define PROFILER_HAS_TSC 1
+#else
+#define PROFILER_HAS_TSC 0
+#endif
+
+// Active backend and the seconds per tick of each backend. Until InitializeClock runs, the chrono
+// backend is used, so the clock is usable even from static initializers in other translation units.
+static ProfilerClockBackend gClockBackend = CLOCK_BACKEND_CHRONO;
+static double gSecondsPerTick[CLOCK_BACKEND_COUNT] = {
+    static_cast<double>(std::chrono::steady_clock::period::num) / std::chrono::steady_clock::period::den,
+    1e-9,
+    0.0  // Filled in by calibration
+};
+static bool gTscAvailable = false;
 
 double GetCurrentTimeSeconds()
 {
     static auto start = std::chrono::high_resolution_clock::now();
     auto now = std::chrono::high_resolution_clock::now();
     return std::chrono::duration_cast<std::chrono::duration<double>>(now - start).count();
-} 
+}
+
+// readChrono, readMonotonicRaw, readTsc: One raw reading from each backend
+static inline ProfilerTicks readChrono() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+static inline ProfilerTicks readMonotonicRaw() {
+#if defined(CLOCK_MONOTONIC_RAW)
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return static_cast<ProfilerTicks>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+#else
+    return readChrono();
+#endif
+}
+
+static inline ProfilerTicks readTsc() {
+#if PROFILER_HAS_TSC
+    return static_cast<ProfilerTicks>(__rdtsc());
+#else
+    return readChrono();
+#endif
+}
+
+// hasInvariantTsc: The TSC is only usable as a clock if it ticks at a constant rate across
+// frequency changes and sleep states (CPUID leaf 0x80000007, EDX bit 8)
+static bool hasInvariantTsc() {
+#if PROFILER_HAS_TSC && defined(_MSC_VER)
+    int registers[4];
+    __cpuid(registers, 0x80000000);
+    if (static_cast<unsigned>(registers[0]) < 0x80000007u) {
+        return false;
+    }
+    __cpuid(registers, 0x80000007);
+    return (registers[3] & (1 << 8)) != 0;
+#elif PROFILER_HAS_TSC
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return (edx & (1u << 8)) != 0;
+#else
+    return false;
+#endif
+}
+
+// calibrateTsc: Measures the TSC rate against steady_clock over a short busy-wait
+static double calibrateTsc() {
+    const std::chrono::milliseconds calibrationTime(20);
+    auto wallStart = std::chrono::steady_clock::now();
+    ProfilerTicks tscStart = readTsc();
+    std::chrono::steady_clock::time_point wallStop;
+    do {
+        wallStop = std::chrono::steady_clock::now();
+    } while (wallStop - wallStart < calibrationTime);
+    ProfilerTicks tscStop = readTsc();
+
+    double seconds = std::chrono::duration<double>(wallStop - wallStart).count();
+    return seconds / static_cast<double>(tscStop - tscStart);
+}
+
+void InitializeClock() {
+    static std::once_flag initialized;
+    std::call_once(initialized, []() {
+        if (hasInvariantTsc()) {
+            gSecondsPerTick[CLOCK_BACKEND_TSC] = calibrateTsc();
+            gTscAvailable = gSecondsPerTick[CLOCK_BACKEND_TSC] > 0.0;
+        }
+        if (gTscAvailable) {
+            gClockBackend = CLOCK_BACKEND_TSC;
+        } else if (IsClockBackendAvailable(CLOCK_BACKEND_MONOTONIC_RAW)) {
+            gClockBackend = CLOCK_BACKEND_MONOTONIC_RAW;
+        }
+    });
+}
+
+ProfilerTicks GetCurrentTicks() {
+    switch (gClockBackend) {
+        case CLOCK_BACKEND_TSC:
+            return readTsc();
+        case CLOCK_BACKEND_MONOTONIC_RAW:
+            return readMonotonicRaw();
+        default:
+            return readChrono();
+    }
+}
+
+double TicksToSeconds(ProfilerTicks ticks) {
+    return ticks * gSecondsPerTick[gClockBackend];
+}
+
+ProfilerTicks SecondsToTicks(double seconds) {
+    return static_cast<ProfilerTicks>(seconds / gSecondsPerTick[gClockBackend]);
+}
+
+bool IsClockBackendAvailable(ProfilerClockBackend backend) {
+    switch (backend) {
+        case CLOCK_BACKEND_CHRONO:
+            return true;
+        case CLOCK_BACKEND_MONOTONIC_RAW:
+#if defined(CLOCK_MONOTONIC_RAW)
+            return true;
+#else
+            return false;
+#endif
+        case CLOCK_BACKEND_TSC:
+            InitializeClock();
+            return gTscAvailable;
+        default:
+            return false;
+    }
+}
+
+bool SetClockBackend(ProfilerClockBackend backend) {
+    InitializeClock();
+    if (!IsClockBackendAvailable(backend)) {
+        return false;
+    }
+    gClockBackend = backend;
+    return true;
+}
+
+ProfilerClockBackend GetClockBackend() {
+    return gClockBackend;
+}
+
+const char* GetClockBackendName(ProfilerClockBackend backend) {
+    switch (backend) {
+        case CLOCK_BACKEND_CHRONO:
+            return "steady_clock";
+        case CLOCK_BACKEND_MONOTONIC_RAW:
+            return "CLOCK_MONOTONIC_RAW";
+        case CLOCK_BACKEND_TSC:
+            return "rdtsc";
+        default:
+            return "unknown";
+    }
+}
+
+double GetClockSecondsPerTick(ProfilerClockBackend backend) {
+    return gSecondsPerTick[backend];
+}
+
+ProfilerTicks ReadClockTicks(ProfilerClockBackend backend) {
+    switch (backend) {
+        case CLOCK_BACKEND_TSC:
+            return readTsc();
+        case CLOCK_BACKEND_MONOTONIC_RAW:
+            return readMonotonicRaw();
+        default:
+            return readChrono();
+    }
+}
@@ -1,4 +1,37 @@
 #pragma once
 
 using namespace std;
+
+// Raw clock reading, only meaningful relative to another reading from the same backend
+typedef long long ProfilerTicks;
+
+// Clock backends the profiler can read on its hot path
+enum ProfilerClockBackend {
+    CLOCK_BACKEND_CHRONO,         // std::chrono::steady_clock, available everywhere
+    CLOCK_BACKEND_MONOTONIC_RAW,  // clock_gettime(CLOCK_MONOTONIC_RAW), Linux only, immune to NTP slewing
+    CLOCK_BACKEND_TSC,            // rdtsc, x86 with an invariant TSC only, calibrated against the other clocks
+    CLOCK_BACKEND_COUNT
+};
+
 double GetCurrentTimeSeconds();
+
+// Picks the cheapest available backend and calibrates it (called by the Profiler constructor, safe to repeat)
+void InitializeClock();
+
+// Reads the active backend; the only clock call made while recording sections
+ProfilerTicks GetCurrentTicks();
+
+// Converts a tick count from the active backend to seconds (done when stats are reported, not while recording)
+double TicksToSeconds(ProfilerTicks ticks);
+ProfilerTicks SecondsToTicks(double seconds);
+
+// Backend selection: switching only makes sense before any sections are recorded, since ticks from
+// different backends cannot be compared. SetClockBackend returns false if the backend is unavailable.
+bool IsClockBackendAvailable(ProfilerClockBackend backend);
+bool SetClockBackend(ProfilerClockBackend backend);
+ProfilerClockBackend GetClockBackend();
+const char* GetClockBackendName(ProfilerClockBackend backend);
+double GetClockSecondsPerTick(ProfilerClockBackend backend);
+
+// Reads a specific backend regardless of which one is active (for benchmarking the backends against each other)
+ProfilerTicks ReadClockTicks(ProfilerClockBackend backend);
@@ -0,0 +1,180 @@
+#include "trace.hpp"
+#include "registry.hpp"
+#include "report.hpp"
+#include <string>
+#include <vector>
+
+// Constructor for ProfilerTraceBuffer and Destructor
+ProfilerTraceBuffer::ProfilerTraceBuffer(size_t capacity, ProfilerTracePolicy policy)
+    : recording(true),
+      events(newProfilerArenaArray<ProfilerTraceEvent>(capacity)),
+      capacity(capacity),
+      policy(policy),
+      written(0),
+      dropped(0),
+      asyncEvents(nullptr),
+      asyncCapacity(capacity / 8),
+      asyncWritten(0) {
+    try {
+        asyncEvents = newProfilerArenaArray<ProfilerAsyncTraceEvent>(asyncCapacity);
+    } catch (...) {
+        deleteProfilerArenaArray(events, capacity);  // The destructor doesn't run for a constructor that throws
+        throw;
+    }
+}
+ProfilerTraceBuffer::~ProfilerTraceBuffer() {
+    deleteProfilerArenaArray(events, capacity);
+    deleteProfilerArenaArray(asyncEvents, asyncCapacity);
+}
+
+void* ProfilerTraceBuffer::operator new(size_t size) {
+    return ProfilerArenaAllocator<char>().allocate(size);
+}
+void ProfilerTraceBuffer::operator delete(void* block, size_t size) {
+    ProfilerArena::GetInstance()->Deallocate(block, size);
+}
+
+// claimSlot: Where a log's next event goes under the policy, or false (counting the event as dropped) if nowhere
+static bool claimSlot(unsigned long long& written, size_t capacity, ProfilerTracePolicy policy, unsigned long long& dropped, size_t& slot) {
+    if (capacity == 0) {
+        return false;
+    }
+    if (written >= capacity && policy == TRACE_POLICY_STOP_WHEN_FULL) {
+        dropped++;
+        return false;
+    }
+    slot = static_cast<size_t>(written % capacity);
+    written++;
+    return true;
+}
+
+// oldestSlot: Index of a log's oldest event still held
+static size_t oldestSlot(unsigned long long written, size_t capacity) {
+    return written > capacity ? static_cast<size_t>(written % capacity) : 0;
+}
+
+// Record: Stores an event according to the buffer's policy
+void ProfilerTraceBuffer::Record(const ProfilerTraceEvent& event) {
+    size_t slot;
+    if (recording && claimSlot(written, capacity, policy, dropped, slot)) {
+        events[slot] = event;
+    }
+}
+
+void ProfilerTraceBuffer::RecordAsync(const ProfilerAsyncTraceEvent& event) {
+    size_t slot;
+    if (recording && claimSlot(asyncWritten, asyncCapacity, policy, dropped, slot)) {
+        asyncEvents[slot] = event;
+    }
+}
+
+size_t ProfilerTraceBuffer::Size() const {
+    return written < capacity ? static_cast<size_t>(written) : capacity;
+}
+
+const ProfilerTraceEvent& ProfilerTraceBuffer::Get(size_t index) const {
+    return events[(oldestSlot(written, capacity) + index) % capacity];
+}
+
+size_t ProfilerTraceBuffer::AsyncSize() const {
+    return asyncWritten < asyncCapacity ? static_cast<size_t>(asyncWritten) : asyncCapacity;
+}
+
+const ProfilerAsyncTraceEvent& ProfilerTraceBuffer::GetAsync(size_t index) const {
+    return asyncEvents[(oldestSlot(asyncWritten, asyncCapacity) + index) % asyncCapacity];
+}
+
+unsigned long long ProfilerTraceBuffer::GetDroppedCount() const {
+    return dropped;
+}
+
+unsigned long long ProfilerTraceBuffer::GetOverwrittenCount() const {
+    return (written > capacity ? written - capacity : 0) + (asyncWritten > asyncCapacity ? asyncWritten - asyncCapacity : 0);
+}
+
+// writeTraceEventPrefix: Fields shared by every event a thread writes
+static void writeTraceEventPrefix(std::ofstream& file, int threadId, int sectionId, bool& first) {
+    if (!first) {
+        file << ",\n";
+    }
+    first = false;
+    file << "    {\"name\": ";
+    writeJSONString(file, ProfilerSectionRegistry::GetInstance()->GetName(sectionId));
+    file << ", \"cat\": \"section\", \"pid\": 1, \"tid\": " << threadId;
+}
+
+// writeAsyncTraceEvent: One async or flow event of a span, every step of a span sharing its ID. Always follows
+// the thread's name event, so it never starts the array.
+static void writeAsyncTraceEvent(std::ofstream& file, int threadId, const ProfilerAsyncTraceEvent& event, const char* name,
+                                 const char* category, const char* phase, ProfilerTicks originTicks) {
+    file << ",\n    {\"name\": ";
+    writeJSONString(file, name);
+    file << ", \"cat\": \"" << category << "\", \"ph\": \"" << phase << "\", \"id\": \"" << event.spanId
+         << "\", \"pid\": 1, \"tid\": " << threadId << ", \"ts\": " << 1e6 * TicksToSeconds(event.ticks - originTicks);
+    if (phase[0] == 'f') {
+        file << ", \"bp\": \"e\"";  // Bind to the slice the resuming thread is in, not the next one it starts
+    }
+    file << "}";
+}
+
+void writeChromeTraceEvents(std::ofstream& file, int threadId, const ProfilerTraceBuffer& trace, ProfilerTicks originTicks, bool& first) {
+    if (!first) {
+        file << ",\n";
+    }
+    first = false;
+    file << "    {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << threadId
+         << ", \"args\": {\"name\": \"Thread " << threadId << "\"}}";
+
+    // Timestamps are in microseconds, with the fractional part keeping sub-microsecond sections visible
+    std::vector<size_t> openEvents;
+    for (size_t i = 0; i < trace.Size(); i++) {
+        const ProfilerTraceEvent& event = trace.Get(i);
+        if (event.isEnter) {
+            openEvents.push_back(i);
+            continue;
+        }
+
+        // Match with the innermost open enter of the same section, like DrainBuffer does
+        size_t depth = openEvents.size();
+        while (depth > 0 && trace.Get(openEvents[depth - 1]).sectionId != event.sectionId) {
+            depth--;
+        }
+        if (depth == 0) {
+            continue;
+        }
+        const ProfilerTraceEvent& enter = trace.Get(openEvents[depth - 1]);
+        openEvents.resize(depth - 1);
+
+        writeTraceEventPrefix(file, threadId, event.sectionId, first);
+        file << ", \"ph\": \"X\", \"ts\": " << 1e6 * TicksToSeconds(enter.ticks - originTicks)
+             << ", \"dur\": " << 1e6 * TicksToSeconds(event.ticks - enter.ticks) << "}";
+    }
+
+    for (size_t index : openEvents) {
+        const ProfilerTraceEvent& enter = trace.Get(index);
+        writeTraceEventPrefix(file, threadId, enter.sectionId, first);
+        file << ", \"ph\": \"B\", \"ts\": " << 1e6 * TicksToSeconds(enter.ticks - originTicks) << "}";
+    }
+
+    // The steps of one span land in the traces of whichever threads took them; the viewer pairs them up by ID
+    for (size_t i = 0; i < trace.AsyncSize(); i++) {
+        const ProfilerAsyncTraceEvent& event = trace.GetAsync(i);
+        const char* name = ProfilerSectionRegistry::GetInstance()->GetName(event.sectionId);
+        switch (event.phase) {
+            case ASYNC_PHASE_BEGIN:
+                writeAsyncTraceEvent(file, threadId, event, name, "async", "b", originTicks);
+                break;
+            case ASYNC_PHASE_HAND_OFF:
+                writeAsyncTraceEvent(file, threadId, event, "Queued", "async", "b", originTicks);
+                writeAsyncTraceEvent(file, threadId, event, name, "hand-off", "s", originTicks);
+                break;
+            case ASYNC_PHASE_RESUME:
+                writeAsyncTraceEvent(file, threadId, event, name, "hand-off", "f", originTicks);
+                writeAsyncTraceEvent(file, threadId, event, "Queued", "async", "e", originTicks);
+                break;
+            case ASYNC_PHASE_END:
+                writeAsyncTraceEvent(file, threadId, event, name, "async", "e", originTicks);
+                break;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <fstream>
+#include "time.hpp"
+#include "arena.hpp"
+
+using namespace std;
+
+// What a trace buffer does once it has no free slots left
+enum ProfilerTracePolicy {
+    TRACE_POLICY_STOP_WHEN_FULL,  // Keep the first events, drop (and count) everything after
+    TRACE_POLICY_RING_OVERWRITE   // Keep the most recent events, overwriting the oldest
+};
+
+// ProfilerTraceEvent struct: One enter or exit, 16 bytes
+struct ProfilerTraceEvent {
+    ProfilerTicks ticks;
+    int sectionId;
+    unsigned short threadId;
+    unsigned char isEnter;
+};
+
+// Steps of an async span (ProfilerAsyncSpan) kept in the trace of the thread that took them
+enum ProfilerAsyncPhase {
+    ASYNC_PHASE_BEGIN,
+    ASYNC_PHASE_HAND_OFF,
+    ASYNC_PHASE_RESUME,
+    ASYNC_PHASE_END
+};
+
+// ProfilerAsyncTraceEvent struct: One step of an async span, 24 bytes
+struct ProfilerAsyncTraceEvent {
+    ProfilerTicks ticks;
+    unsigned long long spanId;
+    int sectionId;
+    unsigned short threadId;
+    unsigned char phase;  // ProfilerAsyncPhase
+};
+
+// ProfilerTraceBuffer class: Fixed-capacity event log for one thread, allocated up front (from the
+// ProfilerArena, throwing std::bad_alloc if it doesn't fit) so recording never allocates. Async span steps
+// get a separate log with an eighth of the slots, under the same policy.
+class ProfilerTraceBuffer {
+    public:
+        ProfilerTraceBuffer(size_t capacity, ProfilerTracePolicy policy);
+        ~ProfilerTraceBuffer();
+
+        ProfilerTraceBuffer(const ProfilerTraceBuffer&) = delete;
+        ProfilerTraceBuffer& operator=(const ProfilerTraceBuffer&) = delete;
+
+        static void* operator new(size_t size);
+        static void operator delete(void* block, size_t size);
+
+        void Record(const ProfilerTraceEvent& event);
+        void RecordAsync(const ProfilerAsyncTraceEvent& event);
+
+        // Events still held, oldest first
+        size_t Size() const;
+        const ProfilerTraceEvent& Get(size_t index) const;
+        size_t AsyncSize() const;
+        const ProfilerAsyncTraceEvent& GetAsync(size_t index) const;
+
+        unsigned long long GetDroppedCount() const;      // Lost to TRACE_POLICY_STOP_WHEN_FULL, from both logs
+        unsigned long long GetOverwrittenCount() const;  // Lost to TRACE_POLICY_RING_OVERWRITE, from both logs
+
+        bool recording;  // Cleared by Profiler::DisableTrace, the recorded events stay exportable
+
+    private:
+        ProfilerTraceEvent* events;
+        size_t capacity;
+        ProfilerTracePolicy policy;
+        unsigned long long written;  // Every event accepted, including ones since overwritten
+        unsigned long long dropped;
+        ProfilerAsyncTraceEvent* asyncEvents;
+        size_t asyncCapacity;
+        unsigned long long asyncWritten;
+};
+
+// writeChromeTraceEvents: Appends one thread's trace to a Chrome Trace Event "traceEvents" array. Matched
+// enter/exit pairs become complete ("X") events; sections still open at the end become begin ("B") events,
+// and exits whose enter was overwritten are skipped. Async spans become nestable async begin/end ("b"/"e")
+// events keyed by span ID, with each hand-off shown as a nested "Queued" span and a flow arrow ("s" to "f")
+// from the thread that handed it off to the one that resumed it.
+void writeChromeTraceEvents(std::ofstream& file, int threadId, const ProfilerTraceBuffer& trace, ProfilerTicks originTicks, bool& first);
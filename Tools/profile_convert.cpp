@@ -0,0 +1,292 @@
+#include "binary.hpp"
+#include "report.hpp"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Reads one or more binary profiles written by Profiler::OpenBinaryOutput and writes the same CSV/JSON
+// reports the Profiler writes itself. With several inputs the sections are merged by name into the "all"
+// rows, and each file's threads are listed as <file number>:<thread ID>.
+//
+//   profile_convert [--csv stats.csv] [--json stats.json] [--calltree calltree.csv] input.prof [more.prof ...]
+//
+// With no output options the stats CSV is written to standard output.
+
+// ProfileConvertThread struct: One input thread's stats and call tree, remapped to this process's section IDs
+struct ProfileConvertThread {
+    std::string label;
+    ProfilerVector<ProfilerStats> stats;
+    ProfilerVector<ProfilerCallNode> callTree;
+};
+
+static void printUsage() {
+    std::cerr << "Usage: profile_convert [--csv FILE] [--json FILE] [--calltree FILE] INPUT.prof [INPUT.prof ...]" << std::endl;
+}
+
+// statsFor: Returns the stats slot for a section, growing the array with the registry's names as needed
+static ProfilerStats& statsFor(ProfilerVector<ProfilerStats>& stats, int sectionId) {
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    while (static_cast<int>(stats.size()) <= sectionId) {
+        stats.emplace_back(registry->GetName(static_cast<int>(stats.size())));
+    }
+    return stats[sectionId];
+}
+
+// rescaleTicks: Converts a tick count from one file's clock to the output's
+static ProfilerTicks rescaleTicks(ProfilerTicks ticks, double factor) {
+    return static_cast<ProfilerTicks>(ticks * factor + 0.5);
+}
+
+// rescaleStats: Converts raw stats to another tick length, moving every histogram bucket's count to the
+// bucket its midpoint lands in
+static void rescaleStats(ProfilerStats& stat, double factor) {
+    stat.totalTicks = rescaleTicks(stat.totalTicks, factor);
+    stat.minTicks = rescaleTicks(stat.minTicks, factor);
+    stat.maxTicks = rescaleTicks(stat.maxTicks, factor);
+    stat.selfTicks = rescaleTicks(stat.selfTicks, factor);
+    stat.compensatedTotalTicks = rescaleTicks(stat.compensatedTotalTicks, factor);
+    stat.compensatedSelfTicks = rescaleTicks(stat.compensatedSelfTicks, factor);
+    stat.queueTicks = rescaleTicks(stat.queueTicks, factor);
+    stat.maxQueueTicks = rescaleTicks(stat.maxQueueTicks, factor);
+
+    ProfilerHistogram rescaled;
+    for (int bucket = 0; bucket < ProfilerHistogram::kBucketCount; bucket++) {
+        unsigned int bucketCount = stat.histogram.GetBucketCount(bucket);
+        if (bucketCount == 0) {
+            continue;
+        }
+        ProfilerTicks lower = ProfilerHistogram::GetBucketLowerBound(bucket);
+        ProfilerTicks upper = bucket == ProfilerHistogram::kBucketCount - 1 ? lower : ProfilerHistogram::GetBucketUpperBound(bucket);
+        rescaled.AddToBucket(ProfilerHistogram::GetBucketIndex(rescaleTicks(lower + (upper - lower) / 2, factor)), bucketCount);
+    }
+    stat.histogram = rescaled;
+}
+
+// remapMetrics: Moves a stat's custom counters from the file's metric IDs to this process's
+static void remapMetrics(ProfilerStats& stat, const std::vector<int>& localMetricIds) {
+    unsigned mask = 0;
+    long long totals[ProfilerSectionRegistry::kMaxMetrics] = {};
+    for (size_t metric = 0; metric < localMetricIds.size(); metric++) {
+        if ((stat.metricMask & (1u << metric)) != 0 && localMetricIds[metric] >= 0) {
+            mask |= 1u << localMetricIds[metric];
+            totals[localMetricIds[metric]] = stat.metricTotals[metric];
+        }
+    }
+    stat.metricMask = mask;
+    std::copy(totals, totals + ProfilerSectionRegistry::kMaxMetrics, stat.metricTotals);
+}
+
+static void rescaleCallNode(ProfilerCallNode& node, double factor) {
+    node.inclusiveTicks = rescaleTicks(node.inclusiveTicks, factor);
+    node.selfTicks = rescaleTicks(node.selfTicks, factor);
+    node.compensatedInclusiveTicks = rescaleTicks(node.compensatedInclusiveTicks, factor);
+    node.compensatedSelfTicks = rescaleTicks(node.compensatedSelfTicks, factor);
+}
+
+// addProfile: Interns the profile's sections and custom counter names into this process's registry and
+// appends its threads, in the output's tick length, to threads
+static void addProfile(const ProfilerBinaryProfile& profile, const std::string& labelPrefix, double outputSecondsPerTick, std::vector<ProfileConvertThread>& threads) {
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    std::vector<int> localIds(profile.sectionNames.size(), ProfilerSectionRegistry::kOverflowSection);
+    for (size_t sectionId = 0; sectionId < profile.sectionNames.size(); sectionId++) {
+        int nameId = profile.sectionNames[sectionId];
+        if (nameId >= 0 && nameId < static_cast<int>(profile.strings.size())) {
+            localIds[sectionId] = registry->InternSampled(profile.strings[nameId].c_str(), profile.sectionSampleEvery[sectionId]);
+        }
+    }
+    std::vector<int> localMetricIds(profile.metricNames.size(), -1);
+    for (size_t metric = 0; metric < profile.metricNames.size(); metric++) {
+        int nameId = profile.metricNames[metric];
+        if (nameId >= 0 && nameId < static_cast<int>(profile.strings.size())) {
+            localMetricIds[metric] = registry->InternMetric(profile.strings[nameId].c_str());
+        }
+    }
+
+    double factor = profile.secondsPerTick / outputSecondsPerTick;
+    bool needsRescale = factor < 1.0 - 1e-9 || factor > 1.0 + 1e-9;
+    for (const ProfilerBinaryThread& source : profile.threads) {
+        ProfileConvertThread thread;
+        thread.label = labelPrefix + std::to_string(source.threadId);
+        for (size_t sectionId = 0; sectionId < source.stats.size(); sectionId++) {
+            if (!source.stats[sectionId].HasData()) {
+                continue;
+            }
+            ProfilerStats stat = source.stats[sectionId];
+            if (needsRescale) {
+                rescaleStats(stat, factor);
+            }
+            remapMetrics(stat, localMetricIds);
+            statsFor(thread.stats, localIds[sectionId]).Merge(stat);
+        }
+        thread.callTree = source.callTree;
+        for (ProfilerCallNode& node : thread.callTree) {
+            if (node.sectionId >= 0) {
+                node.sectionId = localIds[node.sectionId];
+            }
+            if (needsRescale) {
+                rescaleCallNode(node, factor);
+            }
+        }
+        if (thread.callTree.empty()) {
+            thread.callTree.emplace_back(-1, -1, 0);
+        }
+        threads.push_back(thread);
+    }
+}
+
+// writeStatsCSV: Same layout as Profiler::printStatsToCSV, totals first ("all") then one block per thread
+static void writeStatsCSV(std::ostream& file, const ProfilerVector<ProfilerStats>& merged, const std::vector<ProfileConvertThread>& threads, const std::vector<std::string>& metricNames) {
+    writeStatsCSVHeader(file, metricNames);
+    for (const ProfilerStats& stat : merged) {
+        if (stat.HasData()) {
+            writeStatsCSVRow(file, "all", &stat, metricNames);
+        }
+    }
+    for (const ProfileConvertThread& thread : threads) {
+        for (const ProfilerStats& stat : thread.stats) {
+            if (stat.HasData()) {
+                writeStatsCSVRow(file, thread.label, &stat, metricNames);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    ProfilerArena::GetInstance()->SetBudget(ProfilerArena::kUnlimited);  // Offline, so nothing to protect from the profiler's memory
+    const char* csvFileName = nullptr;
+    const char* jsonFileName = nullptr;
+    const char* callTreeFileName = nullptr;
+    std::vector<const char*> inputs;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--csv") == 0 && hasValue) {
+            csvFileName = argv[++i];
+        } else if (std::strcmp(argv[i], "--json") == 0 && hasValue) {
+            jsonFileName = argv[++i];
+        } else if (std::strcmp(argv[i], "--calltree") == 0 && hasValue) {
+            callTreeFileName = argv[++i];
+        } else if (argv[i][0] == '-') {
+            printUsage();
+            return 2;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (inputs.empty()) {
+        printUsage();
+        return 2;
+    }
+
+    // The stats point into each profile's strings, so profiles stay put in a deque until the end
+    std::deque<ProfilerBinaryProfile> profiles;
+    for (const char* input : inputs) {
+        profiles.emplace_back();
+        if (!readProfilerBinaryFile(input, profiles.back())) {
+            return 1;
+        }
+        if (profiles.back().truncated) {
+            std::cerr << "Warning: " << input << " ends in an incomplete snapshot, using the last complete one" << std::endl;
+        }
+    }
+
+    // Everything is merged in the first file's tick length
+    double secondsPerTick = profiles.front().secondsPerTick;
+    std::vector<ProfileConvertThread> threads;
+    for (size_t i = 0; i < profiles.size(); i++) {
+        std::string labelPrefix = profiles.size() > 1 ? std::to_string(i + 1) + ":" : "";
+        addProfile(profiles[i], labelPrefix, secondsPerTick, threads);
+    }
+
+    ProfilerSectionRegistry* registry = ProfilerSectionRegistry::GetInstance();
+    ProfilerVector<ProfilerStats> merged;
+    ProfilerVector<ProfilerCallNode> mergedCallTree;
+    mergedCallTree.emplace_back(-1, -1, 0);
+    for (ProfileConvertThread& thread : threads) {
+        for (size_t sectionId = 0; sectionId < thread.stats.size(); sectionId++) {
+            ProfilerStats& stat = thread.stats[sectionId];
+            stat.sampleEvery = registry->GetSampleEvery(static_cast<int>(sectionId));  // Before converting, the custom counter rates use it
+            if (!stat.HasData()) {
+                continue;
+            }
+            statsFor(merged, static_cast<int>(sectionId)).Merge(stat);
+            stat.ConvertTicksToSeconds(secondsPerTick);
+        }
+        mergeCallTree(mergedCallTree, 0, thread.callTree, 0);
+    }
+    for (size_t sectionId = 0; sectionId < merged.size(); sectionId++) {
+        merged[sectionId].sampleEvery = registry->GetSampleEvery(static_cast<int>(sectionId));
+        merged[sectionId].ConvertTicksToSeconds(secondsPerTick);
+    }
+    std::vector<std::string> metricNames;
+    for (int metric = 0; metric < registry->GetMetricCount(); metric++) {
+        metricNames.push_back(registry->GetMetricName(metric));
+    }
+
+    if (csvFileName == nullptr && jsonFileName == nullptr && callTreeFileName == nullptr) {
+        writeStatsCSV(std::cout, merged, threads, metricNames);
+        return 0;
+    }
+
+    if (csvFileName != nullptr) {
+        std::ofstream file(csvFileName);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file for CSV output." << std::endl;
+            return 1;
+        }
+        writeStatsCSV(file, merged, threads, metricNames);
+        std::cout << "Profiler stats written to " << csvFileName << " in CSV format.\n";
+    }
+
+    if (jsonFileName != nullptr) {
+        std::ofstream file(jsonFileName);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file for JSON output." << std::endl;
+            return 1;
+        }
+        file << "[\n";
+        bool first = true;
+        for (const ProfilerStats& stat : merged) {
+            if (!stat.HasData()) {
+                continue;
+            }
+            if (!first) {
+                file << ",\n";
+            }
+            first = false;
+            writeStatsJSONObject(file, "all", &stat, secondsPerTick, metricNames);
+        }
+        for (const ProfileConvertThread& thread : threads) {
+            for (const ProfilerStats& stat : thread.stats) {
+                if (!stat.HasData()) {
+                    continue;
+                }
+                if (!first) {
+                    file << ",\n";
+                }
+                first = false;
+                writeStatsJSONObject(file, thread.label, &stat, secondsPerTick, metricNames);
+            }
+        }
+        file << "\n]\n";
+        std::cout << "Profiler stats written to " << jsonFileName << " in JSON format.\n";
+    }
+
+    if (callTreeFileName != nullptr) {
+        std::ofstream file(callTreeFileName);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file for call tree CSV output." << std::endl;
+            return 1;
+        }
+        writeCallTreeCSVHeader(file);
+        writeCallTreeCSVRows(file, "all", mergedCallTree, secondsPerTick);
+        for (const ProfileConvertThread& thread : threads) {
+            writeCallTreeCSVRows(file, thread.label, thread.callTree, secondsPerTick);
+        }
+        std::cout << "Profiler call tree written to " << callTreeFileName << " in CSV format.\n";
+    }
+    return 0;
+}
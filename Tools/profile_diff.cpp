@@ -0,0 +1,169 @@
+#include "baseline.hpp"
+#include "report.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Compares a binary profile against a baseline saved by Profiler::SaveBaseline, section by section. A
+// section is a regression when a one-sided Mann-Whitney U test on the two latency histograms says it got
+// slower (p below --alpha) and its median grew by more than --threshold percent.
+//
+//   profile_diff [--threshold PCT] [--alpha A] [--min-calls N] [--csv diff.csv] BASELINE CURRENT.prof
+//
+// BASELINE is a .prof file, or a directory of baselines, in which case the newest one (by file name) that
+// was not written by the run that wrote CURRENT is used. Exits with 1 if any section regressed, 2 on bad
+// arguments or unreadable files, and 0 otherwise.
+
+static void printUsage() {
+    std::cerr << "Usage: profile_diff [--threshold PCT] [--alpha A] [--min-calls N] [--csv FILE] BASELINE(.prof or directory) CURRENT.prof" << std::endl;
+}
+
+// findLatestBaseline: The newest baseline-*.prof in the directory from a different run, or "" if there is none
+static std::string findLatestBaseline(const char* directory, const std::string& currentRunId) {
+    std::vector<std::string> fileNames;
+    DIR* dir = opendir(directory);
+    if (dir == nullptr) {
+        return "";
+    }
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.compare(0, 9, "baseline-") == 0 && name.size() > 5 && name.compare(name.size() - 5, 5, ".prof") == 0) {
+            fileNames.push_back(std::string(directory) + "/" + name);
+        }
+    }
+    closedir(dir);
+
+    std::sort(fileNames.rbegin(), fileNames.rend());
+    for (const std::string& fileName : fileNames) {
+        ProfilerBinaryProfile candidate;
+        if (readProfilerBinaryFile(fileName.c_str(), candidate) && getRunMetadataValue(candidate.metadata, "Run ID") != currentRunId) {
+            return fileName;
+        }
+    }
+    return "";
+}
+
+static void printRunDescription(const char* label, const char* fileName, const ProfilerBinaryProfile& profile) {
+    std::cout << label << fileName << "\n";
+    const char* keys[] = { "Timestamp", "Git Commit", "Build Flags", "Compiler", "CPU" };
+    for (const char* key : keys) {
+        std::string value = getRunMetadataValue(profile.metadata, key);
+        std::cout << "    " << key << ": " << (value.empty() ? "unknown" : value) << "\n";
+    }
+}
+
+// writeDiffCSV: One row per section, for index.html or a CI job to pick up
+static bool writeDiffCSV(const char* fileName, const std::vector<ProfilerSectionDiff>& diffs) {
+    std::ofstream file(fileName);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for diff CSV output." << std::endl;
+        return false;
+    }
+    file << "Section Name, Baseline Count, Current Count, Baseline Median Time, Current Median Time, Baseline Average Time, Current Average Time, Median Change Percent, P Value Slower, P Value Faster, Verdict\n";
+    for (const ProfilerSectionDiff& diff : diffs) {
+        writeCSVField(file, diff.sectionName.c_str());
+        file << ", "
+             << diff.baselineCount << ", "
+             << diff.currentCount << ", "
+             << diff.baselineMedianTime << ", "
+             << diff.currentMedianTime << ", "
+             << diff.baselineAvgTime << ", "
+             << diff.currentAvgTime << ", "
+             << diff.medianChangePercent << ", "
+             << diff.pValueSlower << ", "
+             << diff.pValueFaster << ", "
+             << GetDiffVerdictName(diff.verdict) << "\n";
+    }
+    std::cout << "Profile diff written to " << fileName << " in CSV format.\n";
+    return true;
+}
+
+int main(int argc, char** argv) {
+    ProfilerArena::GetInstance()->SetBudget(ProfilerArena::kUnlimited);  // Offline, so nothing to protect from the profiler's memory
+    ProfilerDiffOptions options;
+    options.thresholdPercent = 10.0;
+    options.alpha = 0.01;
+    options.minCalls = 5;
+    const char* csvFileName = nullptr;
+    std::vector<const char*> inputs;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--threshold") == 0 && hasValue) {
+            options.thresholdPercent = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--alpha") == 0 && hasValue) {
+            options.alpha = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--min-calls") == 0 && hasValue) {
+            options.minCalls = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--csv") == 0 && hasValue) {
+            csvFileName = argv[++i];
+        } else if (argv[i][0] == '-') {
+            printUsage();
+            return 2;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (inputs.size() != 2 || options.alpha <= 0.0 || options.thresholdPercent < 0.0) {
+        printUsage();
+        return 2;
+    }
+
+    ProfilerBinaryProfile current;
+    if (!readProfilerBinaryFile(inputs[1], current)) {
+        return 2;
+    }
+    std::string baselineFileName = inputs[0];
+    DIR* dir = opendir(inputs[0]);
+    if (dir != nullptr) {
+        closedir(dir);
+        baselineFileName = findLatestBaseline(inputs[0], getRunMetadataValue(current.metadata, "Run ID"));
+        if (baselineFileName.empty()) {
+            std::cout << "No earlier baseline in " << inputs[0] << ", nothing to compare against.\n";
+            return 0;
+        }
+    }
+    ProfilerBinaryProfile baseline;
+    if (!readProfilerBinaryFile(baselineFileName.c_str(), baseline)) {
+        return 2;
+    }
+
+    printRunDescription("Baseline: ", baselineFileName.c_str(), baseline);
+    printRunDescription("Current:  ", inputs[1], current);
+    std::cout << "Regression: median more than " << options.thresholdPercent << "% slower with p < " << options.alpha
+              << " (one-sided Mann-Whitney U, at least " << options.minCalls << " calls)\n\n";
+
+    std::vector<ProfilerSectionDiff> diffs = diffProfiles(baseline, current, options);
+    int regressions = 0;
+    for (const ProfilerSectionDiff& diff : diffs) {
+        std::cout << diff.sectionName << ": ";
+        if (diff.verdict == DIFF_NEW) {
+            std::cout << "new, median " << diff.currentMedianTime << " seconds (" << diff.currentCount << " calls)\n";
+            continue;
+        }
+        if (diff.verdict == DIFF_MISSING) {
+            std::cout << "missing, was median " << diff.baselineMedianTime << " seconds (" << diff.baselineCount << " calls)\n";
+            continue;
+        }
+        std::cout << "median " << diff.baselineMedianTime << " -> " << diff.currentMedianTime << " seconds ("
+                  << (diff.medianChangePercent >= 0.0 ? "+" : "") << diff.medianChangePercent << "%, "
+                  << diff.baselineCount << " -> " << diff.currentCount << " calls";
+        if (diff.verdict != DIFF_NOT_TESTED) {
+            std::cout << ", p slower " << diff.pValueSlower << ", p faster " << diff.pValueFaster;
+        }
+        std::cout << ") " << GetDiffVerdictName(diff.verdict) << "\n";
+        if (diff.verdict == DIFF_REGRESSION) {
+            regressions++;
+        }
+    }
+
+    if (csvFileName != nullptr && !writeDiffCSV(csvFileName, diffs)) {
+        return 2;
+    }
+    std::cout << "\n" << regressions << " section" << (regressions == 1 ? "" : "s") << " regressed.\n";
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+#include "shared.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches a running process's shared stats (Profiler::OpenSharedStats) like top. Every refresh asks the
+// process to publish, waits for it, and lists the sections that spent the most time since the previous
+// refresh. The process only does any work while this is watching it.
+//
+//   profiler_top [--interval SECONDS] [--rows N] [--once] PID|NAME
+//
+// A PID means the default object name, /profiler-<pid>. --once prints a single table of the totals since
+// the process started and exits, e.g. for scripts.
+
+static const int kPublishTimeoutMilliseconds = 2000;
+
+// ProfilerTopRow struct: One section's line, with its change since the previous refresh
+struct ProfilerTopRow {
+    const ProfilerSharedSectionSnapshot* section;
+    long long calls;
+    long long outermostCalls;
+    double time;
+};
+
+static void printUsage() {
+    std::fprintf(stderr, "Usage: profiler_top [--interval SECONDS] [--rows N] [--once] PID|NAME\n");
+}
+
+// waitForPublish: Asks for fresh numbers and waits until the publish count moves past what was seen before
+static bool waitForPublish(ProfilerSharedReader& reader) {
+    unsigned long long before = reader.GetPublishCount();
+    reader.RequestPublish();
+    for (int waited = 0; waited < kPublishTimeoutMilliseconds; waited += 10) {
+        if (reader.GetPublishCount() != before) {
+            return true;
+        }
+        if (reader.IsClosed()) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+// printTable: Sections by time spent in the interval, which is the whole run when there is no previous refresh
+static void printTable(const std::vector<ProfilerSharedSectionSnapshot>& sections, const std::map<std::string, ProfilerSharedSectionSnapshot>& previous,
+                       double intervalSeconds, int maxRows) {
+    std::vector<ProfilerTopRow> rows;
+    for (const ProfilerSharedSectionSnapshot& section : sections) {
+        auto it = previous.find(section.name);
+        long long calls = it != previous.end() ? section.count - it->second.count : section.count;
+        long long outermostCalls = it != previous.end() ? section.outermostCount - it->second.outermostCount : section.outermostCount;
+        double time = it != previous.end() ? section.totalTime - it->second.totalTime : section.totalTime;
+        rows.push_back(ProfilerTopRow{ &section, calls, outermostCalls, time });
+    }
+    std::sort(rows.begin(), rows.end(), [](const ProfilerTopRow& a, const ProfilerTopRow& b) {
+        return a.time != b.time ? a.time > b.time : a.section->totalTime > b.section->totalTime;
+    });
+
+    // Busy is inclusive time over wall time, so nested sections and several threads can take it past 100%
+    std::printf("%8s %12s %12s %12s %12s %14s  %s\n", "Busy %", "Calls/s", "Avg", "P99", "Max", "Total Calls", "Section");
+    for (int i = 0; i < static_cast<int>(rows.size()) && i < maxRows; i++) {
+        const ProfilerTopRow& row = rows[i];
+        const ProfilerSharedSectionSnapshot* section = row.section;
+        double busy = intervalSeconds > 0.0 ? 100.0 * row.time / intervalSeconds : 0.0;
+        double callsPerSecond = intervalSeconds > 0.0 ? row.calls / intervalSeconds : 0.0;
+        double average = row.outermostCalls > 0 ? row.time / row.outermostCalls : 0.0;  // Recursive calls are inside their outermost call's time
+        std::printf("%8.1f %12.0f %12.3g %12.3g %12.3g %14lld  %s\n", busy, callsPerSecond, average, section->p99Time,
+                    section->maxTime, section->count, section->name.c_str());
+    }
+}
+
+int main(int argc, char** argv) {
+    double intervalSeconds = 1.0;
+    int maxRows = 25;
+    bool once = false;
+    const char* target = nullptr;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--interval") == 0 && hasValue) {
+            intervalSeconds = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--rows") == 0 && hasValue) {
+            maxRows = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--once") == 0) {
+            once = true;
+        } else if (argv[i][0] == '-' || target != nullptr) {
+            printUsage();
+            return 2;
+        } else {
+            target = argv[i];
+        }
+    }
+    if (target == nullptr || intervalSeconds <= 0.0 || maxRows <= 0) {
+        printUsage();
+        return 2;
+    }
+
+    std::string name = std::strspn(target, "0123456789") == std::strlen(target) ? getDefaultSharedStatsName(std::atoi(target)) : target;
+    ProfilerSharedReader reader;
+    if (!reader.Open(name.c_str())) {
+        return 1;
+    }
+
+    std::vector<ProfilerSharedSectionSnapshot> sections;
+    std::map<std::string, ProfilerSharedSectionSnapshot> previous;
+    double previousSeconds = 0.0;
+    for (;;) {
+        if (!waitForPublish(reader)) {
+            if (reader.IsClosed()) {
+                std::printf("Process %d closed its shared stats.\n", reader.GetProcessId());
+                return 0;
+            }
+            std::fprintf(stderr, "No publish from process %d within %d ms, is it still running?\n", reader.GetProcessId(), kPublishTimeoutMilliseconds);
+            if (once) {
+                return 1;
+            }
+            continue;
+        }
+        reader.ReadSections(sections);
+        double seconds = reader.GetPublishSeconds();
+
+        if (!once) {
+            std::printf("\033[H\033[2J");  // Clear the terminal, like top
+        }
+        std::printf("%s: process %d, %.1f s since the profiler started, %zu sections called\n\n", name.c_str(), reader.GetProcessId(), seconds, sections.size());
+        printTable(sections, previous, seconds - previousSeconds, maxRows);
+        std::fflush(stdout);
+        if (once) {
+            return 0;
+        }
+
+        previous.clear();
+        for (const ProfilerSharedSectionSnapshot& section : sections) {
+            previous[section.name] = section;
+        }
+        previousSeconds = seconds;
+        std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(intervalSeconds * 1000)));
+    }
+}